@@ -0,0 +1,81 @@
+#include "AllocCounter.h"
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+static std::atomic<long long> allocations(0);
+
+long long AllocationCount()
+{
+	return allocations.load(std::memory_order_relaxed);
+}
+
+void CountAllocation()
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+// The array and nothrow forms of new call these by default, every form of
+// delete is replaced so none of them mixes with a library's own free
+void* operator new(size_t size)
+{
+	CountAllocation();
+	void* memory = malloc(size != 0 ? size : 1);
+	if (memory == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	CountAllocation();
+
+	size_t align = (size_t)alignment;
+#ifdef _WIN32
+	void* memory = _aligned_malloc(size != 0 ? size : 1, align);
+#else
+	// aligned_alloc wants a multiple of the alignment
+	size = (size + align - 1) / align * align;
+	void* memory = aligned_alloc(align, size != 0 ? size : align);
+#endif
+	if (memory == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+// Windows can't free aligned blocks with free
+static void FreeAligned(void* memory)
+{
+#ifdef _WIN32
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+// Heap allocation counter for the frame loop checks. The program's global
+// operator new, aligned forms included, is replaced to count every allocation;
+// SDL_malloc, SDL_calloc and SDL_realloc are counted once the game hooks
+// them (HookSDLAllocations in Game.h), which covers SDL_ttf surfaces and
+// renderer textures too. Plain malloc inside C libraries is not seen.
+//
+// The count is process wide: an allocation on the sim thread (replay
+// recording, rollback, broadcasting) during a frame shows up in that frame
+// just like one on the render thread.
+
+long long AllocationCount(); // Of every thread so far
+
+// For allocators hooked elsewhere
+void CountAllocation();
@@ -0,0 +1,188 @@
+#include "AssetArchive.h"
+#include "MappedFile.h"
+#include <stdio.h>
+#include <string.h>
+
+bool ArchiveOpenMemory(AssetArchive& archive, const unsigned char* data, size_t size)
+{
+	memset(&archive, 0, sizeof(archive));
+
+	const ArchiveHeader* header = (const ArchiveHeader*)data;
+	if (data == NULL || size < sizeof(ArchiveHeader)
+		|| header->magic != ARCHIVE_MAGIC
+		|| header->version != ARCHIVE_VERSION
+		|| header->entryCount < 0
+		|| sizeof(ArchiveHeader) + (size_t)header->entryCount * sizeof(ArchiveEntry) > size)
+	{
+		return false;
+	}
+
+	const ArchiveEntry* entries = (const ArchiveEntry*)(data + sizeof(ArchiveHeader));
+	for (int i = 0; i < header->entryCount; i++)
+	{
+		if (entries[i].offset < 0 || entries[i].size < 0 || (size_t)(entries[i].offset + entries[i].size) > size)
+		{
+			return false;
+		}
+	}
+
+	archive.data = data;
+	archive.size = size;
+	archive.header = header;
+	archive.entries = entries;
+	return true;
+}
+
+bool ArchiveOpen(AssetArchive& archive, const char* path)
+{
+	size_t size = 0;
+	const unsigned char* data = MapFile(path, size);
+	if (data == NULL)
+	{
+		return false;
+	}
+
+	if (!ArchiveOpenMemory(archive, data, size))
+	{
+		printf("Archive %s is not an asset archive of this version\n", path);
+		UnmapFile(data, size);
+		return false;
+	}
+
+	archive.mapped = true;
+	return true;
+}
+
+void ArchiveClose(AssetArchive& archive)
+{
+	if (archive.mapped)
+	{
+		UnmapFile(archive.data, archive.size);
+	}
+	memset(&archive, 0, sizeof(archive));
+}
+
+const ArchiveEntry* ArchiveFind(const AssetArchive& archive, const char* name)
+{
+	if (archive.header == NULL)
+	{
+		return NULL;
+	}
+
+	// A dozen entries, a linear search is fine
+	for (int i = 0; i < archive.header->entryCount; i++)
+	{
+		if (strncmp(archive.entries[i].name, name, ARCHIVE_NAME_SIZE) == 0)
+		{
+			return &archive.entries[i];
+		}
+	}
+	return NULL;
+}
+
+const unsigned char* ArchiveData(const AssetArchive& archive, const ArchiveEntry& entry)
+{
+	return archive.data + entry.offset;
+}
+
+ArchiveEntry& ArchiveAdd(ArchiveWriter& writer, const char* name, ArchiveKind kind, const void* data, size_t size)
+{
+	ArchiveEntry entry;
+	memset(&entry, 0, sizeof(entry));
+	strncpy(entry.name, name, ARCHIVE_NAME_SIZE - 1);
+	entry.kind = kind;
+	entry.size = (long long)size;
+
+	writer.entries.push_back(entry);
+	writer.data.push_back(std::vector<unsigned char>((const unsigned char*)data, (const unsigned char*)data + size));
+	return writer.entries.back();
+}
+
+bool ArchiveAddFile(ArchiveWriter& writer, const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == NULL)
+	{
+		printf("Asset %s could not be opened\n", path);
+		return false;
+	}
+
+	std::vector<unsigned char> bytes;
+	unsigned char buffer[65536];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		bytes.insert(bytes.end(), buffer, buffer + read);
+	}
+	fclose(file);
+
+	ArchiveAdd(writer, path, ARCHIVE_FILE, bytes.data(), bytes.size());
+	return true;
+}
+
+// Header, entry table with final offsets, then aligned data
+static std::vector<unsigned char> BuildArchive(const ArchiveWriter& writer)
+{
+	ArchiveHeader header = { ARCHIVE_MAGIC, ARCHIVE_VERSION, (int)writer.entries.size(), 0 };
+	std::vector<ArchiveEntry> entries = writer.entries;
+
+	size_t offset = sizeof(ArchiveHeader) + entries.size() * sizeof(ArchiveEntry);
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		offset = (offset + ARCHIVE_ALIGNMENT - 1) / ARCHIVE_ALIGNMENT * ARCHIVE_ALIGNMENT;
+		entries[i].offset = (long long)offset;
+		offset += writer.data[i].size();
+	}
+
+	std::vector<unsigned char> archive(offset, 0);
+	memcpy(archive.data(), &header, sizeof(header));
+	memcpy(archive.data() + sizeof(header), entries.data(), entries.size() * sizeof(ArchiveEntry));
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		memcpy(archive.data() + entries[i].offset, writer.data[i].data(), writer.data[i].size());
+	}
+	return archive;
+}
+
+bool ArchiveWrite(const ArchiveWriter& writer, const char* path)
+{
+	FILE* file = fopen(path, "wb");
+	if (file == NULL)
+	{
+		printf("Archive %s could not be created\n", path);
+		return false;
+	}
+
+	std::vector<unsigned char> archive = BuildArchive(writer);
+	fwrite(archive.data(), 1, archive.size(), file);
+
+	bool ok = !ferror(file);
+	fclose(file);
+	return ok;
+}
+
+bool ArchiveWriteSource(const ArchiveWriter& writer, const char* path)
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+	{
+		printf("Source %s could not be created\n", path);
+		return false;
+	}
+
+	std::vector<unsigned char> archive = BuildArchive(writer);
+
+	fprintf(file, "// Generated by pingpong_pack, do not edit\n");
+	fprintf(file, "#include <stddef.h>\n\n");
+	fprintf(file, "alignas(%d) extern const unsigned char PINGPONG_ASSETS[] = {\n", ARCHIVE_ALIGNMENT);
+	for (size_t i = 0; i < archive.size(); i++)
+	{
+		fprintf(file, "%d,%s", archive[i], i % 32 == 31 ? "\n" : "");
+	}
+	fprintf(file, "\n};\n");
+	fprintf(file, "extern const size_t PINGPONG_ASSETS_SIZE = %zu;\n", archive.size());
+
+	bool ok = !ferror(file);
+	fclose(file);
+	return ok;
+}
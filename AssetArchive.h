@@ -0,0 +1,76 @@
+#pragma once
+#include <stddef.h>
+#include <vector>
+
+// Packed asset archive: ArchiveHeader, ArchiveHeader::entryCount ArchiveEntry
+// records, then the data of every entry, each ARCHIVE_ALIGNMENT aligned.
+// Entries are found by the path the game uses ("resources/img/ball.png").
+// Images and sounds can be stored already decoded so loading is only pointing
+// SDL at the bytes.
+
+const unsigned ARCHIVE_MAGIC = 0x4B415050; // "PPAK"
+const int ARCHIVE_VERSION = 1;
+const int ARCHIVE_ALIGNMENT = 16;
+const int ARCHIVE_NAME_SIZE = 96;
+
+enum ArchiveKind
+{
+	ARCHIVE_FILE, // The file as it is on disk
+	ARCHIVE_PIXELS, // Decoded image, SDL pixel format
+	ARCHIVE_PCM // Decoded sound, SDL audio format
+};
+
+typedef struct ArchiveHeader
+{
+	unsigned magic;
+	int version;
+	int entryCount;
+	int reserved;
+} ArchiveHeader;
+
+typedef struct ArchiveEntry
+{
+	char name[ARCHIVE_NAME_SIZE];
+	int kind;
+
+	// ARCHIVE_PIXELS: width, height, pitch, SDL_PIXELFORMAT_*
+	// ARCHIVE_PCM: frequency, channels, unused, AUDIO_* format
+	int width;
+	int height;
+	int pitch;
+	unsigned format;
+
+	long long offset; // From the start of the archive
+	long long size;
+} ArchiveEntry;
+
+typedef struct AssetArchive
+{
+	const unsigned char* data;
+	size_t size;
+	bool mapped; // Unmapped on close, embedded archives are not
+
+	const ArchiveHeader* header;
+	const ArchiveEntry* entries;
+} AssetArchive;
+
+// Reading
+bool ArchiveOpen(AssetArchive& archive, const char* path);
+bool ArchiveOpenMemory(AssetArchive& archive, const unsigned char* data, size_t size);
+void ArchiveClose(AssetArchive& archive);
+const ArchiveEntry* ArchiveFind(const AssetArchive& archive, const char* name);
+const unsigned char* ArchiveData(const AssetArchive& archive, const ArchiveEntry& entry);
+
+// Writing, used by pingpong_pack
+typedef struct ArchiveWriter
+{
+	std::vector<ArchiveEntry> entries;
+	std::vector<std::vector<unsigned char>> data;
+} ArchiveWriter;
+
+ArchiveEntry& ArchiveAdd(ArchiveWriter& writer, const char* name, ArchiveKind kind, const void* data, size_t size);
+bool ArchiveAddFile(ArchiveWriter& writer, const char* path);
+bool ArchiveWrite(const ArchiveWriter& writer, const char* path);
+
+// A C++ source defining PINGPONG_ASSETS and PINGPONG_ASSETS_SIZE
+bool ArchiveWriteSource(const ArchiveWriter& writer, const char* path);
@@ -0,0 +1,701 @@
+#include "Simulation.h"
+#include "SimBatch.h"
+#include "Rollback.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#ifndef BENCH_NO_RENDER
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <SDL_image.h>
+#include "Game.h"
+#include "RenderBatch.h"
+#include "Resources.h"
+#include "AllocCounter.h"
+#include "SimThread.h"
+#endif
+
+// Micro and scenario benchmarks. Prints one CSV row per benchmark, or compares
+// against a CSV printed earlier with --baseline.
+
+// Each repetition runs for at least this long, the fastest of BENCH_REPETITIONS is kept
+const double BENCH_MIN_SECONDS = 0.05;
+const int BENCH_REPETITIONS = 5;
+const int BENCH_DATA_SIZE = 1024;
+
+// Runs the benchmark body iterations times
+typedef void (*BenchFunction)(long long iterations);
+
+typedef struct BenchResult
+{
+	std::string name;
+	double nsPerOp;
+	long long iterations;
+} BenchResult;
+
+// Keeps results alive so the compiler can't drop the work
+volatile int benchSink;
+
+double RunTimed(BenchFunction function, long long iterations)
+{
+	auto start = std::chrono::steady_clock::now();
+	function(iterations);
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+BenchResult RunBenchmark(const char* name, BenchFunction function)
+{
+	// Double the iterations until one run is long enough to time
+	long long iterations = 1;
+	while (RunTimed(function, iterations) < BENCH_MIN_SECONDS && iterations < (1LL << 40))
+	{
+		iterations *= 2;
+	}
+
+	double best = 1e30;
+	for (int i = 0; i < BENCH_REPETITIONS; i++)
+	{
+		best = std::min(best, RunTimed(function, iterations));
+	}
+
+	return { name, best * 1e9 / iterations, iterations };
+}
+
+// xorshift, fixed seed so every run measures the same data
+unsigned benchRandom = 2023;
+
+int RandomInt(int first, int last)
+{
+	benchRandom ^= benchRandom << 13;
+	benchRandom ^= benchRandom >> 17;
+	benchRandom ^= benchRandom << 5;
+	return first + (int)(benchRandom % (unsigned)(last - first + 1));
+}
+
+SimRect RandomRect(int w, int h)
+{
+	return { RandomInt(0, ARENA_WIDTH - w), RandomInt(0, ARENA_HEIGHT - h), w, h };
+}
+
+// Simulation
+
+SimRect rectsA[BENCH_DATA_SIZE];
+SimRect rectsB[BENCH_DATA_SIZE];
+SimBody bodies[BENCH_DATA_SIZE];
+SimState states[BENCH_DATA_SIZE];
+SimState match;
+SimBatch batch;
+
+void SetupSimulation()
+{
+	SimState initial;
+	SimInit(initial, SimDefaultConfig());
+
+	for (int i = 0; i < BENCH_DATA_SIZE; i++)
+	{
+		rectsA[i] = RandomRect(BALL_SIZE, BALL_SIZE);
+		rectsB[i] = RandomRect(PADDLE_WIDTH * 8, PADDLE_HEIGHT);
+
+		bodies[i] = initial.ball;
+		bodies[i].velocity = RandomInt(1, 8);
+		bodies[i].xDirection = RandomInt(0, 1) ? DIRECTION_RIGHT : DIRECTION_LEFT;
+		bodies[i].yDirection = RandomInt(0, 1) ? DIRECTION_DOWN : DIRECTION_UP;
+
+		states[i] = initial;
+		SetComponentPosition(states[i].ball, RandomInt(0, ARENA_WIDTH - BALL_SIZE), RandomInt(0, ARENA_HEIGHT - BALL_SIZE));
+		states[i].ball.xDirection = bodies[i].xDirection;
+	}
+
+	SimInit(match, SimDefaultConfig());
+	SimBatchInit(batch, 1024, SimDefaultConfig());
+}
+
+void BenchCheckCollision(long long iterations)
+{
+	int hits = 0;
+	for (long long i = 0; i < iterations; i++)
+	{
+		int index = (int)(i & (BENCH_DATA_SIZE - 1));
+		hits += CheckCollision(rectsA[index], rectsB[index]);
+	}
+	benchSink = hits;
+}
+
+void BenchMoveComponent(long long iterations)
+{
+	for (long long i = 0; i < iterations; i++)
+	{
+		MoveComponent(bodies[i & (BENCH_DATA_SIZE - 1)]);
+	}
+	benchSink = bodies[0].rect.x;
+
+	// Keep the bodies from drifting too far away between runs
+	for (int i = 0; i < BENCH_DATA_SIZE; i++)
+	{
+		SetComponentPosition(bodies[i], ARENA_WIDTH / 2, ARENA_HEIGHT / 2);
+	}
+}
+
+void BenchEnemyMovement(long long iterations)
+{
+	for (long long i = 0; i < iterations; i++)
+	{
+		EnemyMovement(states[i & (BENCH_DATA_SIZE - 1)]);
+	}
+	benchSink = states[0].enemy.yDirection;
+}
+
+void BenchEnemyRethink(long long iterations)
+{
+	for (long long i = 0; i < iterations; i++)
+	{
+		EnemyRethink(states[i & (BENCH_DATA_SIZE - 1)]);
+	}
+	benchSink = states[0].enemyTargetY;
+}
+
+void BenchSimStep(long long iterations)
+{
+	int events = 0;
+	for (long long i = 0; i < iterations; i++)
+	{
+		events |= SimStep(match, SimAutopilotInput(match));
+		if (match.finished)
+		{
+			SimInit(match, SimDefaultConfig());
+		}
+	}
+	benchSink = events;
+}
+
+// One tick of 1024 matches, reported per match tick
+void BenchBatchStep(long long iterations)
+{
+	for (long long i = 0; i < iterations; i += batch.count)
+	{
+		SimBatchAutopilot(batch);
+		SimBatchStep(batch);
+		if (batch.finished[0])
+		{
+			SimBatchFree(batch);
+			SimBatchInit(batch, 1024, SimDefaultConfig());
+		}
+	}
+	benchSink = batch.ballX[0];
+}
+
+// Restores a saved state and simulates the deepest rollback again, reported per rollback
+void BenchRollback(long long iterations)
+{
+	SimConfig config = SimDefaultConfig();
+	config.enemyHuman = true;
+
+	SimState saved, state;
+	SimInit(saved, config);
+	SimInput input = { DIRECTION_UP, SIM_FULL_SPEED, true, DIRECTION_DOWN };
+	SimStep(saved, input);
+
+	for (long long i = 0; i < iterations; i++)
+	{
+		state = saved;
+		for (int tick = 0; tick < ROLLBACK_MAX_PREDICTION; tick++)
+		{
+			input.playerDirection = (int)((i + tick) % 3) - 1;
+			SimStep(state, input);
+		}
+	}
+	benchSink = SimHash(state);
+}
+
+#ifndef BENCH_NO_RENDER
+// Rendering, on SDL's software renderer so no GPU is needed
+
+SDL_Surface* benchTarget = NULL;
+Component benchBall;
+Component benchPlayer;
+Component benchEnemy;
+TextComponent benchLabel;
+
+bool SetupRender()
+{
+	if (SDL_Init(0) < 0 || TTF_Init() < 0 || IMG_Init(IMG_INIT_PNG) == 0)
+	{
+		printf("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
+		return false;
+	}
+
+	benchTarget = SDL_CreateRGBSurfaceWithFormat(0, ARENA_WIDTH, ARENA_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+	renderer = SDL_CreateSoftwareRenderer(benchTarget);
+	if (renderer == NULL)
+	{
+		printf("Software renderer could not be created! SDL_Error: %s\n", SDL_GetError());
+		return false;
+	}
+
+	InitRenderBatch(renderer);
+	QueueGameResources(false);
+	StartLoadingResources();
+
+	LoadSpriteAtlas();
+	benchBall = CreateComponent({ ARENA_WIDTH / 2, ARENA_HEIGHT / 2 }, BALL_SPRITE);
+	benchPlayer = CreateComponent({ ARENA_PADDING, ARENA_HEIGHT / 2 }, PADDLE_SPRITE);
+	benchEnemy = CreateComponent({ ARENA_WIDTH - ARENA_PADDING - PADDLE_WIDTH, ARENA_HEIGHT / 2 }, PADDLE_SPRITE);
+	benchLabel = CreateTextComponent({ 0, 0 }, "Presione ENTER para comenzar", WORK_SANS_THIN, 30, { 255, 255, 255 }, PlaceMiddleBottom);
+	return true;
+}
+
+void QuitRender()
+{
+	FreeTextComponent(benchLabel);
+	ClearTextCache();
+	ClearFonts();
+	ClearSpriteAtlas();
+	QuitResources();
+
+	SDL_DestroyRenderer(renderer);
+	renderer = NULL;
+	SDL_FreeSurface(benchTarget);
+	benchTarget = NULL;
+
+	TTF_Quit();
+	IMG_Quit();
+	SDL_Quit();
+}
+
+// Text already in the text cache
+void BenchCreateTextCached(long long iterations)
+{
+	for (long long i = 0; i < iterations; i++)
+	{
+		TextComponent label = CreateTextComponent({ 0, 0 }, "Jugando", WORK_SANS_THIN, 30, { 255, 255, 255 }, PlaceMiddleBottom);
+		benchSink = label.rect.w;
+		FreeTextComponent(label);
+	}
+}
+
+// More distinct texts than the cache holds, every call rasterizes
+void BenchCreateTextUncached(long long iterations)
+{
+	for (long long i = 0; i < iterations; i++)
+	{
+		char text[TEXT_CAPACITY];
+		snprintf(text, sizeof(text), "%lld", i % 1000);
+		TextComponent label = CreateTextComponent({ 0, 0 }, text, WORK_SANS_EXTRABOLD, 50, { 255, 255, 255 }, PlaceMiddleTop);
+		benchSink = label.rect.w;
+		FreeTextComponent(label);
+	}
+}
+
+void BenchDrawTextComponent(long long iterations)
+{
+	for (long long i = 0; i < iterations; i++)
+	{
+		DrawTextComponent(benchLabel, 15);
+	}
+	FlushRenderBatch();
+}
+
+// New text every call from a glyph atlas, like the clock and the score
+void BenchDrawGlyphText(long long iterations)
+{
+	TextComponent label = CreateTextComponent({ 0, 0 }, "0", WORK_SANS_EXTRABOLD, 50, { 255, 255, 255 }, PlaceMiddleTop, true);
+	for (long long i = 0; i < iterations; i++)
+	{
+		snprintf(label.text, sizeof(label.text), "%lld", i % 1000);
+		DrawTextComponent(label, 15);
+	}
+	FlushRenderBatch();
+	FreeTextComponent(label);
+}
+
+void BenchDrawImage(long long iterations)
+{
+	for (long long i = 0; i < iterations; i++)
+	{
+		DrawImage(benchBall.texture, benchBall.sprite, (int)(i % (ARENA_WIDTH - BALL_SIZE)), ARENA_HEIGHT / 2);
+	}
+	FlushRenderBatch();
+}
+
+// A screen full of sprites and labels, submitted in a handful of batches
+void BenchDrawBatchedFrame(long long iterations)
+{
+	for (long long i = 0; i < iterations; i++)
+	{
+		for (int j = 0; j < 256; j++)
+		{
+			DrawImage(benchBall.texture, j % 2 ? benchBall.sprite : benchPlayer.sprite, (j * 37) % ARENA_WIDTH, (j * 53) % ARENA_HEIGHT);
+			if (j % 32 == 0)
+			{
+				DrawTextComponent(benchLabel, j);
+			}
+		}
+		FlushRenderBatch();
+	}
+}
+
+// A bot match drawn like GamePlayLogic, the score and the clock from glyph atlases
+typedef struct MatchScene
+{
+	SimState sim;
+	TextComponent scoreLabel;
+	TextComponent timeLabel;
+} MatchScene;
+
+void BeginMatchScene(MatchScene& scene)
+{
+	SimInit(scene.sim, SimDefaultConfig());
+	scene.scoreLabel = CreateTextComponent({ 0, 0 }, "0 - 0", WORK_SANS_EXTRABOLD, 50, { 255, 255, 255 }, PlaceMiddleTop, true);
+	scene.timeLabel = CreateTextComponent({ 0, 0 }, "0", WORK_SANS_REGULAR, 40, { 255, 255, 255 }, PlaceRightBottom, true);
+}
+
+// One tick and one frame
+void MatchSceneFrame(MatchScene& scene)
+{
+	SimState& sim = scene.sim;
+	SimStep(sim, SimAutopilotInput(sim));
+	if (sim.finished)
+	{
+		SimInit(sim, SimDefaultConfig());
+	}
+
+	snprintf(scene.scoreLabel.text, sizeof(scene.scoreLabel.text), "%d - %d", sim.enemyPoints, sim.playerPoints);
+	snprintf(scene.timeLabel.text, sizeof(scene.timeLabel.text), "%d", sim.timeLeft);
+
+	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+	SDL_RenderClear(renderer);
+
+	benchBall.rect = ToSDLRect(sim.ball.rect);
+	benchPlayer.rect = ToSDLRect(sim.player.rect);
+	benchEnemy.rect = ToSDLRect(sim.enemy.rect);
+	DrawComponent(benchBall);
+	DrawComponent(benchPlayer);
+	DrawComponent(benchEnemy);
+	DrawTextComponent(benchLabel, 15);
+	DrawTextComponent(scene.scoreLabel, 15);
+	DrawTextComponent(scene.timeLabel, 15);
+
+	FlushRenderBatch();
+	SDL_RenderPresent(renderer);
+}
+
+void EndMatchScene(MatchScene& scene)
+{
+	FreeTextComponent(scene.scoreLabel);
+	FreeTextComponent(scene.timeLabel);
+}
+
+// A whole bot match at one tick per frame, reported per frame
+void BenchMatchScenario(long long iterations)
+{
+	MatchScene scene;
+	BeginMatchScene(scene);
+	for (long long i = 0; i < iterations; i++)
+	{
+		MatchSceneFrame(scene);
+	}
+	EndMatchScene(scene);
+}
+
+// Half a minute of the real gameplay screen after a short warmup: the match
+// on the sim thread, recording its replay, and the frames drawn by
+// GamePlayLogic through the render batch. The bot plays the player through
+// the same input queue as the keyboard. Every frame must be free of heap
+// allocations on any thread, returns how many frames did allocate.
+const int ALLOC_WARMUP_FRAMES = 120;
+const int ALLOC_CHECK_SECONDS = 30;
+const Uint32 ALLOC_FRAME_MS = 1000 / 60;
+
+int CheckMatchAllocations()
+{
+	StartGameplayScreen();
+
+	int frames = ALLOC_CHECK_SECONDS * 1000 / ALLOC_FRAME_MS;
+	int allocatingFrames = 0;
+	long long allocations = 0;
+	int direction = DIRECTION_STOP;
+	for (int i = 0; i < ALLOC_WARMUP_FRAMES + frames; i++)
+	{
+		long long before = AllocationCount();
+		const SimState& sim = GameplayScreenFrame();
+		if (sim.waitingToBegin)
+		{
+			SimThreadStart();
+		}
+		SimInput input = SimAutopilotInput(sim);
+		if (input.playerDirection != direction)
+		{
+			direction = input.playerDirection;
+			SimThreadSetDirection(direction);
+		}
+
+		// The sim thread keeps its own pace, the frames follow a 60 Hz display.
+		// Its ticks during the wait count toward this frame.
+		SDL_Delay(ALLOC_FRAME_MS);
+		long long allocated = AllocationCount() - before;
+
+		if (i >= ALLOC_WARMUP_FRAMES && allocated > 0)
+		{
+			if (allocatingFrames < 10)
+			{
+				printf("frame %d allocated %lld times\n", i, allocated);
+			}
+			allocatingFrames++;
+			allocations += allocated;
+		}
+	}
+	StopGameplayScreen();
+
+	printf("allocation check: %d frames, %d allocated, %lld allocations\n", frames, allocatingFrames, allocations);
+	return allocatingFrames;
+}
+
+// The main menu redrawn every frame
+void BenchMenuScenario(long long iterations)
+{
+	TextComponent title = CreateTextComponent({ 0, 0 }, "PING PONG", WORK_SANS_EXTRABOLD, 120, { 255, 255, 255 }, PlaceMiddleTop);
+	TextComponent newGame = CreateTextComponent({ 0, 0 }, "Nueva partida", WORK_SANS_EXTRABOLD, 70, { 255, 255, 255 }, PlaceMiddle);
+	TextComponent quit = CreateTextComponent({ 0, 0 }, "Salir", WORK_SANS_EXTRABOLD, 50, { 255, 255, 255 }, PlaceMiddleBottom);
+
+	for (long long i = 0; i < iterations; i++)
+	{
+		SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+		SDL_RenderClear(renderer);
+		DrawTextComponent(title, 15);
+		DrawTextComponent(newGame, 15);
+		DrawTextComponent(quit, 15);
+		FlushRenderBatch();
+		SDL_RenderPresent(renderer);
+	}
+
+	FreeTextComponent(title);
+	FreeTextComponent(newGame);
+	FreeTextComponent(quit);
+}
+
+// The main menu as the game draws it, retained in a layer and not presented when unchanged
+void BenchMenuRetainedScenario(long long iterations)
+{
+	TextComponent title = CreateTextComponent({ 0, 0 }, "PING PONG", WORK_SANS_EXTRABOLD, 120, { 255, 255, 255 }, PlaceMiddleTop);
+	TextComponent newGame = CreateTextComponent({ 0, 0 }, "Nueva partida", WORK_SANS_EXTRABOLD, 70, { 255, 255, 255 }, PlaceMiddle);
+	TextComponent quit = CreateTextComponent({ 0, 0 }, "Salir", WORK_SANS_EXTRABOLD, 50, { 255, 255, 255 }, PlaceMiddleBottom);
+	RetainedLayer layer = {};
+
+	for (long long i = 0; i < iterations; i++)
+	{
+		BeginRenderFrame();
+		bool redraw = BeginLayer(layer, LayerKey(0));
+		if (redraw)
+		{
+			DrawTextComponent(title, 15);
+			DrawTextComponent(newGame, 15);
+			DrawTextComponent(quit, 15);
+			EndLayer(layer);
+		}
+		DrawLayer(layer);
+
+		if (redraw)
+		{
+			FlushRenderBatch();
+			SDL_RenderPresent(renderer);
+		}
+		else
+		{
+			DiscardRenderBatch();
+		}
+	}
+
+	FreeLayer(layer);
+	FreeTextComponent(title);
+	FreeTextComponent(newGame);
+	FreeTextComponent(quit);
+}
+#endif
+
+typedef struct BenchEntry
+{
+	const char* name;
+	BenchFunction function;
+} BenchEntry;
+
+const BenchEntry BENCHMARKS[] = {
+	{ "CheckCollision", BenchCheckCollision },
+	{ "MoveComponent", BenchMoveComponent },
+	{ "EnemyMovement", BenchEnemyMovement },
+	{ "EnemyRethink", BenchEnemyRethink },
+	{ "SimStep", BenchSimStep },
+	{ "SimBatchStep", BenchBatchStep },
+	{ "Rollback", BenchRollback },
+#ifndef BENCH_NO_RENDER
+	{ "CreateTextComponent_cached", BenchCreateTextCached },
+	{ "CreateTextComponent_uncached", BenchCreateTextUncached },
+	{ "DrawTextComponent", BenchDrawTextComponent },
+	{ "DrawTextComponent_glyphs", BenchDrawGlyphText },
+	{ "DrawImage", BenchDrawImage },
+	{ "DrawBatchedFrame", BenchDrawBatchedFrame },
+	{ "Scenario_match_frame", BenchMatchScenario },
+	{ "Scenario_menu_frame", BenchMenuScenario },
+	{ "Scenario_menu_frame_retained", BenchMenuRetainedScenario },
+#endif
+};
+
+// name,ns_per_op,iterations rows as printed by this program
+std::vector<BenchResult> LoadBaseline(const char* path)
+{
+	std::vector<BenchResult> baseline;
+
+	FILE* file = fopen(path, "r");
+	if (file == NULL)
+	{
+		printf("Baseline %s could not be opened\n", path);
+		return baseline;
+	}
+
+	char line[256];
+	while (fgets(line, sizeof(line), file))
+	{
+		char name[128];
+		double nsPerOp;
+		long long iterations;
+		if (sscanf(line, "%127[^,],%lf,%lld", name, &nsPerOp, &iterations) == 3)
+		{
+			baseline.push_back({ name, nsPerOp, iterations });
+		}
+	}
+
+	fclose(file);
+	return baseline;
+}
+
+void PrintUsage()
+{
+	printf("Usage: pingpong_bench [options]\n");
+	printf("  --filter TEXT        only benchmarks whose name contains TEXT\n");
+	printf("  --baseline FILE      compare against an earlier run's output\n");
+	printf("  --threshold PERCENT  slowdown that fails the comparison, default 10\n");
+#ifndef BENCH_NO_RENDER
+	printf("  --alloc-check        only check that steady state gameplay frames never allocate\n");
+#endif
+}
+
+int main(int argc, char* args[])
+{
+	const char* filter = "";
+	const char* baselinePath = NULL;
+	double threshold = 10;
+#ifndef BENCH_NO_RENDER
+	bool allocCheck = false;
+#endif
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* value = i + 1 < argc ? args[i + 1] : NULL;
+
+#ifndef BENCH_NO_RENDER
+		if (strcmp(args[i], "--alloc-check") == 0)
+		{
+			allocCheck = true;
+			continue;
+		}
+#endif
+		if (strcmp(args[i], "--filter") == 0 && value) filter = value;
+		else if (strcmp(args[i], "--baseline") == 0 && value) baselinePath = value;
+		else if (strcmp(args[i], "--threshold") == 0 && value) threshold = atof(value);
+		else
+		{
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+		i++;
+	}
+
+	std::vector<BenchResult> baseline;
+	if (baselinePath != NULL)
+	{
+		baseline = LoadBaseline(baselinePath);
+		if (baseline.empty())
+		{
+			return EXIT_FAILURE;
+		}
+	}
+
+	SetupSimulation();
+#ifndef BENCH_NO_RENDER
+	if (allocCheck)
+	{
+		HookSDLAllocations();
+	}
+
+	if (!SetupRender())
+	{
+		return EXIT_FAILURE;
+	}
+
+	if (allocCheck)
+	{
+		int allocatingFrames = CheckMatchAllocations();
+		QuitRender();
+		SimBatchFree(batch);
+		return allocatingFrames == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+#endif
+
+	if (baselinePath == NULL)
+	{
+		printf("benchmark,ns_per_op,iterations\n");
+	}
+	else
+	{
+		printf("benchmark,ns_per_op,baseline_ns_per_op,change_percent,status\n");
+	}
+
+	int regressions = 0;
+	for (const BenchEntry& entry : BENCHMARKS)
+	{
+		if (strstr(entry.name, filter) == NULL)
+		{
+			continue;
+		}
+
+		BenchResult result = RunBenchmark(entry.name, entry.function);
+
+		if (baselinePath == NULL)
+		{
+			printf("%s,%.3f,%lld\n", result.name.c_str(), result.nsPerOp, result.iterations);
+			fflush(stdout);
+			continue;
+		}
+
+		const BenchResult* previous = NULL;
+		for (const BenchResult& b : baseline)
+		{
+			if (b.name == result.name)
+			{
+				previous = &b;
+			}
+		}
+
+		if (previous == NULL)
+		{
+			printf("%s,%.3f,,,new\n", result.name.c_str(), result.nsPerOp);
+			continue;
+		}
+
+		double change = (result.nsPerOp / previous->nsPerOp - 1) * 100;
+		printf("%s,%.3f,%.3f,%+.1f,%s\n", result.name.c_str(), result.nsPerOp, previous->nsPerOp, change, change > threshold ? "REGRESSION" : "ok");
+		fflush(stdout);
+		regressions += change > threshold;
+	}
+
+#ifndef BENCH_NO_RENDER
+	QuitRender();
+#endif
+	SimBatchFree(batch);
+
+	return regressions == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,173 @@
+#include "SharedEnv.h"
+#include "Profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// Serves the vectorized environment to a trainer through shared memory, or
+// measures stepping it from another process against stepping it in process.
+
+const char* BENCH_ENV_NAME = "pingpong_env_bench";
+
+void PrintUsage()
+{
+	printf("Usage: pingpong_env serve NAME [MATCHES]         serves MATCHES matches (default 1024) at /dev/shm/NAME\n");
+	printf("       pingpong_env bench [MATCHES] [STEPS]      steps in process, then from another process, and compares\n");
+}
+
+// Trainer stand-in: follows the ball with the paddle center
+void Policy(const float* observations, int count, int* actions)
+{
+	const float half = (PADDLE_HEIGHT - BALL_SIZE) / 2.0f / ARENA_HEIGHT;
+	const float margin = 4.0f / ARENA_HEIGHT;
+
+	for (int i = 0; i < count; i++)
+	{
+		const float* o = observations + i * ENV_OBSERVATION_SIZE;
+		float offset = o[ENV_BALL_Y] - (o[ENV_PLAYER_Y] + half);
+		actions[i] = offset > margin ? DIRECTION_DOWN : offset < -margin ? DIRECTION_UP : DIRECTION_STOP;
+	}
+}
+
+typedef struct BenchRun
+{
+	double seconds;
+	double rewards;
+	int dones;
+	std::vector<float> observations; // After the last step
+} BenchRun;
+
+BenchRun RunInProcess(int count, int steps)
+{
+	VecEnv env;
+	VecEnvInit(env, count, SimDefaultConfig());
+
+	std::vector<int> actions(count);
+	std::vector<float> observations(count * ENV_OBSERVATION_SIZE);
+	std::vector<float> rewards(count);
+	std::vector<unsigned char> dones(count);
+
+	BenchRun run = {};
+	VecEnvReset(env, 1, observations.data());
+
+	long long start = ProfileNow();
+	for (int step = 0; step < steps; step++)
+	{
+		Policy(observations.data(), count, actions.data());
+		VecEnvStep(env, actions.data(), observations.data(), rewards.data(), dones.data());
+		for (int i = 0; i < count; i++)
+		{
+			run.rewards += rewards[i];
+			run.dones += dones[i];
+		}
+	}
+	run.seconds = (ProfileNow() - start) / 1e9;
+
+	run.observations = observations;
+	VecEnvFree(env);
+	return run;
+}
+
+bool RunOtherProcess(int count, int steps, BenchRun& run)
+{
+	static EnvServer server;
+	if (!EnvServerOpen(server, BENCH_ENV_NAME, count, SimDefaultConfig()))
+	{
+		return false;
+	}
+
+	pid_t child = fork();
+	if (child == 0)
+	{
+		EnvServe(server);
+		_exit(EXIT_SUCCESS);
+	}
+
+	// Attached by name, as an outside trainer would
+	EnvClient client;
+	bool ok = child > 0 && EnvClientOpen(client, BENCH_ENV_NAME);
+	if (ok)
+	{
+		EnvShared& shared = client.shared;
+		run = BenchRun();
+		EnvClientReset(client, 1);
+
+		long long start = ProfileNow();
+		for (int step = 0; step < steps; step++)
+		{
+			Policy(shared.observations, count, shared.actions);
+			EnvClientStep(client);
+			for (int i = 0; i < count; i++)
+			{
+				run.rewards += shared.rewards[i];
+				run.dones += shared.dones[i];
+			}
+		}
+		run.seconds = (ProfileNow() - start) / 1e9;
+
+		run.observations.assign(shared.observations, shared.observations + count * ENV_OBSERVATION_SIZE);
+		EnvClientClose(client);
+	}
+
+	if (child > 0)
+	{
+		waitpid(child, NULL, 0);
+	}
+	EnvServerClose(server);
+	return ok;
+}
+
+int Bench(int count, int steps)
+{
+	BenchRun local = RunInProcess(count, steps);
+	BenchRun remote;
+	if (!RunOtherProcess(count, steps, remote))
+	{
+		return EXIT_FAILURE;
+	}
+
+	double matchSteps = (double)count * steps;
+	printf("%d matches, %d steps, %.0f rewards, %d episodes done\n", count, steps, local.rewards, local.dones);
+	printf("in process:    %.0f match steps/s, %.2f us per step\n", matchSteps / local.seconds, local.seconds / steps * 1e6);
+	printf("other process: %.0f match steps/s, %.2f us per step, %.0f%% of in process\n",
+		matchSteps / remote.seconds, remote.seconds / steps * 1e6, local.seconds / remote.seconds * 100);
+
+	bool same = local.rewards == remote.rewards && local.dones == remote.dones && local.observations == remote.observations;
+	printf(same ? "OK\n" : "FAILED, the two runs differ\n");
+	return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char* args[])
+{
+	if (argc >= 3 && argc <= 4 && strcmp(args[1], "serve") == 0)
+	{
+		int count = argc > 3 ? atoi(args[3]) : 1024;
+		static EnvServer server;
+		if (count < 1 || !EnvServerOpen(server, args[2], count, SimDefaultConfig()))
+		{
+			return EXIT_FAILURE;
+		}
+
+		printf("Serving %d matches at /dev/shm/%s, %d floats per observation\n", count, args[2], ENV_OBSERVATION_SIZE);
+		fflush(stdout);
+		EnvServe(server);
+		EnvServerClose(server);
+		return EXIT_SUCCESS;
+	}
+
+	if (argc >= 2 && argc <= 4 && strcmp(args[1], "bench") == 0)
+	{
+		int count = argc > 2 ? atoi(args[2]) : 1024;
+		int steps = argc > 3 ? atoi(args[3]) : 20000;
+		if (count > 0 && steps > 0)
+		{
+			return Bench(count, steps);
+		}
+	}
+
+	PrintUsage();
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <SDL.h>
+#include "Simulation.h"
+
+// Drawing pieces of Main.cpp shared with the benchmark.
+// Build Main.cpp with PINGPONG_NO_MAIN to link it into another program.
+
+typedef struct Position
+{
+	int x, y;
+} Position;
+
+// Ball and paddle sprite, physics live in SimBody
+typedef struct Component
+{
+	SDL_Rect rect;
+	SDL_Texture* texture; // Shared sprite atlas
+	SDL_Rect sprite; // Source rect inside the atlas
+} Component;
+
+// Longest label, the text is kept in place so changing it never allocates
+const int TEXT_CAPACITY = 64;
+
+// Text Component
+typedef struct TextComponent
+{
+	SDL_Rect rect;
+	char text[TEXT_CAPACITY];
+	const char* font;
+	int fontSize;
+	SDL_Color fontColor;
+	SDL_Texture* texture; // Owned by the text cache, or the glyph atlas
+	void (*placement)(SDL_Rect&, int); // Pointer to a placement Function
+	bool glyphs; // Drawn a character at a time from a glyph atlas, for text that keeps changing
+} TextComponent;
+
+extern SDL_Renderer* renderer;
+
+extern SDL_Rect BALL_SPRITE;
+extern SDL_Rect PADDLE_SPRITE;
+
+extern const char* WORK_SANS_THIN;
+extern const char* WORK_SANS_REGULAR;
+extern const char* WORK_SANS_EXTRABOLD;
+
+// Queues every asset for the resource manager, sounds and music only with audio
+void QueueGameResources(bool audio);
+
+void LoadSpriteAtlas();
+void ClearSpriteAtlas();
+void ClearTextCache();
+void ClearFonts();
+
+void DrawImage(SDL_Texture* texture, SDL_Rect sprite, int x, int y);
+
+void PlaceMiddle(SDL_Rect& rect, int padding = 0);
+void PlaceLeftMiddle(SDL_Rect& rect, int padding = 0);
+void PlaceRightMiddle(SDL_Rect& rect, int padding = 0);
+void PlaceRightBottom(SDL_Rect& rect, int padding = 0);
+void PlaceMiddleBottom(SDL_Rect& rect, int padding = 0);
+void PlaceMiddleTop(SDL_Rect& rect, int padding = 0);
+
+Component CreateComponent(Position position, SDL_Rect sprite);
+void DrawComponent(Component c);
+void FreeComponent(Component& c);
+
+TextComponent CreateTextComponent(Position position, const char* text, const char* font, int size, SDL_Color color, void (*placement)(SDL_Rect&, int), bool glyphs = false);
+void SetText(TextComponent& c, const char* text); // Cut at TEXT_CAPACITY
+void DrawTextComponent(TextComponent& c, int padding);
+void FreeTextComponent(TextComponent& c);
+
+// The gameplay screen exactly as MainLoop runs it, against the sim thread,
+// without a window or input events. Each frame draws GamePlayLogic and
+// submits it through the render batch; the returned state is the one drawn.
+void StartGameplayScreen();
+const SimState& GameplayScreenFrame();
+void StopGameplayScreen();
+
+// Counts SDL's allocations with AllocCounter.h, the original allocator still does the work
+void HookSDLAllocations();
+
+SDL_Rect ToSDLRect(const SimRect& rect);
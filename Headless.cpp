@@ -0,0 +1,133 @@
+#include "Simulation.h"
+#include "SimBatch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+typedef struct HeadlessResult
+{
+	long long ticks;
+	int playerWins;
+	int enemyWins;
+	int draws;
+} HeadlessResult;
+
+void CountResult(HeadlessResult& result, int playerPoints, int enemyPoints)
+{
+	if (playerPoints > enemyPoints)
+	{
+		result.playerWins++;
+	}
+	else if (playerPoints < enemyPoints)
+	{
+		result.enemyWins++;
+	}
+	else
+	{
+		result.draws++;
+	}
+}
+
+HeadlessResult RunSingle(int matches)
+{
+	HeadlessResult result = {};
+
+	for (int i = 0; i < matches; i++)
+	{
+		SimState state;
+		SimInit(state, SimDefaultConfig());
+
+		while (!state.finished)
+		{
+			SimStep(state, SimAutopilotInput(state));
+			result.ticks++;
+		}
+
+		CountResult(result, state.playerPoints, state.enemyPoints);
+	}
+
+	return result;
+}
+
+HeadlessResult RunBatch(int matches, SimKernel kernel)
+{
+	HeadlessResult result = {};
+
+	SimBatch batch;
+	SimBatchInit(batch, matches, SimDefaultConfig());
+
+	// Matches keep stepping until the last one is over
+	int running = matches;
+	while (running > 0)
+	{
+		SimBatchAutopilot(batch);
+		SimBatchStep(batch, kernel);
+		result.ticks += running;
+
+		running = 0;
+		for (int i = 0; i < matches; i++)
+		{
+			running += batch.finished[i] == 0;
+		}
+	}
+
+	for (int i = 0; i < matches; i++)
+	{
+		CountResult(result, batch.playerPoints[i], batch.enemyPoints[i]);
+	}
+
+	SimBatchFree(batch);
+	return result;
+}
+
+void PrintUsage()
+{
+	printf("Usage: pingpong_headless [matches] [single|auto|scalar|sse2|avx2]  100 single matches by default\n");
+}
+
+// Plays whole matches with the autopilot against the enemy, without a window.
+int main(int argc, char* args[])
+{
+	// A whole number, within what a batch can hold
+	char* end = NULL;
+	long count = argc > 1 ? strtol(args[1], &end, 10) : 100;
+	const char* engine = argc > 2 ? args[2] : "single";
+	if (argc > 3 || (end != NULL && (end == args[1] || *end != '\0')) || count < 1 || count > 1 << 24)
+	{
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+	int matches = (int)count;
+
+	SimKernel kernel = SimKernel::AUTO;
+	if (strcmp(engine, "scalar") == 0) kernel = SimKernel::SCALAR;
+	else if (strcmp(engine, "sse2") == 0) kernel = SimKernel::SSE2;
+	else if (strcmp(engine, "avx2") == 0) kernel = SimKernel::AVX2;
+	else if (strcmp(engine, "single") != 0 && strcmp(engine, "auto") != 0)
+	{
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	HeadlessResult result;
+	if (strcmp(engine, "single") == 0)
+	{
+		result = RunSingle(matches);
+	}
+	else
+	{
+		engine = SimKernelName(kernel == SimKernel::AUTO ? SimBatchBestKernel() : kernel);
+		result = RunBatch(matches, kernel);
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	printf("engine: %s\n", engine);
+	printf("matches: %d  player: %d  enemy: %d  draws: %d\n", matches, result.playerWins, result.enemyWins, result.draws);
+	printf("ticks: %lld  seconds: %.3f  ticks/s: %.0f\n", result.ticks, elapsed.count(), result.ticks / elapsed.count());
+
+	return EXIT_SUCCESS;
+}
@@ -4,38 +4,45 @@
 #include <SDL_mixer.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
 #include <windows.h>
-#include <string>
+#endif
 #include <iostream>
-
-// Main Structs
-typedef struct Position
-{
-	int x, y;
-} Position;
-
-// Ball and paddle Struct
-typedef struct Component
-{
-	SDL_Rect rect;
-	SDL_Surface* imageSurface;
-
-	int velocity;
-	int xDirection;
-	int yDirection;
-} Component;
-
-// Text Component
-typedef struct TextComponent
+#include "Simulation.h"
+#include "Game.h"
+#include "Replay.h"
+#include "SimThread.h"
+#include "Rollback.h"
+#include "Spectator.h"
+#include "Profiler.h"
+#include "Resources.h"
+#include "Music.h"
+#include "RenderBatch.h"
+#include "AllocCounter.h"
+
+// Main Structs, Position, Component and TextComponent are in Game.h
+
+// Rendered text kept resident on the GPU
+typedef struct TextCacheEntry
 {
-	SDL_Rect rect;
-	std::string text;
+	char text[TEXT_CAPACITY];
 	const char* font;
 	int fontSize;
 	SDL_Color fontColor;
-	SDL_Surface* surface;
-	void (*placement)(SDL_Rect&, int); // Pointer to a placement Function
-} TextComponent;
+	SDL_Texture* texture;
+	int w, h;
+	Uint32 lastUsed; // Used to evict the least recently drawn text
+} TextCacheEntry;
+
+// Opened font shared by every text using the same file and size
+typedef struct FontCacheEntry
+{
+	const char* path;
+	int size;
+	TTF_Font* font;
+	ResourceHandle resource; // Font file in memory
+} FontCacheEntry;
 
 enum class Screen {
 	MAIN_MENU,
@@ -53,18 +60,11 @@ enum class Button {
 
 // GAME SETTINGS
 const char* WINDOW_TITLE = "Ping Pong classic 1.0";
-const int WINDOW_WIDTH = 1280;
-const int WINDOW_HEIGHT = 768;
-const int SCREEN_FPS = 60;
-const int SCREEN_TICKS_PER_FRAME = 1000 / SCREEN_FPS;
-const int MATCH_DURATION = 120;
-
-// Difficulty
-int TOO_YOUNG_TO_DIE = (int)(WINDOW_WIDTH / 3);
-int ULTRA_VIOLENCE = (int)(WINDOW_WIDTH / 2);
-int NIGHTMARE = (int)(WINDOW_WIDTH / 1.1);
-
-const int DIFFICULTY_LEVEL = ULTRA_VIOLENCE;
+const int WINDOW_WIDTH = ARENA_WIDTH;
+const int WINDOW_HEIGHT = ARENA_HEIGHT;
+const int TEXT_CACHE_SIZE = 32;
+const int FONT_CACHE_SIZE = 16; // Every font and size the game and the benchmark use fit
+const int GLYPH_ATLAS_SIZE = 8;
 
 // Initial Screen
 const Screen FIRST_SCREEN = Screen::MAIN_MENU;
@@ -72,10 +72,55 @@ const Screen FIRST_SCREEN = Screen::MAIN_MENU;
 //SDL classes
 SDL_Window* window = NULL;
 SDL_Renderer* renderer = NULL;
-Mix_Music* music = NULL;
-Mix_Chunk* pongSound = NULL;
-Mix_Chunk* selectSound = NULL;
-Mix_Chunk* navigateSound = NULL;
+
+// Loaded by the resource manager
+ResourceHandle music = NO_RESOURCE;
+ResourceHandle pongSound = NO_RESOURCE;
+ResourceHandle selectSound = NO_RESOURCE;
+ResourceHandle navigateSound = NO_RESOURCE;
+ResourceHandle windowIcon = NO_RESOURCE;
+int musicVolume = 64;
+bool musicPending = false; // Starts playing once loaded
+
+// Sprite atlas
+SDL_Texture* spriteAtlas = NULL;
+SDL_Rect BALL_SPRITE;
+SDL_Rect PADDLE_SPRITE;
+
+// Text cache
+TextCacheEntry textCache[TEXT_CACHE_SIZE];
+Uint32 textCacheClock = 0;
+int textCacheHits = 0;
+int textCacheMisses = 0;
+
+// Font cache
+FontCacheEntry fontCache[FONT_CACHE_SIZE];
+int fontCacheCount = 0;
+
+// Glyph atlases, printable ASCII
+const int GLYPH_FIRST = ' ';
+const int GLYPH_COUNT = '~' - ' ' + 1;
+const int GLYPH_ATLAS_WIDTH = 1024; // Rows wrap past it
+
+typedef struct GlyphAtlas
+{
+	const char* font;
+	int fontSize;
+	SDL_Color fontColor;
+	SDL_Texture* texture;
+	SDL_Rect glyphs[GLYPH_COUNT]; // Inside texture, w is also the advance
+} GlyphAtlas;
+
+GlyphAtlas glyphAtlases[GLYPH_ATLAS_SIZE];
+int glyphAtlasCount = 0;
+
+// Every asset packed by pingpong_pack, loose files are used without it
+#ifdef PINGPONG_EMBEDDED_ASSETS
+extern const unsigned char PINGPONG_ASSETS[];
+extern const size_t PINGPONG_ASSETS_SIZE;
+#else
+const char* ASSET_ARCHIVE_PATH = "assets.pak";
+#endif
 
 // Images
 const char* BALL_IMAGE_PATH = "resources/img/ball.png";
@@ -97,189 +142,664 @@ const char* NAVIGATE_SOUND_PATH = "resources/Sounds/navigate.mp3";
 const char* PONG_SOUND_PATH = "resources/Sounds/pong.mp3";
 const char* SELECT_SOUND_PATH = "resources/Sounds/select.mp3";
 
-// Directions
-const int DIRECTION_STOP = 0;
-const int DIRECTION_UP = -1;
-const int DIRECTION_DOWN = 1;
-const int DIRECTION_LEFT = -1;
-const int DIRECTION_RIGHT = 1;
+// Every match is recorded here, overwriting the previous one
+const char* REPLAY_PATH = "last_match.ppr";
+
+// Two player match over UDP, from the command line. Falls back to the bot
+// when the session can't be opened.
+bool networkMatch = false;
+NetSetup networkSetup;
+RollbackSession networkSession;
+
+// Spectator streams through pingpong_relay, from the command line. A
+// spectating game shows the relayed match instead of playing one.
+const char* broadcastAddress = NULL;
+SpectatorPublisher broadcast;
+const char* spectateAddress = NULL;
+SpectatorViewer spectator;
+
+// Input goes to the sim thread the moment SDL queues it, stamped with when
+// that happened. Low latency mode presents without vsync and, between
+// frames, waits on SDL's queue so nothing waits for the next frame to be read.
+bool lowLatencyInput = false;
+long long inputClockOffset = 0; // ProfileNow() minus SDL_GetTicks(), nanoseconds
+long long framePeriod = 1000000000LL / 60; // Of the display, nanoseconds
+const int STICK_DEAD_ZONE = 8000; // Of 32767
+SDL_threadID mainThread; // The only one the input watch pushes commands from
+
+// Events PumpInputUntil took off SDL's queue while waiting, the next frame
+// polls them before SDL's own
+const int HELD_EVENTS_SIZE = 64;
+SDL_Event heldEvents[HELD_EVENTS_SIZE];
+int heldEventCount = 0;
+int heldEventRead = 0;
+
+// Input to present measurements, from the command line. The first frame
+// drawn after an input was applied gets a white square in the top left
+// corner for a photodiode on the screen.
+bool latencyTest = false;
+long long latencyShown = 0; // Input time of the last frame measured
+long long latencyPending = 0; // Input time of the frame being presented
+const int LATENCY_MARKER_SIZE = 64;
+
+// Steady state check, from the command line. Once a match has run for
+// ALLOC_WARMUP_FRAMES, every gameplay frame that allocates is reported and
+// the game exits with a failure.
+bool allocCheck = false;
+const int ALLOC_WARMUP_FRAMES = 120;
+int allocatingFrames = 0;
+
+// Profiler output, written on exit
+const char* PROFILE_TRACE_PATH = "profile_trace.json";
+const char* PROFILE_HISTOGRAM_PATH = "profile_histograms.txt";
+
+// Profiler overlay, toggled with F3
+bool profilerOverlay = false;
+char profilerText[128] = "";
+int profilerTextAge = 0;
+const int PROFILER_FONT_SIZE = 18;
+RenderBatchStats frameBatches = {}; // Last frame's draws
+
+// Set by whatever changes the picture, other frames are not presented
+bool redrawFrame = true;
+const Uint32 IDLE_FRAME_MS = 1000 / 60;
+const int IDLE_WAKE_MS = 250; // Longest a menu sleeps without events
+
+void QueueGameResources(bool audio)
+{
+	QueueResource(WORK_SANS_THIN, ResourceType::FONT);
+	QueueResource(WORK_SANS_REGULAR, ResourceType::FONT);
+	QueueResource(WORK_SANS_EXTRABOLD, ResourceType::FONT);
+
+	QueueResource(BALL_IMAGE_PATH, ResourceType::IMAGE);
+	QueueResource(PADDLE_IMAGE_PATH, ResourceType::IMAGE);
+	QueueResource(ICON_IMAGE_PATH, ResourceType::IMAGE);
+
+	if (audio)
+	{
+		QueueResource(MAIN_MENU_MUSIC_PATH, ResourceType::MUSIC);
+		QueueResource(GAMEPLAY_MUSIC_PATH, ResourceType::MUSIC);
+		QueueResource(RESULT_MENU_MUSIC_PATH, ResourceType::MUSIC);
+
+		QueueResource(NAVIGATE_SOUND_PATH, ResourceType::SOUND);
+		QueueResource(PONG_SOUND_PATH, ResourceType::SOUND);
+		QueueResource(SELECT_SOUND_PATH, ResourceType::SOUND);
+	}
+}
 
 void ClearMusic()
 {
-	Mix_FreeMusic(music);
-	music = NULL;
+	PlayMusic(NULL, 0);
+	ReleaseResource(music);
+	musicPending = false;
 }
 
-void LoadAndPlayMusic(const char* path, int volume = 64)
+void UpdateMusic()
 {
-	ClearMusic();
-	music = Mix_LoadMUS(path);
+	if (musicPending && ResourceReady(music))
+	{
+		PlayMusic(ResourceSound(music), musicVolume);
+		musicPending = false;
+	}
+}
 
-	Mix_VolumeMusic(volume);
+void CrossfadeMusic(const char* path, int volume = 64)
+{
+	// Decoded at startup and kept by the resource manager, so switching
+	// never reopens the file. If it's still loading it starts later.
+	ReleaseResource(music);
+	music = AcquireResource(path);
+	musicVolume = volume;
+	musicPending = true;
+	UpdateMusic();
+}
 
-	Mix_PlayMusic(music, -1);
+void PlaySoundOnce(ResourceHandle sound)
+{
+	// Not queued without audio
+	if (sound == NO_RESOURCE)
+	{
+		return;
+	}
+	Mix_PlayChannel(-1, ResourceSound(sound), 0);
 }
 
-void PlaySoundOnce(Mix_Chunk* sound)
+// Things that waited for the background loaders
+void UpdateResources()
 {
-	Mix_PlayChannel(-1, sound, 0);
+	UpdateMusic();
+
+	if (windowIcon != NO_RESOURCE && ResourceReady(windowIcon))
+	{
+		SDL_SetWindowIcon(window, ResourceImage(windowIcon));
+		ReleaseResource(windowIcon);
+		UnloadResource(ICON_IMAGE_PATH);
+	}
 }
 
 void DrawRectangle(SDL_Rect rect, SDL_Color color, bool filled = true)
 {
-	//Fill the surface black
-	SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-	filled ? SDL_RenderFillRect(renderer, &rect) : SDL_RenderDrawRect(renderer, &rect);
+	// Queued with the frame's other draws
+	filled ? BatchRect(rect, color, RENDER_LAYER_GAME) : BatchOutline(rect, color, RENDER_LAYER_GAME);
 }
 
-void DrawImage(SDL_Surface* image, int x, int y)
+void DrawImage(SDL_Texture* texture, SDL_Rect sprite, int x, int y)
 {
-	// Create texture from surface
-	SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, image);
-
 	// Set position of the image
-	SDL_Rect rect;
-	rect.x = x;
-	rect.y = y;
-	SDL_QueryTexture(texture, nullptr, nullptr, &rect.w, &rect.h);
+	SDL_Rect rect = { x, y, sprite.w, sprite.h };
+
+	// Render the sprite from the atlas, batched with every other atlas sprite
+	BatchTexture(texture, &sprite, rect, RENDER_LAYER_GAME);
+}
 
-	// Render the image texture
-	SDL_RenderCopy(renderer, texture, nullptr, &rect);
+void LoadSpriteAtlas()
+{
+	ResourceHandle ballImage = AcquireResource(BALL_IMAGE_PATH);
+	ResourceHandle paddleImage = AcquireResource(PADDLE_IMAGE_PATH);
+	SDL_Surface* ball = ResourceImage(ballImage);
+	SDL_Surface* paddle = ResourceImage(paddleImage);
+
+	if (ball == NULL || paddle == NULL)
+	{
+		printf("Sprites could not be loaded! IMG_Error: %s\n", IMG_GetError());
+		exit(EXIT_FAILURE);
+	}
 
-	// Destroy Texture
-	SDL_DestroyTexture(texture);
-	texture = NULL;
+	// Pack the sprites side by side, leaving one transparent pixel between them
+	BALL_SPRITE = { 0, 0, ball->w, ball->h };
+	PADDLE_SPRITE = { ball->w + 1, 0, paddle->w, paddle->h };
+
+	int width = PADDLE_SPRITE.x + PADDLE_SPRITE.w;
+	int height = ball->h > paddle->h ? ball->h : paddle->h;
+	SDL_Surface* atlas = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA32);
+	SDL_FillRect(atlas, NULL, 0);
+
+	// Copy pixels and alpha as they are
+	SDL_SetSurfaceBlendMode(ball, SDL_BLENDMODE_NONE);
+	SDL_SetSurfaceBlendMode(paddle, SDL_BLENDMODE_NONE);
+	SDL_BlitSurface(ball, NULL, atlas, &BALL_SPRITE);
+	SDL_BlitSurface(paddle, NULL, atlas, &PADDLE_SPRITE);
+
+	// Upload once, the CPU copies are not needed anymore
+	spriteAtlas = SDL_CreateTextureFromSurface(renderer, atlas);
+
+	SDL_FreeSurface(atlas);
+	atlas = NULL;
+	ball = NULL;
+	paddle = NULL;
+
+	ReleaseResource(ballImage);
+	ReleaseResource(paddleImage);
+	UnloadResource(BALL_IMAGE_PATH);
+	UnloadResource(PADDLE_IMAGE_PATH);
 }
 
-void DrawTextFont(SDL_Surface* surface, int x, int y)
+void ClearSpriteAtlas()
 {
-	// Create texture from surface
-	SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
+	FlushRenderBatch();
+	SDL_DestroyTexture(spriteAtlas);
+	spriteAtlas = NULL;
+}
 
-	// Set position of the text
-	SDL_Rect rect;
-	rect.x = x;
-	rect.y = y;
-	SDL_QueryTexture(texture, nullptr, nullptr, &rect.w, &rect.h);
+void DrawTextFont(SDL_Texture* texture, SDL_Rect rect, RenderLayer layer = RENDER_LAYER_UI)
+{
+	// Render the cached text texture
+	BatchTexture(texture, NULL, rect, layer);
+}
 
-	// Render the text texture
-	SDL_RenderCopy(renderer, texture, nullptr, &rect);
+TTF_Font* GetFont(const char* path, int size)
+{
+	for (int i = 0; i < fontCacheCount; i++)
+	{
+		if (fontCache[i].size == size && strcmp(fontCache[i].path, path) == 0)
+		{
+			return fontCache[i].font;
+		}
+	}
+
+	// Not opened yet. Nothing is evicted, a caller may still hold a font
+	// returned earlier, so the cache has room for every size in use.
+	SDL_assert(fontCacheCount < FONT_CACHE_SIZE);
+	if (fontCacheCount == FONT_CACHE_SIZE)
+	{
+		printf("Font cache full, %s at %d not opened\n", path, size);
+		return NULL;
+	}
+	int slot = fontCacheCount++;
 
-	// Destroy texture
-	SDL_DestroyTexture(texture);
-	texture = NULL;
+	// Opened from the file already in memory
+	fontCache[slot].path = path;
+	fontCache[slot].size = size;
+	fontCache[slot].resource = AcquireResource(path);
+	SDL_RWops* stream = ResourceStream(fontCache[slot].resource);
+	fontCache[slot].font = stream != NULL ? TTF_OpenFontRW(stream, 1, size) : NULL;
+
+	if (fontCache[slot].font == NULL)
+	{
+		printf("Font could not be opened! TTF_Error: %s\n", TTF_GetError());
+	}
+
+	return fontCache[slot].font;
 }
 
-void PlaceMiddle(SDL_Rect& rect, int padding = 0)
+void ClearFonts()
+{
+	for (int i = 0; i < fontCacheCount; i++)
+	{
+		TTF_CloseFont(fontCache[i].font);
+		fontCache[i].font = NULL;
+		ReleaseResource(fontCache[i].resource);
+	}
+	fontCacheCount = 0;
+}
+
+bool SameColor(SDL_Color a, SDL_Color b)
+{
+	return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+bool TextCacheEntryMatches(const TextCacheEntry& entry, const char* text, const char* font, int size, SDL_Color color)
+{
+	return entry.texture != NULL
+		&& entry.fontSize == size
+		&& SameColor(entry.fontColor, color)
+		&& strcmp(entry.font, font) == 0
+		&& strcmp(entry.text, text) == 0;
+}
+
+// text fits TEXT_CAPACITY, TextComponent keeps it that way
+TextCacheEntry& GetCachedText(const char* text, const char* font, int size, SDL_Color color)
+{
+	textCacheClock++;
+
+	// Look for the text already rendered, remembering the least recently used slot
+	int oldest = 0;
+	for (int i = 0; i < TEXT_CACHE_SIZE; i++)
+	{
+		TextCacheEntry& entry = textCache[i];
+		if (TextCacheEntryMatches(entry, text, font, size, color))
+		{
+			textCacheHits++;
+			entry.lastUsed = textCacheClock;
+			return entry;
+		}
+
+		if (entry.texture == NULL || (textCache[oldest].texture != NULL && entry.lastUsed < textCache[oldest].lastUsed))
+		{
+			oldest = i;
+		}
+	}
+
+	// Not found, rasterize it into the evicted slot
+	textCacheMisses++;
+	TextCacheEntry& entry = textCache[oldest];
+	if (entry.texture != NULL)
+	{
+		// A draw of it may still be queued
+		FlushRenderBatch();
+		SDL_DestroyTexture(entry.texture);
+	}
+
+	SDL_Surface* surface;
+	{
+		ProfileScope scope(PROFILE_TEXT_RASTER);
+		surface = TTF_RenderText_Blended(GetFont(font, size), text, color);
+	}
+
+	snprintf(entry.text, sizeof(entry.text), "%s", text);
+	entry.font = font;
+	entry.fontSize = size;
+	entry.fontColor = color;
+	{
+		ProfileScope scope(PROFILE_TEXTURE_UPLOAD);
+		entry.texture = SDL_CreateTextureFromSurface(renderer, surface);
+	}
+	entry.w = surface->w;
+	entry.h = surface->h;
+	entry.lastUsed = textCacheClock;
+
+	SDL_FreeSurface(surface);
+	surface = NULL;
+
+	return entry;
+}
+
+void ClearTextCache()
+{
+	FlushRenderBatch();
+	for (int i = 0; i < TEXT_CACHE_SIZE; i++)
+	{
+		SDL_DestroyTexture(textCache[i].texture);
+		textCache[i].texture = NULL;
+		textCache[i].text[0] = '\0';
+	}
+
+	for (int i = 0; i < glyphAtlasCount; i++)
+	{
+		SDL_DestroyTexture(glyphAtlases[i].texture);
+		glyphAtlases[i].texture = NULL;
+	}
+	glyphAtlasCount = 0;
+}
+
+// Every printable character of a font, size and color rasterized once into
+// one texture, packed like the sprite atlas. Text drawn from it costs draws
+// only, whatever it says, so labels that change every second never render,
+// allocate or upload anything.
+GlyphAtlas& GetGlyphAtlas(const char* font, int size, SDL_Color color)
+{
+	for (int i = 0; i < glyphAtlasCount; i++)
+	{
+		GlyphAtlas& atlas = glyphAtlases[i];
+		if (atlas.fontSize == size && SameColor(atlas.fontColor, color) && strcmp(atlas.font, font) == 0)
+		{
+			return atlas;
+		}
+	}
+
+	// Not built yet, when every slot is used the last one gets replaced
+	int slot = glyphAtlasCount < GLYPH_ATLAS_SIZE ? glyphAtlasCount++ : GLYPH_ATLAS_SIZE - 1;
+	GlyphAtlas& atlas = glyphAtlases[slot];
+	if (atlas.texture != NULL)
+	{
+		// A draw of it may still be queued
+		FlushRenderBatch();
+		SDL_DestroyTexture(atlas.texture);
+	}
+	atlas.font = font;
+	atlas.fontSize = size;
+	atlas.fontColor = color;
+	atlas.texture = NULL;
+	memset(atlas.glyphs, 0, sizeof(atlas.glyphs));
+
+	TTF_Font* ttf = GetFont(font, size);
+	if (ttf == NULL)
+	{
+		return atlas;
+	}
+
+	SDL_Surface* surfaces[GLYPH_COUNT];
+	int height = 1;
+	{
+		ProfileScope scope(PROFILE_TEXT_RASTER);
+		for (int i = 0; i < GLYPH_COUNT; i++)
+		{
+			surfaces[i] = TTF_RenderGlyph_Blended(ttf, (Uint16)(GLYPH_FIRST + i), color);
+			if (surfaces[i] != NULL && surfaces[i]->h > height)
+			{
+				height = surfaces[i]->h;
+			}
+		}
+	}
+
+	// Rows of glyphs, one transparent pixel between them
+	int x = 0;
+	int y = 0;
+	for (int i = 0; i < GLYPH_COUNT; i++)
+	{
+		if (surfaces[i] == NULL)
+		{
+			// Nothing to draw, only the space it takes
+			TTF_GlyphMetrics(ttf, (Uint16)(GLYPH_FIRST + i), NULL, NULL, NULL, NULL, &atlas.glyphs[i].w);
+			continue;
+		}
+
+		if (x + surfaces[i]->w > GLYPH_ATLAS_WIDTH)
+		{
+			x = 0;
+			y += height + 1;
+		}
+		atlas.glyphs[i] = { x, y, surfaces[i]->w, surfaces[i]->h };
+		x += surfaces[i]->w + 1;
+	}
+
+	SDL_Surface* pixels = SDL_CreateRGBSurfaceWithFormat(0, y > 0 ? GLYPH_ATLAS_WIDTH : x, y + height, 32, SDL_PIXELFORMAT_RGBA32);
+	SDL_FillRect(pixels, NULL, 0);
+	for (int i = 0; i < GLYPH_COUNT; i++)
+	{
+		if (surfaces[i] != NULL)
+		{
+			// Copy pixels and alpha as they are
+			SDL_SetSurfaceBlendMode(surfaces[i], SDL_BLENDMODE_NONE);
+			SDL_BlitSurface(surfaces[i], NULL, pixels, &atlas.glyphs[i]);
+			SDL_FreeSurface(surfaces[i]);
+		}
+	}
+
+	{
+		ProfileScope scope(PROFILE_TEXTURE_UPLOAD);
+		atlas.texture = SDL_CreateTextureFromSurface(renderer, pixels);
+	}
+	SDL_FreeSurface(pixels);
+
+	return atlas;
+}
+
+const SDL_Rect& GetGlyph(const GlyphAtlas& atlas, char c)
+{
+	int index = c - GLYPH_FIRST;
+	return atlas.glyphs[index >= 0 && index < GLYPH_COUNT ? index : '?' - GLYPH_FIRST];
+}
+
+void MeasureGlyphs(const GlyphAtlas& atlas, const char* text, int& w, int& h)
+{
+	w = 0;
+	h = 0;
+	for (const char* c = text; *c != '\0'; c++)
+	{
+		const SDL_Rect& glyph = GetGlyph(atlas, *c);
+		w += glyph.w;
+		h = glyph.h > h ? glyph.h : h;
+	}
+}
+
+void DrawGlyphs(const GlyphAtlas& atlas, const char* text, int x, int y, RenderLayer layer)
+{
+	for (const char* c = text; *c != '\0'; c++)
+	{
+		const SDL_Rect& glyph = GetGlyph(atlas, *c);
+		if (glyph.h > 0)
+		{
+			BatchTexture(atlas.texture, &glyph, { x, y, glyph.w, glyph.h }, layer);
+		}
+		x += glyph.w;
+	}
+}
+
+void PlaceMiddle(SDL_Rect& rect, int padding)
 {
 	rect.x = (WINDOW_WIDTH - rect.w) / 2;
 	rect.y = (WINDOW_HEIGHT - rect.h) / 2;
 }
 
-void PlaceLeftMiddle(SDL_Rect& rect, int padding = 0)
+void PlaceLeftMiddle(SDL_Rect& rect, int padding)
 {
 	rect.x = 0 + padding;
 	rect.y = (WINDOW_HEIGHT - rect.h) / 2;
 }
 
-void PlaceRightMiddle(SDL_Rect& rect, int padding = 0)
+void PlaceRightMiddle(SDL_Rect& rect, int padding)
 {
 	rect.x = WINDOW_WIDTH - rect.w - padding;
 	rect.y = (WINDOW_HEIGHT - rect.h) / 2;
 }
 
-void PlaceRightBottom(SDL_Rect& rect, int padding = 0)
+void PlaceRightBottom(SDL_Rect& rect, int padding)
 {
 	rect.x = WINDOW_WIDTH - rect.w - padding;
 	rect.y = WINDOW_HEIGHT - rect.h - padding;
 }
-void PlaceMiddleBottom(SDL_Rect& rect, int padding = 0)
+void PlaceMiddleBottom(SDL_Rect& rect, int padding)
 {
 	rect.x = (WINDOW_WIDTH - rect.w) / 2;
 	rect.y = WINDOW_HEIGHT - rect.h - padding;
 }
 
-void PlaceMiddleTop(SDL_Rect& rect, int padding = 0)
+void PlaceMiddleTop(SDL_Rect& rect, int padding)
 {
 	rect.x = (WINDOW_WIDTH - rect.w) / 2;
 	rect.y = 0 + padding;
 }
 
-Component CreateComponent(Position position, const char* imagePath) {
+Component CreateComponent(Position position, SDL_Rect sprite) {
 
-	SDL_Surface* imageSurface = IMG_Load(imagePath);
 	return {
 		{
 			position.x,
 			position.y,
-			imageSurface->clip_rect.w,
-			imageSurface->clip_rect.h,
+			sprite.w,
+			sprite.h,
 		},
-		imageSurface
+		spriteAtlas,
+		sprite
 	};
 }
 
-TextComponent CreateTextComponent(Position position, std::string text, const char* font, int size, SDL_Color color, void (*placement)(SDL_Rect&, int)) {
+TextComponent CreateTextComponent(Position position, const char* text, const char* font, int size, SDL_Color color, void (*placement)(SDL_Rect&, int), bool glyphs) {
 
-	TTF_Font* ttfFont = TTF_OpenFont(font, size);
-	SDL_Surface* surface = TTF_RenderText_Blended(ttfFont, text.c_str(), color);
-	TTF_CloseFont(ttfFont);
-	ttfFont = NULL;
-	return {
-		{
-			position.x,
-			position.y,
-			surface->clip_rect.w,
-			surface->clip_rect.h,
-		},
-		text,
-		font,
-		size,
-		color,
-		surface,
-		placement,
-	};
+	TextComponent c;
+	c.rect = { position.x, position.y, 0, 0 };
+	SetText(c, text);
+	c.font = font;
+	c.fontSize = size;
+	c.fontColor = color;
+	c.placement = placement;
+	c.glyphs = glyphs;
+
+	if (glyphs)
+	{
+		GlyphAtlas& atlas = GetGlyphAtlas(font, size, color);
+		c.texture = atlas.texture;
+		MeasureGlyphs(atlas, c.text, c.rect.w, c.rect.h);
+	}
+	else
+	{
+		TextCacheEntry& cached = GetCachedText(c.text, font, size, color);
+		c.texture = cached.texture;
+		c.rect.w = cached.w;
+		c.rect.h = cached.h;
+	}
+	return c;
+}
+
+void SetText(TextComponent& c, const char* text)
+{
+	snprintf(c.text, sizeof(c.text), "%s", text);
 }
 
 void FreeTextComponent(TextComponent& c)
 {
-	SDL_FreeSurface(c.surface);
-	c.surface = NULL;
+	// The texture belongs to the text cache, only drop the reference
+	c.texture = NULL;
 }
 
 void DrawComponent(Component c) {
-	DrawImage(c.imageSurface, c.rect.x, c.rect.y);
+	DrawImage(c.texture, c.sprite, c.rect.x, c.rect.y);
 }
 
 void DrawTextComponent(TextComponent& c, int padding) {
-	FreeTextComponent(c);
-	c = CreateTextComponent({ c.rect.x, c.rect.y }, c.text, c.font, c.fontSize, c.fontColor, c.placement);
+	if (c.glyphs)
+	{
+		GlyphAtlas& atlas = GetGlyphAtlas(c.font, c.fontSize, c.fontColor);
+		c.texture = atlas.texture;
+		MeasureGlyphs(atlas, c.text, c.rect.w, c.rect.h);
+		c.placement(c.rect, padding);
+		DrawGlyphs(atlas, c.text, c.rect.x, c.rect.y, RENDER_LAYER_UI);
+		return;
+	}
+
+	// Only rasterizes again when the text, font, size or color changed
+	TextCacheEntry& cached = GetCachedText(c.text, c.font, c.fontSize, c.fontColor);
+	c.texture = cached.texture;
+	c.rect.w = cached.w;
+	c.rect.h = cached.h;
 	c.placement(c.rect, padding);
-	DrawTextFont(c.surface, c.rect.x, c.rect.y);
+	DrawTextFont(c.texture, c.rect);
+}
+
+void FreeComponent(Component& c)
+{
+	// The texture belongs to the sprite atlas, only drop the reference
+	c.texture = NULL;
+}
+
+SDL_malloc_func sdlMalloc = NULL;
+SDL_calloc_func sdlCalloc = NULL;
+SDL_realloc_func sdlRealloc = NULL;
+SDL_free_func sdlFree = NULL;
+
+void* SDLCALL CountedMalloc(size_t size)
+{
+	CountAllocation();
+	return sdlMalloc(size);
+}
+
+void* SDLCALL CountedCalloc(size_t count, size_t size)
+{
+	CountAllocation();
+	return sdlCalloc(count, size);
+}
+
+void* SDLCALL CountedRealloc(void* memory, size_t size)
+{
+	CountAllocation();
+	return sdlRealloc(memory, size);
+}
+
+void SDLCALL CountedFree(void* memory)
+{
+	sdlFree(memory);
+}
+
+void HookSDLAllocations()
+{
+	// Memory SDL allocated before goes back to the same allocator, so this
+	// is safe at any time
+	if (sdlMalloc != NULL)
+	{
+		return;
+	}
+	SDL_GetMemoryFunctions(&sdlMalloc, &sdlCalloc, &sdlRealloc, &sdlFree);
+	SDL_SetMemoryFunctions(CountedMalloc, CountedCalloc, CountedRealloc, CountedFree);
 }
 
-void FreeComponent(Component c)
+SDL_Rect ToSDLRect(const SimRect& rect)
 {
-	SDL_FreeSurface(c.imageSurface);
-	c.imageSurface = NULL;
+	return { rect.x, rect.y, rect.w, rect.h };
 }
 
-void MoveComponent(Component& c)
+SDL_Rect InterpolateRect(const SimBody& previous, const SimBody& current, float alpha)
 {
-	c.rect.x += c.velocity * c.xDirection;
-	c.rect.y += c.velocity * c.yDirection;
+	float x = previous.x + (current.x - previous.x) * alpha;
+	float y = previous.y + (current.y - previous.y) * alpha;
+	return {
+		(int)(x / SUBPIXELS_PER_PIXEL + 0.5f),
+		(int)(y / SUBPIXELS_PER_PIXEL + 0.5f),
+		current.rect.w,
+		current.rect.h
+	};
 }
 bool Init()
 {
+#ifdef _WIN32
 	// Hide console Window
 	ShowWindow(GetConsoleWindow(), SW_HIDE); //SW_RESTORE to bring back
+#endif
+
+	// Before SDL allocates anything worth counting
+	if (allocCheck)
+	{
+		HookSDLAllocations();
+	}
 
 	// Initialize SDL
-	if (SDL_Init(SDL_INIT_VIDEO) < 0)
+	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER) < 0)
 	{
 		printf("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
 		exit(EXIT_FAILURE);
 	}
+	inputClockOffset = ProfileNow() - SDL_GetTicks() * 1000000LL;
+	mainThread = SDL_ThreadID();
 	// Initialize TTF
 	if (TTF_Init() < 0) {
 		printf("TTF could not initialize! TTF_Error: %s\n", TTF_GetError());
@@ -300,6 +820,23 @@ bool Init()
 		exit(EXIT_FAILURE);
 	}
 
+	// Mixes the music tracks on its own thread
+	StartMusic();
+
+	// One file open for every asset
+#ifdef PINGPONG_EMBEDDED_ASSETS
+	UseResourceArchiveMemory(PINGPONG_ASSETS, PINGPONG_ASSETS_SIZE);
+#else
+	UseResourceArchive(ASSET_ARCHIVE_PATH);
+#endif
+
+	// Decode every asset in the background while the first frames show
+	QueueGameResources(true);
+	StartLoadingResources();
+	pongSound = AcquireResource(PONG_SOUND_PATH);
+	selectSound = AcquireResource(SELECT_SOUND_PATH);
+	navigateSound = AcquireResource(NAVIGATE_SOUND_PATH);
+
 	//Create window
 	window = SDL_CreateWindow(
 		WINDOW_TITLE,
@@ -316,20 +853,26 @@ bool Init()
 		exit(EXIT_FAILURE);
 	}
 
-	// Icon
-	SDL_Surface* icon = IMG_Load(ICON_IMAGE_PATH);
-	SDL_SetWindowIcon(window, icon);
-	SDL_FreeSurface(icon);
-	icon = NULL;
+	// Icon, set by UpdateResources once decoded
+	windowIcon = AcquireResource(ICON_IMAGE_PATH);
+
+	// Low latency mode paces the frames itself
+	SDL_DisplayMode mode;
+	if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(window), &mode) == 0 && mode.refresh_rate > 0)
+	{
+		framePeriod = 1000000000LL / mode.refresh_rate;
+	}
 
 	// Create Renderer
-	renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_PRESENTVSYNC | SDL_RENDERER_ACCELERATED);
+	Uint32 rendererFlags = SDL_RENDERER_ACCELERATED | (lowLatencyInput ? 0 : SDL_RENDERER_PRESENTVSYNC);
+	renderer = SDL_CreateRenderer(window, -1, rendererFlags);
 
 	if (renderer == NULL)
 	{
 		printf("Renderer could not be created! SDL_Error: %s\n", SDL_GetError());
 		exit(EXIT_FAILURE);
 	}
+	InitRenderBatch(renderer);
 
 	// Set drawing color to black
 	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
@@ -359,6 +902,9 @@ typedef struct MainMenuState
 
 	Button selectedButton;
 
+	// Every label, redrawn when the selection changes
+	RetainedLayer layer = {};
+
 	// Window Padding
 	int padding;
 
@@ -371,17 +917,10 @@ typedef struct GameplayMenuState
 {
 	// Main conditions
 	bool newMatch; // A new match takes place.
-	bool newRound; // The player or the enemy Scored.
-	bool waitingToBegin; // Waiting for user input to start the round.
 
-	// Score
-	int playerPoints = 0;
-	int enemyPoints = 0;
-
-	// Timer
-	Uint32 timeAccumulated;
-	Uint32 timeParcial;
-	Uint32 currentTime;
+	// Latest state from the sim thread
+	SimState sim;
+	int bounces; // Heard so far
 
 	// Ball and Paddles
 	Component ball;
@@ -393,26 +932,17 @@ typedef struct GameplayMenuState
 	TextComponent scoreLabel;
 	TextComponent timeLabel;
 
-	std::string WAIT_TO_BEGIN_MESSAGE = "Presione ENTER para comenzar";
-	std::string PLAYING_MESSAGE = "Jugando";
-
-	// Window Padding
-	int padding;
+	const char* WAIT_TO_BEGIN_MESSAGE = "Presione ENTER para comenzar";
+	const char* PLAYING_MESSAGE = "Jugando";
 
-	// Frame Borders
-	SDL_Rect TOP;
-	SDL_Rect RIGHT;
-	SDL_Rect BOTTOM;
-	SDL_Rect LEFT;
+	// Labels, redrawn when their text changes
+	RetainedLayer layer = {};
 
-	// Enemy ""AI""
-	int gameTicks;
-	int actionDelay;
-	
-	// Ball Velocity
-	int intialBallVelocity;
+	// Sprites of the last frame drawn, an unchanged frame is not presented
+	SDL_Rect drawnRects[3] = {};
 
-	int movementActivationDistance;
+	// Window Padding
+	int padding;
 
 	// Screen Swap
 	Screen nextScreen;
@@ -445,6 +975,9 @@ typedef struct ResultMenuState
 
 	Button selectedButton;
 
+	// Every label, redrawn when the selection changes
+	RetainedLayer layer = {};
+
 	// Window Padding
 	int padding;
 
@@ -453,59 +986,14 @@ typedef struct ResultMenuState
 
 }ResultMenuState;
 
-bool CheckCollision(const SDL_Rect& a, const SDL_Rect& b)
-{
-	// The sides of the rectangles
-	int leftA, leftB;
-	int rightA, rightB;
-	int topA, topB;
-	int bottomA, bottomB;
-
-	// Calculate the sides of rectA
-	leftA = a.x;
-	rightA = a.x + a.w;
-	topA = a.y;
-	bottomA = a.y + a.h;
-
-	// Calculate the sides of rectB
-	leftB = b.x;
-	rightB = b.x + b.w;
-	topB = b.y;
-	bottomB = b.y + b.h;
-
-	// Check for collision
-	if (bottomA <= topB || topA >= bottomB || rightA <= leftB || leftA >= rightB)
-	{
-		return false;
-	}
-
-	return true;
-}
-
 int getMiddleHeight(SDL_Rect rect)
 {
 	return (rect.y + rect.h) / 2;
 }
 
-void EnemyMovement(GameplayMenuState& state)
-{
-	state.gameTicks = (state.gameTicks + 1) % state.actionDelay;
-	if (state.gameTicks == state.actionDelay - 1)
-	{
-		if (state.ball.rect.x < state.movementActivationDistance)
-		{
-			state.enemy.yDirection = state.ball.yDirection == 1 ? 1 : -1;
-		}
-
-		else {
-			state.enemy.yDirection = 0;
-		}
-	}
-}
-
-std::string RenderPoints(int enemyPoints, int playerPoints)
+void RenderPoints(char* text, int size, int enemyPoints, int playerPoints)
 {
-	return std::to_string(enemyPoints) + " - " + std::to_string(playerPoints);
+	snprintf(text, size, "%d - %d", enemyPoints, playerPoints);
 }
 
 void InitMainMenu(MainMenuState& state)
@@ -557,6 +1045,10 @@ void InitMainMenu(MainMenuState& state)
 		&PlaceMiddleBottom
 	);
 
+	// Opened with the window already up, so the first selection change
+	// doesn't have to
+	GetFont(WORK_SANS_EXTRABOLD, state.highlighedFontSize);
+
 	state.signatureLabel = CreateTextComponent(
 		{ 0,0 },
 		"Pueyo Luciano - Introduccin a la Programacin - UADE 1er Cuatrimestre 2023",
@@ -566,8 +1058,8 @@ void InitMainMenu(MainMenuState& state)
 		&PlaceRightBottom
 	);
 
-	// Load Music
-	LoadAndPlayMusic(MAIN_MENU_MUSIC_PATH, 32);
+	// Music
+	CrossfadeMusic(MAIN_MENU_MUSIC_PATH, 32);
 
 	// Screen Swap
 	state.nextScreen = Screen::SAME_SCREEN;
@@ -577,49 +1069,34 @@ void InitGamePlay(GameplayMenuState& state)
 {
 	// Initial States
 	state.newMatch = false;
-	state.newRound = false;
-	state.waitingToBegin = true;
-	state.playerPoints = 0;
-	state.enemyPoints = 0;
-	state.intialBallVelocity = 5;
-
-	// timer
-	state.timeAccumulated = 0;
-	state.timeParcial = 0;
-	state.currentTime = 0;
-
-	// Enemy AI
-	state.actionDelay = 5;
-	state.gameTicks = 0;
-	state.movementActivationDistance = DIFFICULTY_LEVEL;
+	if (spectateAddress != NULL && SpectatorStartViewing(spectator, spectateAddress))
+	{
+		StartSpectatorThread(spectator);
+	}
+	else if (networkMatch && RollbackOpen(networkSession, SimDefaultConfig(), networkSetup))
+	{
+		StartSimThread(SimDefaultConfig(), NULL, &networkSession);
+	}
+	else
+	{
+		StartSimThread(SimDefaultConfig(), REPLAY_PATH);
+	}
+	state.sim = LatestSimSnapshot().current;
+	state.bounces = 0;
 
 	// window Padding
 	state.padding = 15;
 
-	// Frame Borders
-	state.TOP = { 0,0,WINDOW_WIDTH, state.padding };
-	state.RIGHT = { WINDOW_WIDTH - state.padding, 0,state.padding, WINDOW_HEIGHT };
-	state.BOTTOM = { 0,WINDOW_HEIGHT - state.padding ,WINDOW_WIDTH, WINDOW_HEIGHT };
-	state.LEFT = { 0,0,state.padding, WINDOW_HEIGHT };
+	// Sprites, built on the first match
+	if (spriteAtlas == NULL)
+	{
+		LoadSpriteAtlas();
+	}
 
 	// Create Components
-	state.ball = CreateComponent({ 0, 0 }, BALL_IMAGE_PATH);
-	state.player = CreateComponent({ 0, 0 }, PADDLE_IMAGE_PATH);
-	state.enemy = CreateComponent({ 0, 0 }, PADDLE_IMAGE_PATH);
-
-	// Ball properties
-	state.ball.velocity = state.intialBallVelocity;
-	state.ball.xDirection = DIRECTION_LEFT;
-	state.ball.yDirection = DIRECTION_UP;
-
-	// paddles properties
-	state.player.velocity = 7;
-	state.player.xDirection = DIRECTION_STOP;
-	state.player.yDirection = DIRECTION_STOP;
-
-	state.enemy.velocity = 5;
-	state.enemy.xDirection = DIRECTION_STOP;
-	state.enemy.yDirection = DIRECTION_STOP;
+	state.ball = CreateComponent({ 0, 0 }, BALL_SPRITE);
+	state.player = CreateComponent({ 0, 0 }, PADDLE_SPRITE);
+	state.enemy = CreateComponent({ 0, 0 }, PADDLE_SPRITE);
 
 	// Create Text Components
 	state.helpLabel = CreateTextComponent(
@@ -630,67 +1107,42 @@ void InitGamePlay(GameplayMenuState& state)
 		{ 255,255,255,255 },
 		&PlaceMiddleBottom
 	);
+	// The score and the clock keep changing, they are drawn from glyph atlases
+	char text[TEXT_CAPACITY];
+	RenderPoints(text, sizeof(text), state.sim.enemyPoints, state.sim.playerPoints);
 	state.scoreLabel = CreateTextComponent(
 		{ 0,0 },
-		RenderPoints(state.enemyPoints, state.playerPoints),
+		text,
 		WORK_SANS_EXTRABOLD,
 		50,
 		{ 255,255,255,255 },
-		&PlaceMiddleTop
+		&PlaceMiddleTop,
+		true
 	);
 
+	snprintf(text, sizeof(text), "%d", state.sim.timeLeft);
 	state.timeLabel = CreateTextComponent(
 		{ 0,0 },
-		std::to_string(MATCH_DURATION),
+		text,
 		WORK_SANS_THIN,
 		32,
 		{ 200,200,200,255 },
-		&PlaceMiddleTop
+		&PlaceMiddleTop,
+		true
 	);
 
-	// Place components
-	PlaceMiddle(state.ball.rect);
-	PlaceRightMiddle(state.player.rect, state.padding);
-	PlaceLeftMiddle(state.enemy.rect, state.padding);
+	// Ready before they are needed, so the match itself never rasterizes:
+	// the help text once the round starts and the overlay for F3
+	GetCachedText(state.PLAYING_MESSAGE, WORK_SANS_REGULAR, 15, { 255,255,255,255 });
+	GetGlyphAtlas(WORK_SANS_REGULAR, PROFILER_FONT_SIZE, { 255, 255, 255, 255 });
 
-	// Load Music
-	LoadAndPlayMusic(GAMEPLAY_MUSIC_PATH, 32);
-
-	// Load sounds
-	pongSound = Mix_LoadWAV(PONG_SOUND_PATH);
-	selectSound = Mix_LoadWAV(SELECT_SOUND_PATH);
-	navigateSound = Mix_LoadWAV(NAVIGATE_SOUND_PATH);
+	// Music
+	CrossfadeMusic(GAMEPLAY_MUSIC_PATH, 32);
 
 	// Screen Swap
 	state.nextScreen = Screen::SAME_SCREEN;
 }
 
-void SetNewRoundGamePlay(GameplayMenuState& state)
-{
-	state.helpLabel.text = state.WAIT_TO_BEGIN_MESSAGE;
-	state.newRound = false;
-	state.waitingToBegin = true;
-	// timer
-
-	// Ball properties
-	state.ball.velocity = state.intialBallVelocity;
-	state.ball.xDirection = DIRECTION_RIGHT;
-	state.ball.yDirection = DIRECTION_UP;
-
-	// Paddles properties
-	state.player.yDirection = DIRECTION_STOP;
-	state.enemy.yDirection = DIRECTION_STOP;
-
-	// Enemy AI
-	state.gameTicks = 0;
-
-	state.scoreLabel.text = RenderPoints(state.enemyPoints, state.playerPoints);
-
-	PlaceMiddle(state.ball.rect);
-	PlaceRightMiddle(state.player.rect, state.padding);
-	PlaceLeftMiddle(state.enemy.rect, state.padding);
-}
-
 void InitResultMenu(ResultMenuState& state)
 {
 	// Initial States
@@ -712,9 +1164,10 @@ void InitResultMenu(ResultMenuState& state)
 	state.padding = 15;
 
 	// Render results
-	std::string result = RenderPoints(state.enemyPoints, state.playerPoints);
+	char result[TEXT_CAPACITY];
+	RenderPoints(result, sizeof(result), state.enemyPoints, state.playerPoints);
 
-	std::string resultText;
+	const char* resultText;
 	SDL_Color resultColor;
 
 	if (state.enemyPoints > state.playerPoints)
@@ -769,8 +1222,8 @@ void InitResultMenu(ResultMenuState& state)
 		&PlaceMiddleBottom
 	);
 
-	// Load Music
-	LoadAndPlayMusic(MAIN_MENU_MUSIC_PATH, 32);
+	// Music
+	CrossfadeMusic(MAIN_MENU_MUSIC_PATH, 32);
 
 	// Screen Swap
 	state.nextScreen = Screen::SAME_SCREEN;
@@ -784,10 +1237,15 @@ void ExitMainMenu(MainMenuState& state)
 	FreeTextComponent(state.newGameLabel);
 	FreeTextComponent(state.quitLabel);
 	FreeTextComponent(state.signatureLabel);
+	FreeLayer(state.layer);
 }
 
 void ExitGamePlay(GameplayMenuState& state)
 {
+	StopSimThread();
+	RollbackClose(networkSession);
+	SpectatorStopViewing(spectator);
+
 	// Free Components
 	FreeComponent(state.ball);
 	FreeComponent(state.player);
@@ -797,6 +1255,7 @@ void ExitGamePlay(GameplayMenuState& state)
 	FreeTextComponent(state.helpLabel);
 	FreeTextComponent(state.scoreLabel);
 	FreeTextComponent(state.timeLabel);
+	FreeLayer(state.layer);
 }
 
 void ExitResultMenu(ResultMenuState& state)
@@ -806,6 +1265,7 @@ void ExitResultMenu(ResultMenuState& state)
 	FreeTextComponent(state.resultTextLabel);
 	FreeTextComponent(state.mainMenuLabel);
 	FreeTextComponent(state.quitLabel);
+	FreeLayer(state.layer);
 }
 
 void MainMenuHandleEvent(SDL_Event event, MainMenuState& state) {
@@ -836,43 +1296,99 @@ void MainMenuHandleEvent(SDL_Event event, MainMenuState& state) {
 	}
 }
 
-void GamePlayHandleEvent(SDL_Event event, GameplayMenuState& state) {
-	switch (event.type)
+// SDL timestamps are SDL_GetTicks() milliseconds, the sim thread counts in ProfileNow()
+long long InputTime(Uint32 timestamp)
+{
+	return inputClockOffset + timestamp * 1000000LL;
+}
+
+// Nothing within the dead zone, then up to full speed at the end of the travel
+int StickSpeed(Sint16 value)
+{
+	int magnitude = value < 0 ? -(int)value : value;
+	if (magnitude <= STICK_DEAD_ZONE)
+	{
+		return 0;
+	}
+
+	int speed = (magnitude - STICK_DEAD_ZONE) * SIM_FULL_SPEED / (32767 - STICK_DEAD_ZONE);
+	speed = speed < SIM_FULL_SPEED ? speed : SIM_FULL_SPEED;
+	return value < 0 ? -speed : speed;
+}
+
+// Event watch, called while SDL pumps instead of when the loop polls. data
+// is the current screen, only gameplay takes input this way.
+//
+// SDL calls watches on whichever thread pushes the event, but the sim
+// thread's input queue takes a single producer. Keyboard and controller
+// events are pushed by SDL_PumpEvents, which only the main thread calls
+// (MainLoop and PumpInputUntil), so input always comes from there. Events
+// pushed from any other thread are left to the normal poll.
+int GamePlayInputWatch(void* data, SDL_Event* event)
+{
+	if (*(Screen*)data != Screen::GAMEPLAY || SDL_ThreadID() != mainThread)
+	{
+		return 0;
+	}
+
+	// Queued for the sim thread, which checks them against the round state
+	long long time = InputTime(event->common.timestamp);
+	switch (event->type)
 	{
 	case SDL_KEYDOWN:
-		switch (event.key.keysym.sym) {
+		if (event->key.repeat)
+		{
+			break;
+		}
+		switch (event->key.keysym.sym) {
 		case SDLK_RETURN:
-			if (state.waitingToBegin) {
-				state.waitingToBegin = false;
-				state.helpLabel.text = state.PLAYING_MESSAGE;
-			}
+			SimThreadStart(time);
 			break;
 		case SDLK_UP:
-			if (!state.waitingToBegin) {
-				state.player.yDirection = DIRECTION_UP;
-
-			}
+			SimThreadSetDirection(DIRECTION_UP, time);
 			break;
 		case SDLK_DOWN:
-			if (!state.waitingToBegin) {
-				state.player.yDirection = DIRECTION_DOWN;
-			}
+			SimThreadSetDirection(DIRECTION_DOWN, time);
 			break;
 		}
 		break;
 
 	case SDL_KEYUP:
-		switch (event.key.keysym.sym) {
+		switch (event->key.keysym.sym) {
 		case SDLK_UP:
-			if (!state.waitingToBegin) {
-				state.player.yDirection = DIRECTION_STOP;
+		case SDLK_DOWN:
+			SimThreadSetDirection(DIRECTION_STOP, time);
+			break;
+		}
+		break;
 
-			}
+	case SDL_CONTROLLERAXISMOTION:
+		if (event->caxis.axis == SDL_CONTROLLER_AXIS_LEFTY)
+		{
+			SimThreadSetAxis(StickSpeed(event->caxis.value), time);
+		}
+		break;
+
+	case SDL_CONTROLLERBUTTONDOWN:
+		switch (event->cbutton.button) {
+		case SDL_CONTROLLER_BUTTON_A:
+		case SDL_CONTROLLER_BUTTON_START:
+			SimThreadStart(time);
 			break;
-		case SDLK_DOWN:
-			if (!state.waitingToBegin) {
-				state.player.yDirection = DIRECTION_STOP;
-			}
+		case SDL_CONTROLLER_BUTTON_DPAD_UP:
+			SimThreadSetDirection(DIRECTION_UP, time);
+			break;
+		case SDL_CONTROLLER_BUTTON_DPAD_DOWN:
+			SimThreadSetDirection(DIRECTION_DOWN, time);
+			break;
+		}
+		break;
+
+	case SDL_CONTROLLERBUTTONUP:
+		switch (event->cbutton.button) {
+		case SDL_CONTROLLER_BUTTON_DPAD_UP:
+		case SDL_CONTROLLER_BUTTON_DPAD_DOWN:
+			SimThreadSetDirection(DIRECTION_STOP, time);
 			break;
 		}
 		break;
@@ -880,6 +1396,41 @@ void GamePlayHandleEvent(SDL_Event event, GameplayMenuState& state) {
 	default:
 		break;
 	}
+	return 0;
+}
+
+// Sleeps in SDL until the deadline, waking for every event so it reaches
+// the sim thread through the watch when it happens. A queued event would
+// end every later wait at once, so each one is moved to heldEvents.
+void PumpInputUntil(long long deadline)
+{
+	if (heldEventRead == heldEventCount)
+	{
+		heldEventCount = 0;
+		heldEventRead = 0;
+	}
+
+	// Under a millisecond left is not worth another wait
+	int ms;
+	while ((ms = (int)((deadline - ProfileNow()) / 1000000)) > 0 && heldEventCount < HELD_EVENTS_SIZE)
+	{
+		if (SDL_WaitEventTimeout(NULL, ms))
+		{
+			int taken = SDL_PeepEvents(heldEvents + heldEventCount, HELD_EVENTS_SIZE - heldEventCount, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+			heldEventCount += taken > 0 ? taken : 0;
+		}
+	}
+}
+
+// The events PumpInputUntil held first, they came before anything queued
+bool NextEvent(SDL_Event& event)
+{
+	if (heldEventRead < heldEventCount)
+	{
+		event = heldEvents[heldEventRead++];
+		return true;
+	}
+	return SDL_PollEvent(&event) != 0;
 }
 
 void ResultMenuHandleEvent(SDL_Event event, ResultMenuState& state) {
@@ -957,14 +1508,22 @@ Screen MainMenuLogic(MainMenuState& state)
 		InitMainMenu(state);
 	}
 
-	HighlightSelectedOptionMainMenu(state);
+	// Only the selection changes what the menu looks like
+	if (BeginLayer(state.layer, LayerKey((int)state.selectedButton)))
+	{
+		HighlightSelectedOptionMainMenu(state);
+
+		// Draw text components
+		DrawTextComponent(state.titleLabel, state.padding);
+		DrawTextComponent(state.subTitleLabel, state.padding + state.titleLabel.rect.h);
+		DrawTextComponent(state.newGameLabel, state.padding);
+		DrawTextComponent(state.quitLabel, state.padding + WINDOW_HEIGHT / 3);
+		DrawTextComponent(state.signatureLabel, state.padding);
 
-	// Draw text components
-	DrawTextComponent(state.titleLabel, state.padding);
-	DrawTextComponent(state.subTitleLabel, state.padding + state.titleLabel.rect.h);
-	DrawTextComponent(state.newGameLabel, state.padding);
-	DrawTextComponent(state.quitLabel, state.padding + WINDOW_HEIGHT / 3);
-	DrawTextComponent(state.signatureLabel, state.padding);
+		EndLayer(state.layer);
+		redrawFrame = true;
+	}
+	DrawLayer(state.layer);
 
 	return state.nextScreen;
 }
@@ -974,129 +1533,76 @@ Screen GamePlayLogic(GameplayMenuState& state)
 	if (state.newMatch)
 	{
 		InitGamePlay(state);
-		state.currentTime = SDL_GetTicks();
-	}
-
-	if (state.newRound)
-	{
-		SetNewRoundGamePlay(state);
-		state.timeAccumulated = state.timeParcial;
 	}
 
-	DrawComponent(state.ball);
-	DrawComponent(state.player);
-	DrawComponent(state.enemy);
-	DrawTextComponent(state.helpLabel, state.padding);
-	DrawTextComponent(state.scoreLabel, state.padding);
-	DrawTextComponent(state.timeLabel, state.padding + state.scoreLabel.rect.h);
-
-	// Show Frame Window Colliders
+	// The match runs on the sim thread, take whatever it stepped last
+	const SimSnapshot& snapshot = LatestSimSnapshot();
+	state.sim = snapshot.current;
 
-	/*
-	DrawRectangle(state.TOP, {255,0,0,255}, false);
-	DrawRectangle(state.RIGHT, { 255,0,0,255 }, false);
-	DrawRectangle(state.BOTTOM, { 255,0,0,255 }, false);
-	DrawRectangle(state.LEFT, { 255,0,0,255 }, false);
-	*/
-
-	if (state.waitingToBegin)
+	if (snapshot.bounces != state.bounces)
 	{
-		state.currentTime = SDL_GetTicks();
-		return state.nextScreen;
+		PlaySoundOnce(pongSound);
+		state.bounces = snapshot.bounces;
 	}
 
-	// Timer
-	Uint32 elapsedTicks = SDL_GetTicks() - state.currentTime;
-	state.timeParcial = (int)(elapsedTicks * 0.001f) + state.timeAccumulated;
+	SetText(state.helpLabel, state.sim.waitingToBegin ? state.WAIT_TO_BEGIN_MESSAGE : state.PLAYING_MESSAGE);
+	RenderPoints(state.scoreLabel.text, sizeof(state.scoreLabel.text), state.sim.enemyPoints, state.sim.playerPoints);
+	snprintf(state.timeLabel.text, sizeof(state.timeLabel.text), "%d", state.sim.timeLeft);
 
-	int timeLeft = MATCH_DURATION - state.timeParcial;
-	state.timeLabel.text = std::to_string(timeLeft);
-
-	if (timeLeft <= 0) {
+	if (state.sim.finished)
+	{
 		state.nextScreen = Screen::RESULT_MENU;
-		return state.nextScreen;
 	}
 
-	// Move ball and Paddles
-	MoveComponent(state.ball);
-	MoveComponent(state.player);
-	EnemyMovement(state);
-	MoveComponent(state.enemy);
+	// Draw between the last two steps, by how far into the next tick we are
+	float alpha = (float)(ProfileNow() - snapshot.tickTime) * SIM_TICKS_PER_SECOND / 1e9f;
+	alpha = alpha < 0 ? 0 : alpha > 1 ? 1 : alpha;
+	state.ball.rect = InterpolateRect(snapshot.previous.ball, state.sim.ball, alpha);
+	state.player.rect = InterpolateRect(snapshot.previous.player, state.sim.player, alpha);
+	state.enemy.rect = InterpolateRect(snapshot.previous.enemy, state.sim.enemy, alpha);
 
-	// Check collisions
-	// Ball and Borders
-	if (CheckCollision(state.ball.rect, state.player.rect))
+	// The labels change a few times a second at most
+	unsigned labelsKey = LayerKey(state.helpLabel.text, LayerKey(state.scoreLabel.text, LayerKey(state.timeLabel.text)));
+	if (BeginLayer(state.layer, labelsKey))
 	{
-		state.ball.xDirection = DIRECTION_LEFT;
-		state.ball.rect.x = state.player.rect.x - state.ball.rect.w;
-		state.ball.velocity++;
-		PlaySoundOnce(pongSound);
-	}
+		DrawTextComponent(state.helpLabel, state.padding);
+		DrawTextComponent(state.scoreLabel, state.padding);
+		DrawTextComponent(state.timeLabel, state.padding + state.scoreLabel.rect.h);
 
-	if (CheckCollision(state.ball.rect, state.enemy.rect))
-	{
-		state.ball.xDirection = DIRECTION_RIGHT;
-		state.ball.rect.x = state.enemy.rect.x + state.enemy.rect.w + 1;
-		state.ball.velocity++;
-		PlaySoundOnce(pongSound);
+		EndLayer(state.layer);
+		redrawFrame = true;
 	}
+	DrawLayer(state.layer);
 
-	// Frames
-	if (CheckCollision(state.ball.rect, state.TOP))
-	{
-		state.ball.yDirection = DIRECTION_DOWN;
-		state.ball.rect.y = state.TOP.y + state.TOP.h + 1;
-		PlaySoundOnce(pongSound);
-	}
-
-	if (CheckCollision(state.ball.rect, state.RIGHT))
-	{
-		state.ball.xDirection = DIRECTION_LEFT;
-		state.ball.rect.x = state.RIGHT.x - state.ball.rect.w;
-		state.newRound = true;
-		state.enemyPoints++;
-		PlaySoundOnce(pongSound);
-	}
+	DrawComponent(state.ball);
+	DrawComponent(state.player);
+	DrawComponent(state.enemy);
 
-	if (CheckCollision(state.ball.rect, state.BOTTOM))
+	// The first frame drawn from a tick that applied new input
+	if (latencyTest && snapshot.inputTime != latencyShown)
 	{
-		state.ball.yDirection = DIRECTION_UP;
-		state.ball.rect.y = state.BOTTOM.y - state.ball.rect.h;
-		PlaySoundOnce(pongSound);
+		latencyShown = snapshot.inputTime;
+		latencyPending = snapshot.inputTime;
+		BatchRect({ 0, 0, LATENCY_MARKER_SIZE, LATENCY_MARKER_SIZE }, { 255, 255, 255, 255 }, RENDER_LAYER_OVERLAY);
+		redrawFrame = true;
 	}
 
-	if (CheckCollision(state.ball.rect, state.LEFT))
+	// Still while waiting for ENTER
+	SDL_Rect rects[3] = { state.ball.rect, state.player.rect, state.enemy.rect };
+	if (memcmp(rects, state.drawnRects, sizeof(rects)) != 0)
 	{
-		state.ball.xDirection = DIRECTION_DOWN;
-		state.ball.rect.x = state.LEFT.x + state.LEFT.w + 1;
-		state.newRound = true;
-		state.playerPoints++;
-		PlaySoundOnce(pongSound);
+		memcpy(state.drawnRects, rects, sizeof(rects));
+		redrawFrame = true;
 	}
 
-	// Player Paddle and Borders
-	if (CheckCollision(state.player.rect, state.TOP))
-	{
-		state.player.yDirection = DIRECTION_STOP;
-		state.player.rect.y = state.TOP.h;
-	}
-	if (CheckCollision(state.player.rect, state.BOTTOM))
-	{
-		state.player.yDirection = DIRECTION_STOP;
-		state.player.rect.y = state.BOTTOM.y - state.player.rect.h;
-	}
+	// Show Frame Window Colliders
 
-	// enemy Paddle and Borders
-	if (CheckCollision(state.enemy.rect, state.TOP))
-	{
-		state.enemy.yDirection = DIRECTION_STOP;
-		state.enemy.rect.y = state.TOP.h;
-	}
-	if (CheckCollision(state.enemy.rect, state.BOTTOM))
-	{
-		state.enemy.yDirection = DIRECTION_STOP;
-		state.enemy.rect.y = state.BOTTOM.y - state.enemy.rect.h;
-	}
+	/*
+	DrawRectangle(ToSDLRect(state.sim.TOP), {255,0,0,255}, false);
+	DrawRectangle(ToSDLRect(state.sim.RIGHT), { 255,0,0,255 }, false);
+	DrawRectangle(ToSDLRect(state.sim.BOTTOM), { 255,0,0,255 }, false);
+	DrawRectangle(ToSDLRect(state.sim.LEFT), { 255,0,0,255 }, false);
+	*/
 
 	return state.nextScreen;
 }
@@ -1108,13 +1614,21 @@ Screen ResultMenuLogic(ResultMenuState& state)
 		InitResultMenu(state);
 	}
 
-	HighlightSelectedOptionResultMenu(state);
+	// Only the selection changes what the menu looks like
+	if (BeginLayer(state.layer, LayerKey((int)state.selectedButton)))
+	{
+		HighlightSelectedOptionResultMenu(state);
+
+		// Draw text components
+		DrawTextComponent(state.resultScoreLabel, state.padding);
+		DrawTextComponent(state.resultTextLabel, state.padding + state.resultScoreLabel.rect.h);
+		DrawTextComponent(state.mainMenuLabel, state.padding);
+		DrawTextComponent(state.quitLabel, state.padding + WINDOW_HEIGHT / 3);
 
-	// Draw text components
-	DrawTextComponent(state.resultScoreLabel, state.padding);
-	DrawTextComponent(state.resultTextLabel, state.padding + state.resultScoreLabel.rect.h);
-	DrawTextComponent(state.mainMenuLabel, state.padding);
-	DrawTextComponent(state.quitLabel, state.padding + WINDOW_HEIGHT / 3);
+		EndLayer(state.layer);
+		redrawFrame = true;
+	}
+	DrawLayer(state.layer);
 
 	return state.nextScreen;
 }
@@ -1160,8 +1674,8 @@ bool HandleScreenSwap(Screen& currentScreen, Screen& nextScreen, MainMenuState&
 
 	case Screen::RESULT_MENU:
 		rmState.initialized = false;
-		rmState.playerPoints = gpState.playerPoints;
-		rmState.enemyPoints = gpState.enemyPoints;
+		rmState.playerPoints = gpState.sim.playerPoints;
+		rmState.enemyPoints = gpState.sim.enemyPoints;
 		break;
 
 	default:
@@ -1173,6 +1687,89 @@ bool HandleScreenSwap(Screen& currentScreen, Screen& nextScreen, MainMenuState&
 	return true;
 }
 
+void DrawProfilerOverlay()
+{
+	float history[PROFILE_HISTORY_SIZE];
+	int count = ProfileFrameHistory(history);
+
+	// Frame time graph, 4 pixels per millisecond
+	const int graphHeight = 100;
+	SDL_Rect panel = { 15, WINDOW_HEIGHT - graphHeight - 15, PROFILE_HISTORY_SIZE * 2, graphHeight };
+	BatchRect(panel, { 40, 40, 40, 255 }, RENDER_LAYER_OVERLAY);
+
+	for (int i = 0; i < count; i++)
+	{
+		int height = (int)(history[i] * 4);
+		height = height < graphHeight ? height : graphHeight;
+
+		SDL_Color color;
+		if (history[i] <= 1000.0f / 60)
+		{
+			color = { 0, 200, 0, 255 };
+		}
+		else if (history[i] <= 1000.0f / 30)
+		{
+			color = { 230, 200, 0, 255 };
+		}
+		else
+		{
+			color = { 230, 0, 0, 255 };
+		}
+
+		SDL_Rect bar = { panel.x + i * 2, panel.y + graphHeight - height, 2, height };
+		BatchRect(bar, color, RENDER_LAYER_OVERLAY);
+	}
+
+	// 60 FPS budget
+	int budget = panel.y + graphHeight - (int)(1000.0f / 60 * 4);
+	BatchRect({ panel.x, budget, panel.w, 1 }, { 255, 255, 255, 255 }, RENDER_LAYER_OVERLAY);
+
+	// Twice a second, so the numbers stay readable
+	if (profilerTextAge-- <= 0)
+	{
+		ProfileFrameStats stats = ProfileGetFrameStats();
+		snprintf(profilerText, sizeof(profilerText), "p50 %.2f ms   p99 %.2f ms   worst %.2f ms   %d draws in %d batches",
+			stats.p50, stats.p99, stats.worst, frameBatches.commands, frameBatches.batches);
+		profilerTextAge = 30;
+	}
+
+	// New numbers every time, drawn from the atlas instead of the text cache
+	GlyphAtlas& atlas = GetGlyphAtlas(WORK_SANS_REGULAR, PROFILER_FONT_SIZE, { 255, 255, 255, 255 });
+	int w, h;
+	MeasureGlyphs(atlas, profilerText, w, h);
+	DrawGlyphs(atlas, profilerText, panel.x, panel.y - h - 5, RENDER_LAYER_OVERLAY);
+}
+
+// Presents the batched frame, or drops it when nothing changed
+void SubmitFrame()
+{
+	if (redrawFrame)
+	{
+		ProfileScope scope(PROFILE_PRESENT);
+		FlushRenderBatch();
+
+		// Whatever came in while the frame was drawn, before present blocks
+		SDL_PumpEvents();
+		SDL_RenderPresent(renderer);
+
+		if (latencyPending != 0)
+		{
+			long long presented = ProfileNow();
+			ProfileRecord(PROFILE_INPUT_LATENCY, latencyPending, presented);
+			printf("Input to present: %.2f ms\n", (presented - latencyPending) / 1e6);
+			latencyPending = 0;
+		}
+
+		frameBatches = GetRenderBatchStats();
+		ResetRenderBatchStats();
+	}
+	else
+	{
+		// Same picture as the last frame, nothing for the GPU to do
+		DiscardRenderBatch();
+	}
+}
+
 void MainLoop()
 {
 	SDL_Event e;
@@ -1186,16 +1783,35 @@ void MainLoop()
 	MainMenuState mainMenuState;
 	ResultMenuState resultMenuState;
 
+	// Set when a menu has nothing left to draw, the next frame waits for an event
+	bool idle = false;
+
+	// Since the match started, for the allocation check
+	int gameplayFrames = 0;
+
+	SDL_AddEventWatch(GamePlayInputWatch, &currentScreen);
+
 	while (running)
 	{
-		// Clear the window to white
-		SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
-		SDL_RenderClear(renderer);
+		// Leaves the event in the queue for the loop below. The timeout
+		// catches anything without an event, like assets finishing to load.
+		if (idle)
+		{
+			SDL_WaitEventTimeout(NULL, IDLE_WAKE_MS);
+		}
+
+		long long frameStart = ProfileNow();
+		long long frameAllocations = AllocationCount();
+		UpdateResources();
+
+		// Cleared with the first draws, if anything changes
+		BeginRenderFrame();
 
 		Screen nextScreen;
 
 		// Event Loop
-		while (SDL_PollEvent(&e))
+		long long eventsStart = ProfileNow();
+		while (NextEvent(e))
 		{
 			
 			if (e.type == SDL_QUIT)
@@ -1204,6 +1820,38 @@ void MainLoop()
 				break;
 			}
 
+			if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F3)
+			{
+				profilerOverlay = !profilerOverlay;
+				redrawFrame = true;
+				continue;
+			}
+
+			// Also sent for the ones connected at startup
+			if (e.type == SDL_CONTROLLERDEVICEADDED)
+			{
+				SDL_GameControllerOpen(e.cdevice.which);
+			}
+			if (e.type == SDL_CONTROLLERDEVICEREMOVED)
+			{
+				SDL_GameControllerClose(SDL_GameControllerFromInstanceID(e.cdevice.which));
+			}
+
+			// Exposed, resized, restored
+			if (e.type == SDL_WINDOWEVENT)
+			{
+				redrawFrame = true;
+			}
+
+			// The layer textures lost their contents
+			if (e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET)
+			{
+				InvalidateLayer(mainMenuState.layer);
+				InvalidateLayer(gameplayState.layer);
+				InvalidateLayer(resultMenuState.layer);
+				redrawFrame = true;
+			}
+
 			switch (currentScreen)
 			{
 			case Screen::MAIN_MENU:
@@ -1211,7 +1859,7 @@ void MainLoop()
 				break;
 
 			case Screen::GAMEPLAY:
-				GamePlayHandleEvent(e, gameplayState);
+				// Input already went to the sim thread through GamePlayInputWatch
 				break;
 
 			case Screen::RESULT_MENU:
@@ -1222,29 +1870,121 @@ void MainLoop()
 				break;
 			}
 		}
+		ProfileRecord(PROFILE_EVENTS, eventsStart, ProfileNow());
+
 		switch (currentScreen)
 		{
 		case Screen::MAIN_MENU:
+		{
+			ProfileScope scope(PROFILE_MAIN_MENU);
 			nextScreen = MainMenuLogic(mainMenuState);
 			break;
+		}
 
 		case Screen::GAMEPLAY:
+		{
+			ProfileScope scope(PROFILE_GAMEPLAY);
 			nextScreen = GamePlayLogic(gameplayState);
 			break;
+		}
 
 		case Screen::RESULT_MENU:
+		{
+			ProfileScope scope(PROFILE_RESULT_MENU);
 			nextScreen = ResultMenuLogic(resultMenuState);
 			break;
 		}
+		}
 		
 		running = running && HandleScreenSwap(currentScreen, nextScreen, mainMenuState, gameplayState, resultMenuState);
 
-		SDL_RenderPresent(renderer);
+		if (profilerOverlay)
+		{
+			DrawProfilerOverlay();
+			redrawFrame = true;
+		}
+
+		SubmitFrame();
+
+		// Menus only change on input, gameplay keeps running in real time.
+		// Without vsync blocking in present, it waits out the frame here.
+		bool menu = currentScreen == Screen::MAIN_MENU || currentScreen == Screen::RESULT_MENU;
+		idle = menu && !redrawFrame && !profilerOverlay && ResourcesLoaded() && !musicPending;
+		if (lowLatencyInput && !idle)
+		{
+			PumpInputUntil(frameStart + framePeriod);
+		}
+		else if (!redrawFrame && !idle)
+		{
+			SDL_Delay(IDLE_FRAME_MS);
+		}
+		redrawFrame = false;
+
+		// Menus load and free things on the way, only gameplay has to be steady
+		gameplayFrames = currentScreen == Screen::GAMEPLAY ? gameplayFrames + 1 : 0;
+		long long allocated = AllocationCount() - frameAllocations;
+		if (allocCheck && gameplayFrames > ALLOC_WARMUP_FRAMES && allocated > 0)
+		{
+			printf("Gameplay frame %d allocated %lld times\n", gameplayFrames, allocated);
+			allocatingFrames++;
+		}
+
+		ProfileEndFrame(frameStart, ProfileNow());
 	}
+
+	SDL_DelEventWatch(GamePlayInputWatch, &currentScreen);
+
+	// Keeps the replay of a match that was closed halfway
+	StopSimThread();
+	RollbackClose(networkSession);
+	SpectatorStopViewing(spectator);
+	SpectatorStopPublishing(broadcast);
+
+	FreeLayer(mainMenuState.layer);
+	FreeLayer(gameplayState.layer);
+	FreeLayer(resultMenuState.layer);
+}
+
+// The gameplay screen outside MainLoop, for the benchmark's allocation check
+GameplayMenuState headlessGameplay;
+
+void StartGameplayScreen()
+{
+	headlessGameplay.newMatch = true;
+}
+
+const SimState& GameplayScreenFrame()
+{
+	BeginRenderFrame();
+	GamePlayLogic(headlessGameplay);
+	SubmitFrame();
+	redrawFrame = false;
+	return headlessGameplay.sim;
+}
+
+void StopGameplayScreen()
+{
+	ExitGamePlay(headlessGameplay);
 }
 
 void Quit()
 {
+	// Profiler traces
+	ProfileExportTrace(PROFILE_TRACE_PATH);
+	ProfileExportHistograms(PROFILE_HISTOGRAM_PATH);
+
+	// Misses rasterize and allocate, worth knowing when checking for that
+	if (allocCheck)
+	{
+		printf("Allocation check: %d gameplay frames allocated\n", allocatingFrames);
+		printf("Text cache: %d hits, %d misses\n", textCacheHits, textCacheMisses);
+	}
+
+	// Destroy cached text
+	ClearTextCache();
+	ClearFonts();
+	ClearSpriteAtlas();
+
 	//Destroy window
 	SDL_DestroyWindow(window);
 	window = NULL;
@@ -1255,16 +1995,16 @@ void Quit()
 
 	// Destroy Music 
 	ClearMusic();
+	StopMusic();
 
-	// Destroy Sounds
-	Mix_FreeChunk(pongSound);
-	pongSound = NULL;
-
-	Mix_FreeChunk(selectSound);
-	selectSound = NULL;
+	// Release Sounds
+	ReleaseResource(pongSound);
+	ReleaseResource(selectSound);
+	ReleaseResource(navigateSound);
+	ReleaseResource(windowIcon);
 
-	Mix_FreeChunk(navigateSound);
-	navigateSound = NULL;
+	// Free every decoded asset
+	QuitResources();
 
 	//Quit SDL subsystems
 	TTF_Quit();
@@ -1272,11 +2012,104 @@ void Quit()
 	Mix_Quit();
 	SDL_Quit();
 }
+#ifndef PINGPONG_NO_MAIN
+void PrintUsage()
+{
+	printf("Usage: pingpong [options]\n");
+	printf("  --host [PORT]            network match, this side plays the right paddle (port %d)\n", NET_DEFAULT_PORT);
+	printf("  --join HOST:PORT         network match, this side plays the left paddle\n");
+	printf("  --input-delay TICKS      local input delay, default %d\n", NET_DEFAULT_INPUT_DELAY);
+	printf("  --net-latency MS         artificial one way latency, for testing\n");
+	printf("  --net-jitter MS          artificial extra latency of up to MS\n");
+	printf("  --net-loss PERCENT       artificial packet loss\n");
+	printf("  --broadcast HOST:PORT    publish every match to a pingpong_relay\n");
+	printf("  --spectate HOST:PORT     watch the match a pingpong_relay forwards\n");
+	printf("  --low-latency            no vsync, input is read every millisecond between frames\n");
+	printf("  --latency-test           print input to present times and flash a corner for a photodiode\n");
+	printf("  --alloc-check            report gameplay frames that allocate, exit with a failure if any did\n");
+}
+
+bool ParseArguments(int argc, char* args[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(args[i], "--host") == 0)
+		{
+			networkMatch = true;
+			networkSetup.join = NULL;
+			if (hasValue && args[i + 1][0] != '-')
+			{
+				networkSetup.port = (uint16_t)atoi(args[++i]);
+			}
+		}
+		else if (strcmp(args[i], "--join") == 0 && hasValue)
+		{
+			networkMatch = true;
+			networkSetup.join = args[++i];
+		}
+		else if (strcmp(args[i], "--input-delay") == 0 && hasValue)
+		{
+			networkSetup.inputDelay = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--net-latency") == 0 && hasValue)
+		{
+			networkSetup.shim.latencyMs = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--net-jitter") == 0 && hasValue)
+		{
+			networkSetup.shim.jitterMs = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--net-loss") == 0 && hasValue)
+		{
+			networkSetup.shim.lossPercent = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--broadcast") == 0 && hasValue)
+		{
+			broadcastAddress = args[++i];
+		}
+		else if (strcmp(args[i], "--spectate") == 0 && hasValue)
+		{
+			spectateAddress = args[++i];
+		}
+		else if (strcmp(args[i], "--low-latency") == 0)
+		{
+			lowLatencyInput = true;
+		}
+		else if (strcmp(args[i], "--latency-test") == 0)
+		{
+			latencyTest = true;
+		}
+		else if (strcmp(args[i], "--alloc-check") == 0)
+		{
+			allocCheck = true;
+		}
+		else
+		{
+			PrintUsage();
+			return false;
+		}
+	}
+	return true;
+}
+
 int main(int argc, char* args[])
 {
+	if (!ParseArguments(argc, args))
+	{
+		return EXIT_FAILURE;
+	}
+
 	Init();
+
+	if (broadcastAddress != NULL && SpectatorStartPublishing(broadcast, broadcastAddress))
+	{
+		SimThreadBroadcast(&broadcast);
+	}
+
 	MainLoop();
 	Quit();
 
-	exit(EXIT_SUCCESS);
+	exit(allocatingFrames == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
 }
+#endif
@@ -0,0 +1,62 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const unsigned char* MapFile(const char* path, size_t& size)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return NULL;
+	}
+
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(file, &fileSize);
+	size = (size_t)fileSize.QuadPart;
+
+	HANDLE mapping = size > 0 ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+	CloseHandle(file);
+	if (mapping == NULL)
+	{
+		return NULL;
+	}
+
+	// The view keeps the mapping alive
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	return (const unsigned char*)data;
+#else
+	int file = open(path, O_RDONLY);
+	if (file < 0)
+	{
+		return NULL;
+	}
+
+	struct stat info;
+	void* data = MAP_FAILED;
+	if (fstat(file, &info) == 0 && info.st_size > 0)
+	{
+		size = (size_t)info.st_size;
+		data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+	}
+	close(file);
+	return data == MAP_FAILED ? NULL : (const unsigned char*)data;
+#endif
+}
+
+void UnmapFile(const unsigned char* data, size_t size)
+{
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+#else
+	munmap((void*)data, size);
+#endif
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include <stddef.h>
+
+// Read-only memory mapping of a whole file (mmap / MapViewOfFile).
+// NULL when the file can't be opened or is empty.
+const unsigned char* MapFile(const char* path, size_t& size);
+void UnmapFile(const unsigned char* data, size_t size);
@@ -0,0 +1,183 @@
+#include "MatchFarm.h"
+#include "SimBatch.h"
+#include "WorkStealingPool.h"
+#include <string.h>
+#include <vector>
+
+typedef struct FarmRun
+{
+	const FarmGrid* grid;
+	int configCount;
+	int chunksPerConfig;
+
+	// One row of results per worker, merged at the end so workers never write the same result
+	std::vector<FarmResult> partial;
+} FarmRun;
+
+static int RangeCount(const FarmRange& range)
+{
+	if (range.step <= 0 || range.last < range.first)
+	{
+		return 1;
+	}
+	return (range.last - range.first) / range.step + 1;
+}
+
+static int RangeValue(const FarmRange& range, int index)
+{
+	return range.first + index * (range.step > 0 ? range.step : 0);
+}
+
+// xorshift, seeded per match so results don't depend on scheduling
+static unsigned NextRandom(unsigned& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+FarmGrid FarmDefaultGrid()
+{
+	SimConfig config = SimDefaultConfig();
+
+	FarmGrid grid;
+	grid.ballVelocity = { config.intialBallVelocity, config.intialBallVelocity, 1 };
+	grid.playerVelocity = { config.playerVelocity, config.playerVelocity, 1 };
+	grid.enemyVelocity = { config.enemyVelocity, config.enemyVelocity, 1 };
+	grid.reactionDelay = { config.reactionDelay, config.reactionDelay, 1 };
+	grid.aimError = { NIGHTMARE_AIM, TOO_YOUNG_TO_DIE_AIM, ULTRA_VIOLENCE_AIM - NIGHTMARE_AIM };
+	grid.matchesPerConfig = 256;
+	grid.reactionPercent = 25;
+	grid.seed = 2023;
+	return grid;
+}
+
+int FarmConfigCount(const FarmGrid& grid)
+{
+	return RangeCount(grid.ballVelocity)
+		* RangeCount(grid.playerVelocity)
+		* RangeCount(grid.enemyVelocity)
+		* RangeCount(grid.reactionDelay)
+		* RangeCount(grid.aimError);
+}
+
+SimConfig FarmConfigAt(const FarmGrid& grid, int index)
+{
+	SimConfig config = SimDefaultConfig();
+
+	config.intialBallVelocity = RangeValue(grid.ballVelocity, index % RangeCount(grid.ballVelocity));
+	index /= RangeCount(grid.ballVelocity);
+
+	config.playerVelocity = RangeValue(grid.playerVelocity, index % RangeCount(grid.playerVelocity));
+	index /= RangeCount(grid.playerVelocity);
+
+	config.enemyVelocity = RangeValue(grid.enemyVelocity, index % RangeCount(grid.enemyVelocity));
+	index /= RangeCount(grid.enemyVelocity);
+
+	config.reactionDelay = RangeValue(grid.reactionDelay, index % RangeCount(grid.reactionDelay));
+	index /= RangeCount(grid.reactionDelay);
+
+	config.aimError = RangeValue(grid.aimError, index % RangeCount(grid.aimError));
+
+	return config;
+}
+
+static void RunChunk(void* data, int taskIndex, int workerIndex)
+{
+	FarmRun& run = *(FarmRun*)data;
+	const FarmGrid& grid = *run.grid;
+
+	int configIndex = taskIndex / run.chunksPerConfig;
+	int firstMatch = taskIndex % run.chunksPerConfig * FARM_CHUNK;
+	int count = grid.matchesPerConfig - firstMatch < FARM_CHUNK ? grid.matchesPerConfig - firstMatch : FARM_CHUNK;
+
+	SimBatch batch;
+	SimBatchInit(batch, count, FarmConfigAt(grid, configIndex));
+
+	// The player bot only reacts to the ball on some ticks, otherwise keeps going
+	unsigned random[FARM_CHUNK];
+	int direction[FARM_CHUNK];
+	for (int i = 0; i < count; i++)
+	{
+		random[i] = grid.seed ^ (unsigned)(configIndex * 7919 + (firstMatch + i) * 104729) ^ 0x9E3779B9u;
+		NextRandom(random[i]);
+		direction[i] = DIRECTION_STOP;
+	}
+
+	FarmResult& result = run.partial[(size_t)workerIndex * run.configCount + configIndex];
+
+	int running = count;
+	while (running > 0)
+	{
+		SimBatchAutopilot(batch);
+		for (int i = 0; i < count; i++)
+		{
+			if ((int)(NextRandom(random[i]) % 100) < grid.reactionPercent)
+			{
+				direction[i] = batch.inputDirection[i];
+			}
+			batch.inputDirection[i] = direction[i];
+		}
+
+		SimBatchStep(batch);
+		result.ticks += running;
+
+		running = 0;
+		for (int i = 0; i < count; i++)
+		{
+			result.paddleHits += (batch.events[i] & SIM_EVENT_PADDLE_HIT) != 0;
+			running += batch.finished[i] == 0;
+		}
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		int playerPoints = batch.playerPoints[i];
+		int enemyPoints = batch.enemyPoints[i];
+
+		result.matches++;
+		result.points += playerPoints + enemyPoints;
+		result.playerWins += playerPoints > enemyPoints;
+		result.enemyWins += playerPoints < enemyPoints;
+		result.draws += playerPoints == enemyPoints;
+	}
+
+	SimBatchFree(batch);
+}
+
+void RunFarm(const FarmGrid& grid, FarmResult* results, int workers)
+{
+	if (workers <= 0)
+	{
+		workers = PoolDefaultWorkers();
+	}
+
+	FarmRun run;
+	run.grid = &grid;
+	run.configCount = FarmConfigCount(grid);
+	run.chunksPerConfig = (grid.matchesPerConfig + FARM_CHUNK - 1) / FARM_CHUNK;
+	run.partial.assign((size_t)workers * run.configCount, FarmResult());
+
+	RunParallel(run.configCount * run.chunksPerConfig, RunChunk, &run, workers);
+
+	// Merge every worker's row
+	for (int c = 0; c < run.configCount; c++)
+	{
+		FarmResult& result = results[c];
+		memset(&result, 0, sizeof(result));
+		result.config = FarmConfigAt(grid, c);
+
+		for (int w = 0; w < workers; w++)
+		{
+			const FarmResult& part = run.partial[(size_t)w * run.configCount + c];
+			result.matches += part.matches;
+			result.playerWins += part.playerWins;
+			result.enemyWins += part.enemyWins;
+			result.draws += part.draws;
+			result.points += part.points;
+			result.paddleHits += part.paddleHits;
+			result.ticks += part.ticks;
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "Simulation.h"
+
+// Runs many headless matches for every configuration of a parameter grid,
+// spread over all cores, and aggregates the results per configuration.
+
+// Matches of one configuration stepped together by one task
+const int FARM_CHUNK = 64;
+
+// first..last inclusive
+typedef struct FarmRange
+{
+	int first, last, step;
+} FarmRange;
+
+typedef struct FarmGrid
+{
+	FarmRange ballVelocity;
+	FarmRange playerVelocity;
+	FarmRange enemyVelocity;
+	FarmRange reactionDelay;
+	FarmRange aimError;
+
+	int matchesPerConfig;
+	int reactionPercent; // Chance per tick that the player bot reacts to the ball
+	unsigned seed;
+} FarmGrid;
+
+typedef struct FarmResult
+{
+	SimConfig config;
+
+	int matches;
+	int playerWins;
+	int enemyWins;
+	int draws;
+
+	long long points;
+	long long paddleHits;
+	long long ticks;
+} FarmResult;
+
+FarmGrid FarmDefaultGrid();
+
+int FarmConfigCount(const FarmGrid& grid);
+SimConfig FarmConfigAt(const FarmGrid& grid, int index);
+
+// results needs FarmConfigCount(grid) entries
+void RunFarm(const FarmGrid& grid, FarmResult* results, int workers = 0);
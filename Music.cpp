@@ -0,0 +1,246 @@
+#include "Music.h"
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+// Samples, a power of two. About 90 ms of stereo audio, which is also how
+// late a crossfade starts after PlayMusic.
+const unsigned MUSIC_RING_SIZE = 8192;
+const int MUSIC_MIX_BLOCK = 512;
+
+typedef struct MusicVoice
+{
+	const Mix_Chunk* track;
+	Uint32 position; // In samples
+	float gain;
+	float target;
+	float step; // Per frame
+} MusicVoice;
+
+typedef struct MusicRequest
+{
+	const Mix_Chunk* track;
+	int volume;
+	int fadeMs;
+} MusicRequest;
+
+// Single producer ring, the mixing thread writes and the audio callback reads
+static Sint16 musicRing[MUSIC_RING_SIZE];
+static std::atomic<unsigned> musicRead(0);
+static std::atomic<unsigned> musicWrite(0);
+static std::atomic<int> musicUnderruns(0);
+
+static std::thread musicMixer;
+static std::atomic<bool> musicRunning(false);
+static int musicFrequency = 0;
+static int musicChannels = 0;
+
+// Latest request from the game thread, older ones are dropped
+static std::mutex musicLock;
+static MusicRequest musicRequest;
+static bool musicRequested = false;
+
+// Owned by the mixing thread. The first plays, the second fades out.
+static MusicVoice voices[2];
+
+static void SetFade(MusicVoice& voice, float target, int frames)
+{
+	voice.target = target;
+	voice.step = (target - voice.gain) / frames;
+}
+
+static void ApplyRequest(const MusicRequest& request)
+{
+	MusicVoice& playing = voices[0];
+	MusicVoice& fading = voices[1];
+
+	int frames = request.fadeMs * musicFrequency / 1000;
+	if (frames < 1)
+	{
+		frames = 1;
+	}
+
+	if (request.track != playing.track)
+	{
+		if (request.track != NULL && request.track == fading.track)
+		{
+			// Back to the track fading out, it picks up where it is
+			MusicVoice voice = fading;
+			fading = playing;
+			playing = voice;
+		}
+		else
+		{
+			// A third track cuts the one still fading out
+			fading = playing;
+			playing.track = request.track;
+			playing.position = 0;
+			playing.gain = 0;
+		}
+		SetFade(fading, 0, frames);
+	}
+
+	SetFade(playing, (float)request.volume / MIX_MAX_VOLUME, frames);
+}
+
+static void MixVoice(MusicVoice& voice, float* mix, int frames)
+{
+	if (voice.track == NULL || voice.track->alen < sizeof(Sint16) * musicChannels)
+	{
+		voice.track = NULL;
+		return;
+	}
+
+	const Sint16* samples = (const Sint16*)voice.track->abuf;
+	Uint32 length = voice.track->alen / sizeof(Sint16);
+
+	for (int frame = 0; frame < frames; frame++)
+	{
+		for (int channel = 0; channel < musicChannels; channel++)
+		{
+			*mix++ += samples[voice.position++] * voice.gain;
+		}
+
+		// Loop
+		if (voice.position + musicChannels > length)
+		{
+			voice.position = 0;
+		}
+
+		if (voice.step != 0)
+		{
+			voice.gain += voice.step;
+			if ((voice.step > 0 && voice.gain >= voice.target) || (voice.step < 0 && voice.gain <= voice.target))
+			{
+				voice.gain = voice.target;
+				voice.step = 0;
+			}
+		}
+	}
+
+	// Faded out
+	if (voice.gain == 0 && voice.step == 0)
+	{
+		voice.track = NULL;
+	}
+}
+
+static void MixMusic()
+{
+	float mix[MUSIC_MIX_BLOCK];
+	int frames = MUSIC_MIX_BLOCK / musicChannels;
+	int count = frames * musicChannels;
+
+	while (musicRunning)
+	{
+		{
+			std::lock_guard<std::mutex> guard(musicLock);
+			if (musicRequested)
+			{
+				ApplyRequest(musicRequest);
+				musicRequested = false;
+			}
+		}
+
+		unsigned write = musicWrite.load(std::memory_order_relaxed);
+		unsigned read = musicRead.load(std::memory_order_acquire);
+		if (MUSIC_RING_SIZE - (write - read) < (unsigned)count)
+		{
+			// Full, the callback takes 1024 frames at a time
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			continue;
+		}
+
+		memset(mix, 0, sizeof(mix));
+		MixVoice(voices[0], mix, frames);
+		MixVoice(voices[1], mix, frames);
+
+		for (int i = 0; i < count; i++)
+		{
+			float sample = mix[i];
+			sample = sample > 32767 ? 32767 : sample < -32768 ? -32768 : sample;
+			musicRing[(write + i) & (MUSIC_RING_SIZE - 1)] = (Sint16)sample;
+		}
+		musicWrite.store(write + count, std::memory_order_release);
+	}
+}
+
+// Audio thread, never waits
+static void MusicCallback(void* data, Uint8* stream, int length)
+{
+	Sint16* out = (Sint16*)stream;
+	unsigned samples = (unsigned)length / sizeof(Sint16);
+
+	unsigned read = musicRead.load(std::memory_order_relaxed);
+	unsigned available = musicWrite.load(std::memory_order_acquire) - read;
+	unsigned count = samples < available ? samples : available;
+
+	for (unsigned i = 0; i < count; i++)
+	{
+		out[i] = musicRing[(read + i) & (MUSIC_RING_SIZE - 1)];
+	}
+	musicRead.store(read + count, std::memory_order_release);
+
+	if (count < samples)
+	{
+		memset(out + count, 0, (samples - count) * sizeof(Sint16));
+		musicUnderruns++;
+	}
+}
+
+bool StartMusic()
+{
+	Uint16 format;
+	if (!Mix_QuerySpec(&musicFrequency, &format, &musicChannels))
+	{
+		printf("Music could not start! Mix_Error: %s\n", Mix_GetError());
+		return false;
+	}
+
+	if (format != AUDIO_S16SYS || musicChannels > MUSIC_MIX_BLOCK)
+	{
+		printf("Music needs 16 bit samples, the mixer opened format 0x%x\n", format);
+		return false;
+	}
+
+	memset(voices, 0, sizeof(voices));
+	musicRead = 0;
+	musicWrite = 0;
+	musicRunning = true;
+	musicMixer = std::thread(MixMusic);
+
+	Mix_HookMusic(MusicCallback, NULL);
+	return true;
+}
+
+void PlayMusic(const Mix_Chunk* track, int volume, int fadeMs)
+{
+	std::lock_guard<std::mutex> guard(musicLock);
+	musicRequest.track = track;
+	musicRequest.volume = volume;
+	musicRequest.fadeMs = fadeMs;
+	musicRequested = true;
+}
+
+void StopMusic()
+{
+	// Returns once the callback is not running anymore
+	Mix_HookMusic(NULL, NULL);
+
+	musicRunning = false;
+	if (musicMixer.joinable())
+	{
+		musicMixer.join();
+	}
+
+	memset(voices, 0, sizeof(voices));
+	musicRequested = false;
+}
+
+int MusicUnderruns()
+{
+	return musicUnderruns;
+}
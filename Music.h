@@ -0,0 +1,22 @@
+#pragma once
+#include <SDL_mixer.h>
+
+// Music player. Tracks arrive decoded to the mixer's PCM format, see
+// ResourceType::MUSIC. A background thread mixes them into a ring buffer
+// that the mixer's music hook drains, so changing tracks is a crossfade
+// between two buffers in memory and the game thread only posts a request.
+
+const int MUSIC_FADE_MS = 750;
+
+// After Mix_OpenAudio. Needs 16 bit samples, false otherwise.
+bool StartMusic();
+
+// Crossfades to the track, looping it. The same track only changes volume,
+// NULL fades out. Volume goes from 0 to MIX_MAX_VOLUME.
+void PlayMusic(const Mix_Chunk* track, int volume, int fadeMs = MUSIC_FADE_MS);
+
+// Joins the mixing thread, before the tracks are freed
+void StopMusic();
+
+// Times the audio callback found the ring buffer empty
+int MusicUnderruns();
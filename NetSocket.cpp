@@ -0,0 +1,386 @@
+#include "NetSocket.h"
+#include "Profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+typedef int NetLength;
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef socklen_t NetLength;
+#endif
+
+static sockaddr_in ToSockaddr(const NetAddress& address)
+{
+	sockaddr_in result;
+	memset(&result, 0, sizeof(result));
+	result.sin_family = AF_INET;
+	result.sin_addr.s_addr = address.host;
+	result.sin_port = htons(address.port);
+	return result;
+}
+
+// Counted by Winsock, every socket closed releases it again
+static bool StartNetworking()
+{
+#ifdef _WIN32
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+	{
+		printf("Winsock could not start!\n");
+		return false;
+	}
+#endif
+	return true;
+}
+
+static void CloseSocketHandle(NetHandle handle)
+{
+#ifdef _WIN32
+	closesocket(handle);
+	WSACleanup();
+#else
+	close(handle);
+#endif
+}
+
+static bool ValidHandle(NetHandle handle)
+{
+#ifdef _WIN32
+	return handle != INVALID_SOCKET;
+#else
+	return handle >= 0;
+#endif
+}
+
+static bool SetNonblocking(NetHandle handle)
+{
+#ifdef _WIN32
+	u_long nonblocking = 1;
+	return ioctlsocket(handle, FIONBIO, &nonblocking) == 0;
+#else
+	return fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) | O_NONBLOCK) == 0;
+#endif
+}
+
+// The call failed only because it would have to wait
+static bool WouldBlock()
+{
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+bool NetOpen(NetSocket& socket, uint16_t port)
+{
+	if (!StartNetworking())
+	{
+		return false;
+	}
+
+	NetHandle handle = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (!ValidHandle(handle))
+	{
+		printf("UDP socket could not be created!\n");
+#ifdef _WIN32
+		WSACleanup();
+#endif
+		return false;
+	}
+
+	sockaddr_in local;
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	local.sin_port = htons(port);
+
+	bool ok = bind(handle, (const sockaddr*)&local, sizeof(local)) == 0 && SetNonblocking(handle);
+
+	socket.handle = handle;
+	socket.open = true;
+	socket.delayedCount = 0;
+
+	if (!ok)
+	{
+		printf("UDP port %d could not be opened!\n", port);
+		NetClose(socket);
+		return false;
+	}
+	return true;
+}
+
+void NetClose(NetSocket& socket)
+{
+	if (!socket.open)
+	{
+		return;
+	}
+
+	CloseSocketHandle(socket.handle);
+	socket.open = false;
+	socket.delayedCount = 0;
+}
+
+uint16_t NetLocalPort(const NetSocket& socket)
+{
+	sockaddr_in local;
+	NetLength length = sizeof(local);
+	if (getsockname(socket.handle, (sockaddr*)&local, &length) != 0)
+	{
+		return 0;
+	}
+	return ntohs(local.sin_port);
+}
+
+bool NetResolve(const char* text, NetAddress& address)
+{
+	char host[256];
+	const char* colon = strrchr(text, ':');
+	if (colon == NULL || colon - text >= (int)sizeof(host))
+	{
+		printf("Address %s needs a port, like 127.0.0.1:7777\n", text);
+		return false;
+	}
+	memcpy(host, text, colon - text);
+	host[colon - text] = '\0';
+
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+
+	addrinfo* found = NULL;
+	if (getaddrinfo(host, NULL, &hints, &found) != 0 || found == NULL)
+	{
+		printf("Host %s could not be found\n", host);
+		return false;
+	}
+
+	address.host = ((const sockaddr_in*)found->ai_addr)->sin_addr.s_addr;
+	address.port = (uint16_t)atoi(colon + 1);
+	freeaddrinfo(found);
+	return true;
+}
+
+bool NetSameAddress(const NetAddress& a, const NetAddress& b)
+{
+	return a.host == b.host && a.port == b.port;
+}
+
+static void SendNow(NetSocket& socket, const NetAddress& to, const void* data, int size)
+{
+	sockaddr_in address = ToSockaddr(to);
+
+	// A full send buffer loses the packet, like the network would
+	sendto(socket.handle, (const char*)data, size, 0, (const sockaddr*)&address, sizeof(address));
+}
+
+// xorshift
+static unsigned NextRandom(unsigned& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+void NetSend(NetSocket& socket, const NetAddress& to, const void* data, int size)
+{
+	if (!socket.open || size > MAX_NET_PACKET)
+	{
+		return;
+	}
+
+	const NetShim& shim = socket.shim;
+	if (shim.lossPercent > 0 && (int)(NextRandom(socket.random) % 100) < shim.lossPercent)
+	{
+		return;
+	}
+
+	if (shim.latencyMs <= 0 && shim.jitterMs <= 0)
+	{
+		SendNow(socket, to, data, size);
+		return;
+	}
+
+	if (socket.delayedCount == NET_SHIM_QUEUE)
+	{
+		return;
+	}
+
+	int delayMs = shim.latencyMs;
+	if (shim.jitterMs > 0)
+	{
+		delayMs += (int)(NextRandom(socket.random) % (unsigned)(shim.jitterMs + 1));
+	}
+
+	NetDelayedPacket& packet = socket.delayed[socket.delayedCount++];
+	packet.due = ProfileNow() + delayMs * 1000000LL;
+	packet.to = to;
+	packet.size = size;
+	memcpy(packet.data, data, size);
+}
+
+void NetFlush(NetSocket& socket)
+{
+	if (socket.delayedCount == 0)
+	{
+		return;
+	}
+
+	long long now = ProfileNow();
+	int kept = 0;
+	for (int i = 0; i < socket.delayedCount; i++)
+	{
+		NetDelayedPacket& packet = socket.delayed[i];
+		if (packet.due <= now)
+		{
+			SendNow(socket, packet.to, packet.data, packet.size);
+		}
+		else
+		{
+			if (kept != i)
+			{
+				socket.delayed[kept] = packet;
+			}
+			kept++;
+		}
+	}
+	socket.delayedCount = kept;
+}
+
+int NetReceive(NetSocket& socket, NetAddress& from, void* data, int capacity)
+{
+	if (!socket.open)
+	{
+		return -1;
+	}
+
+	NetFlush(socket);
+
+	sockaddr_in address;
+	NetLength length = sizeof(address);
+	int size = (int)recvfrom(socket.handle, (char*)data, capacity, 0, (sockaddr*)&address, &length);
+	if (size < 0)
+	{
+		// Nothing waiting, or an ICMP error from a peer that isn't there yet
+		return -1;
+	}
+
+	from.host = address.sin_addr.s_addr;
+	from.port = ntohs(address.sin_port);
+	return size;
+}
+
+bool NetStreamConnect(NetStream& stream, const char* address)
+{
+	NetStreamClose(stream);
+
+	NetAddress to;
+	if (!NetResolve(address, to) || !StartNetworking())
+	{
+		return false;
+	}
+
+	NetHandle handle = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (!ValidHandle(handle))
+	{
+		printf("TCP socket could not be created!\n");
+#ifdef _WIN32
+		WSACleanup();
+#endif
+		return false;
+	}
+
+	// Small messages every tick, they shouldn't wait for each other
+	int noDelay = 1;
+	setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+
+	sockaddr_in remote = ToSockaddr(to);
+	if (connect(handle, (const sockaddr*)&remote, sizeof(remote)) != 0 || !SetNonblocking(handle))
+	{
+		printf("Could not connect to %s\n", address);
+		CloseSocketHandle(handle);
+		return false;
+	}
+
+	stream.handle = handle;
+	stream.open = true;
+	return true;
+}
+
+void NetStreamClose(NetStream& stream)
+{
+	if (stream.open)
+	{
+		CloseSocketHandle(stream.handle);
+		stream.open = false;
+	}
+}
+
+int NetStreamSend(NetStream& stream, const void* data, int size)
+{
+	if (!stream.open)
+	{
+		return -1;
+	}
+
+#ifdef MSG_NOSIGNAL
+	int sent = (int)send(stream.handle, (const char*)data, size, MSG_NOSIGNAL);
+#else
+	int sent = (int)send(stream.handle, (const char*)data, size, 0);
+#endif
+	if (sent < 0)
+	{
+		return WouldBlock() ? 0 : -1;
+	}
+	return sent;
+}
+
+int NetStreamReceive(NetStream& stream, void* data, int capacity)
+{
+	if (!stream.open)
+	{
+		return -1;
+	}
+
+	int size = (int)recv(stream.handle, (char*)data, capacity, 0);
+	if (size < 0)
+	{
+		return WouldBlock() ? 0 : -1;
+	}
+
+	// Closed by the other side
+	return size == 0 ? -1 : size;
+}
+
+bool NetStreamWait(const NetStream& stream, int timeoutMs)
+{
+	if (!stream.open)
+	{
+		return false;
+	}
+
+	fd_set readable;
+	FD_ZERO(&readable);
+	FD_SET(stream.handle, &readable);
+
+	timeval timeout;
+	timeout.tv_sec = timeoutMs / 1000;
+	timeout.tv_usec = (timeoutMs % 1000) * 1000;
+	return select((int)stream.handle + 1, &readable, NULL, NULL, &timeout) > 0;
+}
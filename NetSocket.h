@@ -0,0 +1,84 @@
+#pragma once
+#include <stdint.h>
+
+// Nonblocking IPv4 UDP sockets (BSD sockets / Winsock) for network play.
+// Every send goes through NetShim, which can delay, reorder and drop packets
+// to try the game on localhost as if it was played across the internet.
+// NetStream is a nonblocking TCP connection, for the spectator streams.
+
+const int MAX_NET_PACKET = 512;
+const int NET_SHIM_QUEUE = 256; // Packets held back by the shim, more are dropped
+
+#ifdef _WIN32
+typedef uintptr_t NetHandle;
+#else
+typedef int NetHandle;
+#endif
+
+typedef struct NetAddress
+{
+	uint32_t host; // Network byte order
+	uint16_t port;
+} NetAddress;
+
+// Artificial conditions, all zero sends straight away
+typedef struct NetShim
+{
+	int latencyMs; // One way
+	int jitterMs; // Up to this much more, so packets arrive out of order
+	int lossPercent;
+} NetShim;
+
+typedef struct NetDelayedPacket
+{
+	long long due; // ProfileNow()
+	NetAddress to;
+	int size;
+	unsigned char data[MAX_NET_PACKET];
+} NetDelayedPacket;
+
+typedef struct NetSocket
+{
+	NetHandle handle;
+	bool open = false;
+
+	NetShim shim = {};
+	unsigned random = 0x9E3779B9u;
+	NetDelayedPacket delayed[NET_SHIM_QUEUE];
+	int delayedCount = 0;
+} NetSocket;
+
+// port 0 picks any free port
+bool NetOpen(NetSocket& socket, uint16_t port);
+void NetClose(NetSocket& socket);
+uint16_t NetLocalPort(const NetSocket& socket);
+
+// "host:port", the host a name or a dotted address
+bool NetResolve(const char* text, NetAddress& address);
+bool NetSameAddress(const NetAddress& a, const NetAddress& b);
+
+void NetSend(NetSocket& socket, const NetAddress& to, const void* data, int size);
+
+// Sends the packets the shim held back that are due by now
+void NetFlush(NetSocket& socket);
+
+// Size of the packet read, -1 when there is none waiting
+int NetReceive(NetSocket& socket, NetAddress& from, void* data, int capacity);
+
+typedef struct NetStream
+{
+	NetHandle handle;
+	bool open = false;
+} NetStream;
+
+// Connects, waiting for it, then turns nonblocking with Nagle off
+bool NetStreamConnect(NetStream& stream, const char* address);
+void NetStreamClose(NetStream& stream);
+
+// Bytes written or read, 0 when the socket can't take or has nothing more
+// right now, -1 once the connection is gone
+int NetStreamSend(NetStream& stream, const void* data, int size);
+int NetStreamReceive(NetStream& stream, void* data, int capacity);
+
+// Until there is something to read or timeoutMs pass
+bool NetStreamWait(const NetStream& stream, int timeoutMs);
@@ -0,0 +1,279 @@
+#include "Rollback.h"
+#include "Profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// Plays a network match between two bots on localhost, each on its own
+// thread and socket, through the latency and loss shim. Fails when the peers
+// desync or end up with different matches, or when rolling back
+// ROLLBACK_MAX_PREDICTION ticks takes longer than ROLLBACK_BUDGET_NS.
+
+const long long ROLLBACK_BUDGET_NS = 1000000;
+const int SETTLE_TIMEOUT_MS = 5000;
+
+typedef struct Peer
+{
+	RollbackSession session;
+	const char* name;
+	unsigned random;
+	bool settled;
+} Peer;
+
+static int matchTicks = 600;
+static int tickRate = SIM_TICKS_PER_SECOND;
+static std::atomic<int> settledPeers(0);
+
+// Keeps the timed work from being optimized away
+volatile unsigned rollbackSink;
+
+void PrintUsage()
+{
+	printf("Usage: pingpong_netplay [options]\n");
+	printf("  --ticks N            ticks to play, default 600\n");
+	printf("  --rate N             ticks per second, default %d\n", SIM_TICKS_PER_SECOND);
+	printf("  --latency MS         one way latency, default 50\n");
+	printf("  --jitter MS          extra latency of up to MS, default 20\n");
+	printf("  --loss PERCENT       packet loss, default 5\n");
+	printf("  --input-delay TICKS  default %d\n", NET_DEFAULT_INPUT_DELAY);
+	printf("  --seed N             bot randomness\n");
+}
+
+// xorshift
+unsigned NextRandom(unsigned& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+// Follows the ball with the paddle of this side, reacting on some ticks only
+// so the peer keeps predicting wrong
+void BotInput(Peer& peer, int& direction, bool& start)
+{
+	const SimState& state = peer.session.state;
+	const SimBody& paddle = peer.session.host ? state.player : state.enemy;
+
+	int paddleCenter = paddle.rect.y + paddle.rect.h / 2;
+	int ballCenter = state.ball.rect.y + state.ball.rect.h / 2;
+
+	if (NextRandom(peer.random) % 100 < 20)
+	{
+		direction = ballCenter < paddleCenter - paddle.velocity ? DIRECTION_UP
+			: ballCenter > paddleCenter + paddle.velocity ? DIRECTION_DOWN
+			: DIRECTION_STOP;
+	}
+
+	start = state.waitingToBegin && NextRandom(peer.random) % 30 == 0;
+}
+
+void RunPeer(Peer* peer)
+{
+	RollbackSession& session = peer->session;
+	const long long tickNs = 1000000000LL / tickRate;
+
+	int direction = DIRECTION_STOP;
+	long long next = ProfileNow();
+	while (session.tick < matchTicks)
+	{
+		long long now = ProfileNow();
+		if (now < next)
+		{
+			std::this_thread::sleep_for(std::chrono::nanoseconds(next - now));
+			continue;
+		}
+		next += tickNs;
+
+		bool start;
+		BotInput(*peer, direction, start);
+		RollbackAdvance(session, direction, start);
+	}
+
+	// Until both sides have every input, the peer may still need ours
+	long long timeout = ProfileNow() + SETTLE_TIMEOUT_MS * 1000000LL;
+	while (settledPeers < 2 && ProfileNow() < timeout)
+	{
+		RollbackPoll(session);
+		if (!peer->settled && RollbackConfirmedTick(session) == matchTicks - 1)
+		{
+			peer->settled = true;
+			settledPeers++;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	// One last packet with the final hash
+	session.lastSend = 0;
+	RollbackPoll(session);
+}
+
+void PrintStats(const Peer& peer)
+{
+	const RollbackStats& stats = peer.session.stats;
+	printf("%s: %d rollbacks, %.1f ticks on average, deepest %d, %.2f us on average, slowest %.2f us, %d stalled ticks, %d hashes checked\n",
+		peer.name,
+		stats.rollbacks,
+		stats.rollbacks > 0 ? (double)stats.rolledBackTicks / stats.rollbacks : 0.0,
+		stats.maxTicks,
+		stats.rollbacks > 0 ? stats.totalNs / 1000.0 / stats.rollbacks : 0.0,
+		stats.maxNs / 1000.0,
+		stats.stalls,
+		stats.hashesChecked);
+}
+
+// Restoring a saved state and simulating the deepest rollback again, without
+// the network in the way
+double TimeRollback()
+{
+	SimConfig config = SimDefaultConfig();
+	config.enemyHuman = true;
+
+	SimState saved, state;
+	SimInit(saved, config);
+	SimInput input = { DIRECTION_UP, SIM_FULL_SPEED, true, DIRECTION_DOWN };
+	SimStep(saved, input);
+
+	const int repetitions = 10000;
+	long long start = ProfileNow();
+	for (int i = 0; i < repetitions; i++)
+	{
+		state = saved;
+		for (int tick = 0; tick < ROLLBACK_MAX_PREDICTION; tick++)
+		{
+			input.playerDirection = (i + tick) % 3 - 1;
+			SimStep(state, input);
+		}
+	}
+	long long end = ProfileNow();
+
+	rollbackSink = SimHash(state);
+	return (double)(end - start) / repetitions;
+}
+
+int main(int argc, char* args[])
+{
+	NetSetup setup;
+	setup.port = 0;
+	setup.shim.latencyMs = 50;
+	setup.shim.jitterMs = 20;
+	setup.shim.lossPercent = 5;
+	unsigned seed = 2023;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(args[i], "--ticks") == 0 && hasValue)
+		{
+			matchTicks = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--rate") == 0 && hasValue)
+		{
+			tickRate = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--latency") == 0 && hasValue)
+		{
+			setup.shim.latencyMs = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--jitter") == 0 && hasValue)
+		{
+			setup.shim.jitterMs = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--loss") == 0 && hasValue)
+		{
+			setup.shim.lossPercent = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--input-delay") == 0 && hasValue)
+		{
+			setup.inputDelay = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--seed") == 0 && hasValue)
+		{
+			seed = (unsigned)strtoul(args[++i], NULL, 10);
+		}
+		else
+		{
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (matchTicks < 1 || tickRate < 1)
+	{
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	static Peer host, guest;
+	host.name = "host";
+	guest.name = "guest";
+	host.random = seed | 1;
+	guest.random = (seed * 2654435761u) | 1;
+
+	if (!RollbackOpen(host.session, SimDefaultConfig(), setup))
+	{
+		return EXIT_FAILURE;
+	}
+
+	char address[32];
+	snprintf(address, sizeof(address), "127.0.0.1:%d", NetLocalPort(host.session.socket));
+	setup.join = address;
+	if (!RollbackOpen(guest.session, SimDefaultConfig(), setup))
+	{
+		return EXIT_FAILURE;
+	}
+
+	printf("Playing %d ticks at %d per second, %d ms latency, %d ms jitter, %d%% loss, %d ticks of input delay\n",
+		matchTicks, tickRate, setup.shim.latencyMs, setup.shim.jitterMs, setup.shim.lossPercent, host.session.inputDelay);
+
+	std::thread hostThread(RunPeer, &host);
+	std::thread guestThread(RunPeer, &guest);
+	hostThread.join();
+	guestThread.join();
+
+	PrintStats(host);
+	PrintStats(guest);
+
+	bool ok = true;
+	if (!host.settled || !guest.settled)
+	{
+		printf("The peers never got every input, the match did not finish\n");
+		ok = false;
+	}
+
+	const Peer* peers[] = { &host, &guest };
+	for (const Peer* peer : peers)
+	{
+		if (peer->session.stats.desyncTick >= 0)
+		{
+			printf("%s desynced at tick %d\n", peer->name, peer->session.stats.desyncTick);
+			ok = false;
+		}
+	}
+
+	unsigned hostHash = SimHash(host.session.state);
+	unsigned guestHash = SimHash(guest.session.state);
+	printf("Final state %08x / %08x, score %d - %d\n", hostHash, guestHash, host.session.state.enemyPoints, host.session.state.playerPoints);
+	if (hostHash != guestHash)
+	{
+		printf("The peers ended with different matches\n");
+		ok = false;
+	}
+
+	double rollbackNs = TimeRollback();
+	printf("Rolling back %d ticks takes %.2f us\n", ROLLBACK_MAX_PREDICTION, rollbackNs / 1000.0);
+	if (rollbackNs > ROLLBACK_BUDGET_NS)
+	{
+		printf("Over the %.0f us budget\n", ROLLBACK_BUDGET_NS / 1000.0);
+		ok = false;
+	}
+
+	RollbackClose(host.session);
+	RollbackClose(guest.session);
+
+	printf(ok ? "OK\n" : "FAILED\n");
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
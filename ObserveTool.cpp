@@ -0,0 +1,133 @@
+#include "Rasterizer.h"
+#include "Profiler.h"
+#include "WorkStealingPool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// Steps bot matches and draws their observation frames, timing full redraws
+// against the ring's incremental ones and checking that both draw the same.
+
+const int CHECKED_MATCHES = 16; // Redrawn from scratch every step and compared
+
+void PrintUsage()
+{
+	printf("Usage: pingpong_observe [options]\n");
+	printf("  --matches N      default 2048\n");
+	printf("  --steps N        default 600\n");
+	printf("  --workers N      default: every core\n");
+	printf("  --dump FILE.pgm  the last stack of the first match, oldest frame on the left\n");
+}
+
+bool WritePgm(const char* path, const ObsBatch& obs)
+{
+	FILE* file = fopen(path, "wb");
+	if (file == NULL)
+	{
+		printf("%s could not be written\n", path);
+		return false;
+	}
+
+	unsigned char stack[OBS_STACK * OBS_PIXELS];
+	ObsCopyStack(obs, 0, stack);
+
+	fprintf(file, "P5\n%d %d\n255\n", OBS_WIDTH * OBS_STACK, OBS_HEIGHT);
+	for (int y = 0; y < OBS_HEIGHT; y++)
+	{
+		for (int frame = 0; frame < OBS_STACK; frame++)
+		{
+			fwrite(stack + frame * OBS_PIXELS + y * OBS_WIDTH, 1, OBS_WIDTH, file);
+		}
+	}
+	fclose(file);
+	return true;
+}
+
+int main(int argc, char* args[])
+{
+	int matches = 2048;
+	int steps = 600;
+	int workers = PoolDefaultWorkers();
+	const char* dumpPath = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(args[i], "--matches") == 0 && hasValue) matches = atoi(args[++i]);
+		else if (strcmp(args[i], "--steps") == 0 && hasValue) steps = atoi(args[++i]);
+		else if (strcmp(args[i], "--workers") == 0 && hasValue) workers = atoi(args[++i]);
+		else if (strcmp(args[i], "--dump") == 0 && hasValue) dumpPath = args[++i];
+		else
+		{
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (matches < 1 || steps < 1 || workers < 1)
+	{
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	SimBatch batch;
+	SimBatchInit(batch, matches, SimDefaultConfig());
+	ObsBatch obs;
+	ObsBatchInit(obs, matches);
+	ObsBatchResetAll(obs, batch, workers);
+
+	// Drawn from scratch and copied to every slot each step, what a stack
+	// that shifts its frames would cost
+	ObsBatch full;
+	ObsBatchInit(full, matches);
+
+	long long fullNs = 0;
+	long long pushNs = 0;
+	int mismatches = 0;
+	std::vector<unsigned char> expected(OBS_PIXELS);
+
+	for (int step = 0; step < steps; step++)
+	{
+		SimBatchAutopilot(batch);
+		SimBatchStep(batch);
+
+		long long start = ProfileNow();
+		ObsBatchResetAll(full, batch, workers);
+		fullNs += ProfileNow() - start;
+
+		start = ProfileNow();
+		ObsBatchPush(obs, batch, workers);
+		pushNs += ProfileNow() - start;
+
+		for (int i = 0; i < CHECKED_MATCHES && i < matches; i++)
+		{
+			SimState state;
+			SimBatchGetState(batch, i, state);
+			RasterizeFrame(state, expected.data());
+			if (memcmp(expected.data(), ObsFrame(obs, i, 0), OBS_PIXELS) != 0
+				|| memcmp(expected.data(), ObsFrame(full, i, 0), OBS_PIXELS) != 0)
+			{
+				mismatches++;
+			}
+		}
+	}
+
+	double frames = (double)matches * steps;
+	printf("%d matches, %d steps, %d workers, %dx%d frames stacked by %d\n", matches, steps, workers, OBS_WIDTH, OBS_HEIGHT, OBS_STACK);
+	printf("full redraw: %.0f frames/s (%.1f ns per frame, stack copied)\n", frames / (fullNs / 1e9), fullNs / frames);
+	printf("ring push:   %.0f frames/s (%.1f ns per frame)\n", frames / (pushNs / 1e9), pushNs / frames);
+	printf("%d mismatched frames\n", mismatches);
+
+	if (dumpPath != NULL && !WritePgm(dumpPath, obs))
+	{
+		return EXIT_FAILURE;
+	}
+
+	ObsBatchFree(full);
+	ObsBatchFree(obs);
+	SimBatchFree(batch);
+
+	printf(mismatches == 0 ? "OK\n" : "FAILED\n");
+	return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
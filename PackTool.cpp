@@ -0,0 +1,161 @@
+#include <SDL.h>
+#include <SDL_image.h>
+#include <SDL_mixer.h>
+#include "AssetArchive.h"
+#include <stdio.h>
+#include <string.h>
+
+// The game opens its mixer with this format, decoded sounds must match it
+const int AUDIO_FREQUENCY = 44100;
+const int AUDIO_CHANNELS = 2;
+
+void PrintUsage()
+{
+	printf("Usage: pingpong_pack [--decode] [--source FILE.cpp] OUT.pak [--image|--sound|--file] FILES...\n");
+	printf("  --decode   store images as RGBA32 pixels and sounds as mixer PCM, before OUT.pak\n");
+	printf("  --source   also write the archive as a C++ array to link into the game\n");
+	printf("  --image, --sound, --file   how the FILES after it are stored, --file by default;\n");
+	printf("             --image and --sound need --decode\n");
+}
+
+bool AddImage(ArchiveWriter& writer, const char* path)
+{
+	SDL_Surface* image = IMG_Load(path);
+	if (image == NULL)
+	{
+		printf("Image %s could not be loaded! IMG_Error: %s\n", path, IMG_GetError());
+		return false;
+	}
+
+	// The format the sprite atlas uses, so building it is a plain copy
+	SDL_Surface* pixels = SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_RGBA32, 0);
+	SDL_FreeSurface(image);
+	if (pixels == NULL)
+	{
+		printf("Image %s could not be converted! SDL_Error: %s\n", path, SDL_GetError());
+		return false;
+	}
+
+	ArchiveEntry& entry = ArchiveAdd(writer, path, ARCHIVE_PIXELS, pixels->pixels, (size_t)pixels->pitch * pixels->h);
+	entry.width = pixels->w;
+	entry.height = pixels->h;
+	entry.pitch = pixels->pitch;
+	entry.format = SDL_PIXELFORMAT_RGBA32;
+
+	SDL_FreeSurface(pixels);
+	return true;
+}
+
+bool AddSound(ArchiveWriter& writer, const char* path)
+{
+	Mix_Chunk* chunk = Mix_LoadWAV(path);
+	if (chunk == NULL)
+	{
+		printf("Sound %s could not be loaded! Mix_Error: %s\n", path, Mix_GetError());
+		return false;
+	}
+
+	int frequency, channels;
+	Uint16 format;
+	Mix_QuerySpec(&frequency, &format, &channels);
+
+	ArchiveEntry& entry = ArchiveAdd(writer, path, ARCHIVE_PCM, chunk->abuf, chunk->alen);
+	entry.width = frequency;
+	entry.height = channels;
+	entry.format = format;
+
+	Mix_FreeChunk(chunk);
+	return true;
+}
+
+int main(int argc, char* args[])
+{
+	bool decode = false;
+	const char* sourcePath = NULL;
+	const char* archivePath = NULL;
+	ArchiveKind kind = ARCHIVE_FILE;
+
+	ArchiveWriter writer;
+	bool ok = true;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(args[i], "--decode") == 0)
+		{
+			// Files already added would stay raw
+			if (archivePath != NULL)
+			{
+				PrintUsage();
+				return 1;
+			}
+			decode = true;
+
+			// No device needed to decode, only the format
+			SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+			if (SDL_Init(SDL_INIT_AUDIO) < 0 || Mix_OpenAudio(AUDIO_FREQUENCY, MIX_DEFAULT_FORMAT, AUDIO_CHANNELS, 1024) < 0)
+			{
+				printf("Audio could not be opened for decoding! Mix_Error: %s\n", Mix_GetError());
+				return 1;
+			}
+		}
+		else if (strcmp(args[i], "--source") == 0 && i + 1 < argc)
+		{
+			sourcePath = args[++i];
+		}
+		else if (strcmp(args[i], "--image") == 0 || strcmp(args[i], "--sound") == 0)
+		{
+			// Only decoding stores them differently from --file
+			if (!decode)
+			{
+				PrintUsage();
+				return 1;
+			}
+			kind = strcmp(args[i], "--image") == 0 ? ARCHIVE_PIXELS : ARCHIVE_PCM;
+		}
+		else if (strcmp(args[i], "--file") == 0)
+		{
+			kind = ARCHIVE_FILE;
+		}
+		else if (archivePath == NULL)
+		{
+			archivePath = args[i];
+		}
+		else if (kind == ARCHIVE_PIXELS)
+		{
+			ok = AddImage(writer, args[i]) && ok;
+		}
+		else if (kind == ARCHIVE_PCM)
+		{
+			ok = AddSound(writer, args[i]) && ok;
+		}
+		else
+		{
+			ok = ArchiveAddFile(writer, args[i]) && ok;
+		}
+	}
+
+	if (archivePath == NULL || writer.entries.empty())
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if (!ok || !ArchiveWrite(writer, archivePath) || (sourcePath != NULL && !ArchiveWriteSource(writer, sourcePath)))
+	{
+		return 1;
+	}
+
+	size_t size = 0;
+	for (size_t i = 0; i < writer.data.size(); i++)
+	{
+		size += writer.data[i].size();
+	}
+	printf("%s: %d assets, %zu bytes\n", archivePath, (int)writer.entries.size(), size);
+
+	if (decode)
+	{
+		Mix_CloseAudio();
+		SDL_Quit();
+	}
+	return 0;
+}
@@ -0,0 +1,250 @@
+#include "Profiler.h"
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+typedef struct ProfileEvent
+{
+	long long start;
+	long long end;
+	int zone;
+	int thread;
+} ProfileEvent;
+
+// Written by any thread, a slot is claimed with one atomic add
+static ProfileEvent profileRing[PROFILE_RING_SIZE];
+static std::atomic<unsigned> profileRingWrite(0);
+
+static std::atomic<long long> profileHistograms[PROFILE_ZONE_COUNT][PROFILE_BUCKETS];
+
+// Only touched by the thread ending frames
+static float frameHistory[PROFILE_HISTORY_SIZE];
+static int frameHistoryCount = 0;
+static int frameHistoryNext = 0;
+
+static std::atomic<int> profileThreadCount(0);
+static thread_local int profileThread = profileThreadCount++;
+
+static const long long profileEpoch = std::chrono::duration_cast<std::chrono::nanoseconds>(
+	std::chrono::steady_clock::now().time_since_epoch()).count();
+
+const char* ProfileZoneName(ProfileZone zone)
+{
+	switch (zone)
+	{
+	case PROFILE_FRAME:
+		return "Frame";
+	case PROFILE_EVENTS:
+		return "Events";
+	case PROFILE_MAIN_MENU:
+		return "MainMenuLogic";
+	case PROFILE_GAMEPLAY:
+		return "GamePlayLogic";
+	case PROFILE_RESULT_MENU:
+		return "ResultMenuLogic";
+	case PROFILE_TEXT_RASTER:
+		return "TextRaster";
+	case PROFILE_TEXTURE_UPLOAD:
+		return "TextureUpload";
+	case PROFILE_PRESENT:
+		return "Present";
+	case PROFILE_SIM_STEP:
+		return "SimStep";
+	case PROFILE_ROLLBACK:
+		return "Rollback";
+	case PROFILE_INPUT_LATENCY:
+		return "InputLatency";
+	default:
+		return "Unknown";
+	}
+}
+
+long long ProfileNow()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count() - profileEpoch;
+}
+
+// Exact below 32us, then 32 steps per power of two
+static int BucketIndex(long long microseconds)
+{
+	if (microseconds < PROFILE_SUB_BUCKETS)
+	{
+		return microseconds < 0 ? 0 : (int)microseconds;
+	}
+
+	int highBit = 5;
+	while (microseconds >> (highBit + 1))
+	{
+		highBit++;
+	}
+	int shift = highBit - 5;
+	int index = PROFILE_SUB_BUCKETS + shift * PROFILE_SUB_BUCKETS + (int)(microseconds >> shift) - PROFILE_SUB_BUCKETS;
+	return index < PROFILE_BUCKETS ? index : PROFILE_BUCKETS - 1;
+}
+
+static long long BucketValue(int index)
+{
+	if (index < PROFILE_SUB_BUCKETS)
+	{
+		return index;
+	}
+
+	int shift = (index - PROFILE_SUB_BUCKETS) / PROFILE_SUB_BUCKETS;
+	int step = (index - PROFILE_SUB_BUCKETS) % PROFILE_SUB_BUCKETS;
+	return (long long)(PROFILE_SUB_BUCKETS + step) << shift;
+}
+
+ProfileScope::ProfileScope(ProfileZone zone) : zone(zone), start(ProfileNow())
+{
+}
+
+ProfileScope::~ProfileScope()
+{
+	ProfileRecord(zone, start, ProfileNow());
+}
+
+void ProfileRecord(ProfileZone zone, long long start, long long end)
+{
+	unsigned slot = profileRingWrite.fetch_add(1, std::memory_order_relaxed) & (PROFILE_RING_SIZE - 1);
+	ProfileEvent& event = profileRing[slot];
+	event.start = start;
+	event.end = end;
+	event.zone = zone;
+	event.thread = profileThread;
+
+	profileHistograms[zone][BucketIndex((end - start) / 1000)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void ProfileEndFrame(long long frameStart, long long frameEnd)
+{
+	ProfileRecord(PROFILE_FRAME, frameStart, frameEnd);
+
+	frameHistory[frameHistoryNext] = (frameEnd - frameStart) / 1000000.0f;
+	frameHistoryNext = (frameHistoryNext + 1) % PROFILE_HISTORY_SIZE;
+	if (frameHistoryCount < PROFILE_HISTORY_SIZE)
+	{
+		frameHistoryCount++;
+	}
+}
+
+int ProfileFrameHistory(float* milliseconds)
+{
+	int first = (frameHistoryNext - frameHistoryCount + PROFILE_HISTORY_SIZE) % PROFILE_HISTORY_SIZE;
+	for (int i = 0; i < frameHistoryCount; i++)
+	{
+		milliseconds[i] = frameHistory[(first + i) % PROFILE_HISTORY_SIZE];
+	}
+	return frameHistoryCount;
+}
+
+ProfileFrameStats ProfileGetFrameStats()
+{
+	ProfileFrameStats stats = {};
+
+	float sorted[PROFILE_HISTORY_SIZE];
+	int count = ProfileFrameHistory(sorted);
+	if (count == 0)
+	{
+		return stats;
+	}
+
+	std::sort(sorted, sorted + count);
+	stats.frames = count;
+	stats.p50 = sorted[count / 2];
+	stats.p99 = sorted[std::min(count - 1, count * 99 / 100)];
+	stats.worst = sorted[count - 1];
+	return stats;
+}
+
+bool ProfileExportTrace(const char* path)
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+	{
+		printf("Profile trace %s could not be created\n", path);
+		return false;
+	}
+
+	// Call after the other threads stopped recording
+	unsigned written = profileRingWrite.load();
+	unsigned first = written > (unsigned)PROFILE_RING_SIZE ? written - PROFILE_RING_SIZE : 0;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	for (unsigned i = first; i < written; i++)
+	{
+		const ProfileEvent& event = profileRing[i & (PROFILE_RING_SIZE - 1)];
+		fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}\n",
+			i == first ? "" : ",",
+			ProfileZoneName((ProfileZone)event.zone),
+			event.start / 1000.0,
+			(event.end - event.start) / 1000.0,
+			event.thread);
+	}
+	fprintf(file, "]}\n");
+
+	bool ok = !ferror(file);
+	fclose(file);
+	return ok;
+}
+
+bool ProfileExportHistograms(const char* path)
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+	{
+		printf("Profile histograms %s could not be created\n", path);
+		return false;
+	}
+
+	for (int zone = 0; zone < PROFILE_ZONE_COUNT; zone++)
+	{
+		long long total = 0;
+		for (int i = 0; i < PROFILE_BUCKETS; i++)
+		{
+			total += profileHistograms[zone][i].load();
+		}
+		if (total == 0)
+		{
+			continue;
+		}
+
+		// Same columns as HdrHistogram's percentile output, values in milliseconds
+		fprintf(file, "# %s\n", ProfileZoneName((ProfileZone)zone));
+		fprintf(file, "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+
+		long long count = 0;
+		double sum = 0;
+		long long max = 0;
+		for (int i = 0; i < PROFILE_BUCKETS; i++)
+		{
+			long long bucket = profileHistograms[zone][i].load();
+			if (bucket == 0)
+			{
+				continue;
+			}
+
+			count += bucket;
+			sum += (double)BucketValue(i) * bucket;
+			max = BucketValue(i);
+
+			double percentile = (double)count / total;
+			if (percentile < 1)
+			{
+				fprintf(file, "%12.3f %14.12f %10lld %14.2f\n", max / 1000.0, percentile, count, 1 / (1 - percentile));
+			}
+			else
+			{
+				fprintf(file, "%12.3f %14.12f %10lld\n", max / 1000.0, percentile, count);
+			}
+		}
+
+		fprintf(file, "#[Mean    = %12.3f, Max     = %12.3f]\n", sum / total / 1000.0, max / 1000.0);
+		fprintf(file, "#[Total count    = %12lld]\n\n", total);
+	}
+
+	bool ok = !ferror(file);
+	fclose(file);
+	return ok;
+}
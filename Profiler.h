@@ -0,0 +1,63 @@
+#pragma once
+
+// Frame profiler. Scoped zones go into a lock-free ring buffer for the trace
+// and into a log-linear histogram per zone. Nothing here depends on SDL so the
+// headless tools can use it too; the overlay is drawn by the game.
+
+enum ProfileZone
+{
+	PROFILE_FRAME,
+	PROFILE_EVENTS,
+	PROFILE_MAIN_MENU,
+	PROFILE_GAMEPLAY,
+	PROFILE_RESULT_MENU,
+	PROFILE_TEXT_RASTER,
+	PROFILE_TEXTURE_UPLOAD,
+	PROFILE_PRESENT,
+	PROFILE_SIM_STEP, // On the sim thread
+	PROFILE_ROLLBACK, // Re-simulating after a late network input
+	PROFILE_INPUT_LATENCY, // From an input to the present of the first frame showing it
+	PROFILE_ZONE_COUNT
+};
+
+// Zones kept for the trace, older ones are overwritten
+const int PROFILE_RING_SIZE = 1 << 16;
+
+// Frames shown by the overlay graph
+const int PROFILE_HISTORY_SIZE = 240;
+
+// Histogram buckets: 32 linear steps per power of two of microseconds
+const int PROFILE_SUB_BUCKETS = 32;
+const int PROFILE_BUCKETS = 26 * PROFILE_SUB_BUCKETS;
+
+typedef struct ProfileFrameStats
+{
+	int frames; // In the history window
+	double p50; // Milliseconds
+	double p99;
+	double worst;
+} ProfileFrameStats;
+
+// Times the enclosing block
+typedef struct ProfileScope
+{
+	ProfileZone zone;
+	long long start;
+
+	ProfileScope(ProfileZone zone);
+	~ProfileScope();
+} ProfileScope;
+
+const char* ProfileZoneName(ProfileZone zone);
+long long ProfileNow(); // Nanoseconds
+
+void ProfileRecord(ProfileZone zone, long long start, long long end);
+void ProfileEndFrame(long long frameStart, long long frameEnd);
+
+// Frame times in milliseconds, oldest first, returns how many
+int ProfileFrameHistory(float* milliseconds);
+ProfileFrameStats ProfileGetFrameStats();
+
+// Chrome / Perfetto trace JSON and HdrHistogram style percentile tables
+bool ProfileExportTrace(const char* path);
+bool ProfileExportHistograms(const char* path);
@@ -0,0 +1,240 @@
+#include "Rasterizer.h"
+#include "WorkStealingPool.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <emmintrin.h>
+#define OBS_SSE2 1
+#else
+#define OBS_SSE2 0
+#endif
+
+// Gray level of each row of an empty arena, the borders run the whole width
+static unsigned char rowBackground[OBS_HEIGHT];
+static bool rowBackgroundReady = false;
+
+static int Clamp(int value, int low, int high)
+{
+	return value < low ? low : value > high ? high : value;
+}
+
+ObsRect ObsMapRect(const SimRect& rect)
+{
+	int left = Clamp(rect.x, 0, ARENA_WIDTH);
+	int top = Clamp(rect.y, 0, ARENA_HEIGHT);
+	int right = Clamp(rect.x + rect.w, 0, ARENA_WIDTH);
+	int bottom = Clamp(rect.y + rect.h, 0, ARENA_HEIGHT);
+
+	// Floor the near side and ceil the far one, so nothing disappears
+	ObsRect mapped;
+	mapped.x0 = (short)Clamp(left * OBS_WIDTH / ARENA_WIDTH, 0, OBS_WIDTH - 1);
+	mapped.y0 = (short)Clamp(top * OBS_HEIGHT / ARENA_HEIGHT, 0, OBS_HEIGHT - 1);
+	mapped.x1 = (short)Clamp((right * OBS_WIDTH + ARENA_WIDTH - 1) / ARENA_WIDTH, mapped.x0 + 1, OBS_WIDTH);
+	mapped.y1 = (short)Clamp((bottom * OBS_HEIGHT + ARENA_HEIGHT - 1) / ARENA_HEIGHT, mapped.y0 + 1, OBS_HEIGHT);
+	return mapped;
+}
+
+static void PrepareBackground()
+{
+	if (rowBackgroundReady)
+	{
+		return;
+	}
+
+	ObsRect top = ObsMapRect({ 0, 0, ARENA_WIDTH, ARENA_PADDING });
+	ObsRect bottom = ObsMapRect({ 0, ARENA_HEIGHT - ARENA_PADDING, ARENA_WIDTH, ARENA_PADDING });
+	for (int y = 0; y < OBS_HEIGHT; y++)
+	{
+		bool border = (y >= top.y0 && y < top.y1) || (y >= bottom.y0 && y < bottom.y1);
+		rowBackground[y] = border ? OBS_BORDER : OBS_BACKGROUND;
+	}
+	rowBackgroundReady = true;
+}
+
+// Same byte everywhere, 16 at a time
+static void FillBytes(unsigned char* out, int size, unsigned char value)
+{
+	int i = 0;
+#if OBS_SSE2
+	__m128i fill = _mm_set1_epi8((char)value);
+	for (; i + 64 <= size; i += 64)
+	{
+		_mm_storeu_si128((__m128i*)(out + i), fill);
+		_mm_storeu_si128((__m128i*)(out + i + 16), fill);
+		_mm_storeu_si128((__m128i*)(out + i + 32), fill);
+		_mm_storeu_si128((__m128i*)(out + i + 48), fill);
+	}
+	for (; i + 16 <= size; i += 16)
+	{
+		_mm_storeu_si128((__m128i*)(out + i), fill);
+	}
+#endif
+	for (; i < size; i++)
+	{
+		out[i] = value;
+	}
+}
+
+static void FillRect(unsigned char* frame, const ObsRect& rect, unsigned char value)
+{
+	for (int y = rect.y0; y < rect.y1; y++)
+	{
+		FillBytes(frame + y * OBS_WIDTH + rect.x0, rect.x1 - rect.x0, value);
+	}
+}
+
+static void EraseRect(unsigned char* frame, const ObsRect& rect)
+{
+	for (int y = rect.y0; y < rect.y1; y++)
+	{
+		FillBytes(frame + y * OBS_WIDTH + rect.x0, rect.x1 - rect.x0, rowBackground[y]);
+	}
+}
+
+// Rows of the same gray are contiguous, so the arena is a few long fills
+static void DrawArena(unsigned char* frame)
+{
+	int start = 0;
+	for (int y = 1; y <= OBS_HEIGHT; y++)
+	{
+		if (y == OBS_HEIGHT || rowBackground[y] != rowBackground[start])
+		{
+			FillBytes(frame + start * OBS_WIDTH, (y - start) * OBS_WIDTH, rowBackground[start]);
+			start = y;
+		}
+	}
+}
+
+static void BodyRects(const SimBatch& batch, int index, ObsRect* rects)
+{
+	rects[0] = ObsMapRect({ batch.ballX[index] >> SUBPIXEL_SHIFT, batch.ballY[index] >> SUBPIXEL_SHIFT, BALL_SIZE, BALL_SIZE });
+	rects[1] = ObsMapRect({ ARENA_WIDTH - PADDLE_WIDTH - ARENA_PADDING, batch.playerY[index] >> SUBPIXEL_SHIFT, PADDLE_WIDTH, PADDLE_HEIGHT });
+	rects[2] = ObsMapRect({ ARENA_PADDING, batch.enemyY[index] >> SUBPIXEL_SHIFT, PADDLE_WIDTH, PADDLE_HEIGHT });
+}
+
+void RasterizeFrame(const SimState& state, unsigned char* frame)
+{
+	PrepareBackground();
+	DrawArena(frame);
+	FillRect(frame, ObsMapRect(state.ball.rect), OBS_BODY);
+	FillRect(frame, ObsMapRect(state.player.rect), OBS_BODY);
+	FillRect(frame, ObsMapRect(state.enemy.rect), OBS_BODY);
+}
+
+void ObsBatchInit(ObsBatch& obs, int count)
+{
+	PrepareBackground();
+	obs.count = count;
+	obs.newest = 0;
+	obs.pixels = (unsigned char*)malloc((size_t)count * OBS_STACK * OBS_PIXELS);
+	obs.drawn = (ObsRect*)malloc((size_t)count * OBS_STACK * OBS_BODIES * sizeof(ObsRect));
+}
+
+void ObsBatchFree(ObsBatch& obs)
+{
+	free(obs.pixels);
+	free(obs.drawn);
+	memset(&obs, 0, sizeof(obs));
+}
+
+static unsigned char* Slot(const ObsBatch& obs, int index, int slot)
+{
+	return obs.pixels + ((size_t)index * OBS_STACK + slot) * OBS_PIXELS;
+}
+
+static ObsRect* Drawn(const ObsBatch& obs, int index, int slot)
+{
+	return obs.drawn + ((size_t)index * OBS_STACK + slot) * OBS_BODIES;
+}
+
+void ObsBatchReset(ObsBatch& obs, const SimBatch& batch, int index)
+{
+	ObsRect rects[OBS_BODIES];
+	BodyRects(batch, index, rects);
+
+	unsigned char* first = Slot(obs, index, 0);
+	DrawArena(first);
+	for (int body = 0; body < OBS_BODIES; body++)
+	{
+		FillRect(first, rects[body], OBS_BODY);
+	}
+
+	for (int slot = 0; slot < OBS_STACK; slot++)
+	{
+		if (slot > 0)
+		{
+			memcpy(Slot(obs, index, slot), first, OBS_PIXELS);
+		}
+		memcpy(Drawn(obs, index, slot), rects, sizeof(rects));
+	}
+}
+
+typedef struct ObsJob
+{
+	ObsBatch* obs;
+	const SimBatch* batch;
+} ObsJob;
+
+static void ResetChunk(void* data, int taskIndex, int workerIndex)
+{
+	ObsJob& job = *(ObsJob*)data;
+	int last = Clamp((taskIndex + 1) * OBS_CHUNK, 0, job.obs->count);
+	for (int i = taskIndex * OBS_CHUNK; i < last; i++)
+	{
+		ObsBatchReset(*job.obs, *job.batch, i);
+	}
+}
+
+static void PushChunk(void* data, int taskIndex, int workerIndex)
+{
+	ObsJob& job = *(ObsJob*)data;
+	const ObsBatch& obs = *job.obs;
+	int last = Clamp((taskIndex + 1) * OBS_CHUNK, 0, obs.count);
+
+	for (int i = taskIndex * OBS_CHUNK; i < last; i++)
+	{
+		unsigned char* frame = Slot(obs, i, obs.newest);
+		ObsRect* drawn = Drawn(obs, i, obs.newest);
+
+		// Erase everything first, the old rects may overlap the new ones
+		for (int body = 0; body < OBS_BODIES; body++)
+		{
+			EraseRect(frame, drawn[body]);
+		}
+
+		BodyRects(*job.batch, i, drawn);
+		for (int body = 0; body < OBS_BODIES; body++)
+		{
+			FillRect(frame, drawn[body], OBS_BODY);
+		}
+	}
+}
+
+void ObsBatchResetAll(ObsBatch& obs, const SimBatch& batch, int workers)
+{
+	ObsJob job = { &obs, &batch };
+	RunParallel((obs.count + OBS_CHUNK - 1) / OBS_CHUNK, ResetChunk, &job, workers);
+}
+
+void ObsBatchPush(ObsBatch& obs, const SimBatch& batch, int workers)
+{
+	obs.newest = (obs.newest + 1) % OBS_STACK;
+
+	ObsJob job = { &obs, &batch };
+	RunParallel((obs.count + OBS_CHUNK - 1) / OBS_CHUNK, PushChunk, &job, workers);
+}
+
+const unsigned char* ObsFrame(const ObsBatch& obs, int index, int age)
+{
+	return Slot(obs, index, (obs.newest - age + OBS_STACK) % OBS_STACK);
+}
+
+void ObsCopyStack(const ObsBatch& obs, int index, unsigned char* out)
+{
+	for (int age = OBS_STACK - 1; age >= 0; age--)
+	{
+		memcpy(out, ObsFrame(obs, index, age), OBS_PIXELS);
+		out += OBS_PIXELS;
+	}
+}
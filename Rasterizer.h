@@ -0,0 +1,62 @@
+#pragma once
+#include "SimBatch.h"
+
+// Software rasterizer for pixel observations: draws the arena, ball and
+// paddles of many matches into small grayscale frames, without SDL or a
+// display. Rects are the same the game draws, scaled down to the frame and
+// never thinner than a pixel.
+//
+// Every match keeps its last OBS_STACK frames in a ring. A new frame goes into
+// the slot of the oldest one, which already holds the arena: only the rects
+// drawn there OBS_STACK frames ago are erased and the new ones drawn, a few
+// hundred bytes instead of the whole frame. Fills are SSE2 stores, and
+// batches are drawn OBS_CHUNK matches per task on the work-stealing pool.
+
+const int OBS_WIDTH = 84;
+const int OBS_HEIGHT = 84;
+const int OBS_PIXELS = OBS_WIDTH * OBS_HEIGHT;
+const int OBS_STACK = 4;
+
+// Gray levels
+const unsigned char OBS_BACKGROUND = 0;
+const unsigned char OBS_BORDER = 96;
+const unsigned char OBS_BODY = 255; // Ball and paddles
+
+const int OBS_BODIES = 3; // Ball, player and enemy
+const int OBS_CHUNK = 256; // Matches drawn by one task
+
+// Pixels of the frame, x0 and y0 included, x1 and y1 not
+typedef struct ObsRect
+{
+	short x0, y0, x1, y1;
+} ObsRect;
+
+typedef struct ObsBatch
+{
+	int count;
+	int newest; // Ring slot of the newest frame, the same for every match
+
+	unsigned char* pixels; // [count][OBS_STACK][OBS_PIXELS]
+	ObsRect* drawn; // [count][OBS_STACK][OBS_BODIES], what each slot shows
+} ObsBatch;
+
+ObsRect ObsMapRect(const SimRect& rect);
+
+// The whole frame, for a single match
+void RasterizeFrame(const SimState& state, unsigned char* frame);
+
+void ObsBatchInit(ObsBatch& obs, int count);
+void ObsBatchFree(ObsBatch& obs);
+
+// Fills every slot of a match with its current frame, for a new episode
+void ObsBatchReset(ObsBatch& obs, const SimBatch& batch, int index);
+void ObsBatchResetAll(ObsBatch& obs, const SimBatch& batch, int workers = 0);
+
+// Draws the current frame of every match over its oldest one
+void ObsBatchPush(ObsBatch& obs, const SimBatch& batch, int workers = 0);
+
+// age 0 is the newest frame, OBS_STACK - 1 the oldest
+const unsigned char* ObsFrame(const ObsBatch& obs, int index, int age);
+
+// OBS_STACK frames, oldest first, as a trainer expects them
+void ObsCopyStack(const ObsBatch& obs, int index, unsigned char* out);
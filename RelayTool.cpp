@@ -0,0 +1,72 @@
+#include "SpectatorRelay.h"
+#include "Profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+// Spectator relay server. Prints what it forwarded and the CPU it took every
+// RELAY_REPORT_SECONDS.
+
+const int RELAY_REPORT_SECONDS = 5;
+
+double CpuSeconds()
+{
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+int main(int argc, char* args[])
+{
+	// Numeric and a valid port, 0 picks any free one
+	char* end = NULL;
+	long port = argc > 1 ? strtol(args[1], &end, 10) : SPECTATOR_DEFAULT_PORT;
+	if (argc > 2 || (end != NULL && (end == args[1] || *end != '\0')) || port < 0 || port > 65535)
+	{
+		printf("Usage: pingpong_relay [PORT]  forwards a match from pingpong --broadcast to pingpong --spectate, port %d by default\n", SPECTATOR_DEFAULT_PORT);
+		return EXIT_FAILURE;
+	}
+
+	static SpectatorRelay relay;
+	if (!RelayOpen(relay, (int)port))
+	{
+		return EXIT_FAILURE;
+	}
+	printf("Relaying spectator streams on port %d\n", RelayPort(relay));
+	fflush(stdout);
+
+	long long reportTime = ProfileNow();
+	double reportCpu = CpuSeconds();
+	RelayStats reported = relay.stats;
+
+	for (;;)
+	{
+		RelayPoll(relay, 100);
+
+		long long now = ProfileNow();
+		if (now - reportTime < RELAY_REPORT_SECONDS * 1000000000LL)
+		{
+			continue;
+		}
+
+		double seconds = (now - reportTime) / 1e9;
+		double cpu = CpuSeconds();
+		const RelayStats& stats = relay.stats;
+		int viewers = stats.viewers > 0 ? stats.viewers : 1;
+
+		printf("%d viewers, %.0f messages/s in, %.1f KB/s out (%.0f B/s per viewer), %.0f sends/s, %lld skips, CPU %.2f%% (%.2f us per viewer per second)\n",
+			stats.viewers,
+			(stats.messagesIn - reported.messagesIn) / seconds,
+			(stats.bytesOut - reported.bytesOut) / seconds / 1024,
+			(stats.bytesOut - reported.bytesOut) / seconds / viewers,
+			(stats.sends - reported.sends) / seconds,
+			stats.skipped - reported.skipped,
+			(cpu - reportCpu) / seconds * 100,
+			(cpu - reportCpu) / seconds / viewers * 1e6);
+		fflush(stdout);
+
+		reportTime = now;
+		reportCpu = cpu;
+		reported = stats;
+	}
+}
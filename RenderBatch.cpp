@@ -0,0 +1,336 @@
+#include "RenderBatch.h"
+#include <stdio.h>
+#include <algorithm>
+#include <functional>
+
+typedef struct RenderCommand
+{
+	int layer;
+	SDL_BlendMode blend;
+	SDL_Texture* texture; // NULL for solid rects
+	int sequence; // Record order, keeps the sort stable
+	SDL_FRect dst;
+	float u0, v0, u1, v1;
+	SDL_Color color;
+} RenderCommand;
+
+static SDL_Renderer* batchRenderer = NULL;
+
+static RenderCommand commands[MAX_RENDER_COMMANDS];
+static int order[MAX_RENDER_COMMANDS];
+static int commandCount = 0;
+
+// Four vertices and six indices per command, enough for a single run of all of them
+static SDL_Vertex vertices[MAX_RENDER_COMMANDS * 4];
+static int indices[MAX_RENDER_COMMANDS * 6];
+
+static RenderBatchStats stats;
+
+static bool clearPending = false;
+static bool drawingLayer = false;
+
+// The size of the last texture recorded, most draws repeat it
+static SDL_Texture* sizedTexture = NULL;
+static int sizedWidth = 1;
+static int sizedHeight = 1;
+
+void InitRenderBatch(SDL_Renderer* renderer)
+{
+	batchRenderer = renderer;
+	commandCount = 0;
+	sizedTexture = NULL;
+}
+
+static RenderCommand& AddCommand(SDL_Texture* texture, RenderLayer layer, SDL_BlendMode blend)
+{
+	if (commandCount == MAX_RENDER_COMMANDS)
+	{
+		FlushRenderBatch();
+	}
+
+	RenderCommand& command = commands[commandCount];
+	command.layer = layer;
+	command.blend = blend;
+	command.texture = texture;
+	command.sequence = commandCount;
+	commandCount++;
+	return command;
+}
+
+void BatchTexture(SDL_Texture* texture, const SDL_Rect* src, SDL_Rect dst, RenderLayer layer, SDL_BlendMode blend)
+{
+	if (texture == NULL)
+	{
+		return;
+	}
+
+	if (texture != sizedTexture)
+	{
+		SDL_QueryTexture(texture, NULL, NULL, &sizedWidth, &sizedHeight);
+		sizedTexture = texture;
+	}
+
+	RenderCommand& command = AddCommand(texture, layer, blend);
+	command.dst = { (float)dst.x, (float)dst.y, (float)dst.w, (float)dst.h };
+	command.color = { 255, 255, 255, 255 };
+
+	if (src != NULL)
+	{
+		command.u0 = (float)src->x / sizedWidth;
+		command.v0 = (float)src->y / sizedHeight;
+		command.u1 = (float)(src->x + src->w) / sizedWidth;
+		command.v1 = (float)(src->y + src->h) / sizedHeight;
+	}
+	else
+	{
+		command.u0 = 0;
+		command.v0 = 0;
+		command.u1 = 1;
+		command.v1 = 1;
+	}
+}
+
+void BatchRect(SDL_Rect rect, SDL_Color color, RenderLayer layer, SDL_BlendMode blend)
+{
+	RenderCommand& command = AddCommand(NULL, layer, blend);
+	command.dst = { (float)rect.x, (float)rect.y, (float)rect.w, (float)rect.h };
+	command.color = color;
+	command.u0 = 0;
+	command.v0 = 0;
+	command.u1 = 0;
+	command.v1 = 0;
+}
+
+void BatchOutline(SDL_Rect rect, SDL_Color color, RenderLayer layer)
+{
+	// One pixel wide sides, as SDL_RenderDrawRect draws them
+	BatchRect({ rect.x, rect.y, rect.w, 1 }, color, layer);
+	BatchRect({ rect.x, rect.y + rect.h - 1, rect.w, 1 }, color, layer);
+	BatchRect({ rect.x, rect.y + 1, 1, rect.h - 2 }, color, layer);
+	BatchRect({ rect.x + rect.w - 1, rect.y + 1, 1, rect.h - 2 }, color, layer);
+}
+
+static bool CommandBefore(int a, int b)
+{
+	const RenderCommand& ca = commands[a];
+	const RenderCommand& cb = commands[b];
+	if (ca.layer != cb.layer)
+	{
+		return ca.layer < cb.layer;
+	}
+	if (ca.blend != cb.blend)
+	{
+		return ca.blend < cb.blend;
+	}
+	if (ca.texture != cb.texture)
+	{
+		// Unrelated pointers only have a total order through std::less
+		return std::less<SDL_Texture*>()(ca.texture, cb.texture);
+	}
+	return ca.sequence < cb.sequence;
+}
+
+static bool SameBatch(const RenderCommand& a, const RenderCommand& b)
+{
+	return a.layer == b.layer && a.blend == b.blend && a.texture == b.texture;
+}
+
+static void SubmitRun(int first, int last)
+{
+	const RenderCommand& head = commands[order[first]];
+
+	int vertexCount = 0;
+	int indexCount = 0;
+	for (int i = first; i < last; i++)
+	{
+		const RenderCommand& command = commands[order[i]];
+		float x0 = command.dst.x;
+		float y0 = command.dst.y;
+		float x1 = command.dst.x + command.dst.w;
+		float y1 = command.dst.y + command.dst.h;
+
+		SDL_Vertex* v = &vertices[vertexCount];
+		v[0] = { { x0, y0 }, command.color, { command.u0, command.v0 } };
+		v[1] = { { x1, y0 }, command.color, { command.u1, command.v0 } };
+		v[2] = { { x1, y1 }, command.color, { command.u1, command.v1 } };
+		v[3] = { { x0, y1 }, command.color, { command.u0, command.v1 } };
+
+		int* index = &indices[indexCount];
+		index[0] = vertexCount;
+		index[1] = vertexCount + 1;
+		index[2] = vertexCount + 2;
+		index[3] = vertexCount;
+		index[4] = vertexCount + 2;
+		index[5] = vertexCount + 3;
+
+		vertexCount += 4;
+		indexCount += 6;
+	}
+
+	// Solid geometry takes the renderer's blend mode
+	if (head.texture != NULL)
+	{
+		SDL_SetTextureBlendMode(head.texture, head.blend);
+	}
+	else
+	{
+		SDL_SetRenderDrawBlendMode(batchRenderer, head.blend);
+	}
+
+	SDL_RenderGeometry(batchRenderer, head.texture, vertices, vertexCount, indices, indexCount);
+	stats.batches++;
+}
+
+void FlushRenderBatch()
+{
+	if (batchRenderer == NULL)
+	{
+		// Nowhere to draw yet
+		commandCount = 0;
+		return;
+	}
+
+	if (clearPending && !drawingLayer)
+	{
+		SDL_SetRenderDrawColor(batchRenderer, 0, 0, 0, 0);
+		SDL_RenderClear(batchRenderer);
+		clearPending = false;
+	}
+
+	for (int i = 0; i < commandCount; i++)
+	{
+		order[i] = i;
+	}
+	std::sort(order, order + commandCount, CommandBefore);
+
+	int first = 0;
+	for (int i = 1; i <= commandCount; i++)
+	{
+		if (i == commandCount || !SameBatch(commands[order[first]], commands[order[i]]))
+		{
+			SubmitRun(first, i);
+			first = i;
+		}
+	}
+
+	stats.commands += commandCount;
+	commandCount = 0;
+
+	// The texture may be destroyed after this, and its address reused
+	sizedTexture = NULL;
+}
+
+void BeginRenderFrame()
+{
+	clearPending = true;
+}
+
+void DiscardRenderBatch()
+{
+	commandCount = 0;
+	sizedTexture = NULL;
+}
+
+RenderBatchStats GetRenderBatchStats()
+{
+	return stats;
+}
+
+void ResetRenderBatchStats()
+{
+	stats.commands = 0;
+	stats.batches = 0;
+}
+
+unsigned LayerKey(const char* text, unsigned key)
+{
+	while (*text)
+	{
+		key = (key ^ (unsigned char)*text++) * 16777619u;
+	}
+	return key;
+}
+
+unsigned LayerKey(int value, unsigned key)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		key = (key ^ ((unsigned)value >> (i * 8) & 0xFF)) * 16777619u;
+	}
+	return key;
+}
+
+bool BeginLayer(RetainedLayer& layer, unsigned key)
+{
+	if (layer.failed)
+	{
+		return true;
+	}
+
+	if (layer.valid && layer.key == key)
+	{
+		return false;
+	}
+
+	if (layer.texture == NULL)
+	{
+		int width, height;
+		SDL_GetRendererOutputSize(batchRenderer, &width, &height);
+		layer.texture = SDL_CreateTexture(batchRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, width, height);
+		if (layer.texture == NULL)
+		{
+			printf("Layer could not be created, drawing every frame! SDL_Error: %s\n", SDL_GetError());
+			layer.failed = true;
+			return true;
+		}
+	}
+
+	FlushRenderBatch();
+	SDL_SetRenderTarget(batchRenderer, layer.texture);
+	SDL_SetRenderDrawColor(batchRenderer, 0, 0, 0, 0);
+	SDL_RenderClear(batchRenderer);
+	drawingLayer = true;
+
+	layer.key = key;
+	layer.valid = true;
+	return true;
+}
+
+void EndLayer(RetainedLayer& layer)
+{
+	if (layer.failed)
+	{
+		return;
+	}
+
+	FlushRenderBatch();
+	SDL_SetRenderTarget(batchRenderer, NULL);
+	drawingLayer = false;
+}
+
+void DrawLayer(const RetainedLayer& layer)
+{
+	if (layer.texture == NULL || !layer.valid)
+	{
+		return;
+	}
+
+	// Drawn over the cleared black window, the blended content is already right
+	int width, height;
+	SDL_QueryTexture(layer.texture, NULL, NULL, &width, &height);
+	BatchTexture(layer.texture, NULL, { 0, 0, width, height }, RENDER_LAYER_BACKGROUND, SDL_BLENDMODE_NONE);
+}
+
+void InvalidateLayer(RetainedLayer& layer)
+{
+	layer.valid = false;
+}
+
+void FreeLayer(RetainedLayer& layer)
+{
+	FlushRenderBatch();
+	SDL_DestroyTexture(layer.texture);
+	layer.texture = NULL;
+	layer.valid = false;
+	layer.failed = false;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <SDL.h>
+
+// Frame command buffer. Draws are recorded during the frame and submitted by
+// FlushRenderBatch, sorted by layer, blend mode and texture, with every run
+// of the same texture sent as one SDL_RenderGeometry call. Draw order is kept
+// within a layer only for draws sharing a texture, so anything that has to
+// be on top of something else goes on a later layer.
+
+enum RenderLayer
+{
+	RENDER_LAYER_BACKGROUND, // Retained layers
+	RENDER_LAYER_GAME, // Ball and paddles
+	RENDER_LAYER_UI, // Labels
+	RENDER_LAYER_OVERLAY // Debug views over everything
+};
+
+const int MAX_RENDER_COMMANDS = 2048; // Flushes early past this
+
+typedef struct RenderBatchStats
+{
+	int commands;
+	int batches; // SDL_RenderGeometry calls
+} RenderBatchStats;
+
+// The renderer the batches are submitted to, once it's created
+void InitRenderBatch(SDL_Renderer* renderer);
+
+// src NULL for the whole texture
+void BatchTexture(SDL_Texture* texture, const SDL_Rect* src, SDL_Rect dst, RenderLayer layer, SDL_BlendMode blend = SDL_BLENDMODE_BLEND);
+void BatchRect(SDL_Rect rect, SDL_Color color, RenderLayer layer, SDL_BlendMode blend = SDL_BLENDMODE_NONE);
+void BatchOutline(SDL_Rect rect, SDL_Color color, RenderLayer layer);
+
+// The window is cleared to black right before the frame's first draws, so a
+// frame that ends up not presented never touches the renderer
+void BeginRenderFrame();
+
+// Before SDL_RenderPresent, and before destroying a texture that may be queued
+void FlushRenderBatch();
+
+// Drops what was queued, for a frame that is not presented
+void DiscardRenderBatch();
+
+// Counted since the last ResetRenderBatchStats
+RenderBatchStats GetRenderBatchStats();
+void ResetRenderBatchStats();
+
+// Retained layer: a window sized render target holding what rarely changes,
+// redrawn only when its key does. Without render target support every frame
+// draws straight to the window as before.
+typedef struct RetainedLayer
+{
+	SDL_Texture* texture;
+	unsigned key;
+	bool valid;
+	bool failed; // No render targets
+} RetainedLayer;
+
+// FNV-1a, chain calls to key a layer on several texts
+unsigned LayerKey(const char* text, unsigned key = 2166136261u);
+unsigned LayerKey(int value, unsigned key = 2166136261u);
+
+// True when the layer has to be drawn again, the draws until EndLayer go
+// into it. Call before anything else of the frame is queued.
+bool BeginLayer(RetainedLayer& layer, unsigned key);
+void EndLayer(RetainedLayer& layer);
+
+// Queues the layer under everything else, it covers the whole window
+void DrawLayer(const RetainedLayer& layer);
+
+void InvalidateLayer(RetainedLayer& layer);
+void FreeLayer(RetainedLayer& layer);
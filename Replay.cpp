@@ -0,0 +1,306 @@
+#include "Replay.h"
+#include "MappedFile.h"
+#include <string.h>
+
+// Input record flags
+const int REPLAY_DIRECTION_MASK = 3;
+const int REPLAY_START = 1 << 2;
+const int REPLAY_SPEED = 1 << 3; // A varint speed follows, SIM_FULL_SPEED without it
+
+static void WriteVarint(FILE* file, unsigned value, long long& size)
+{
+	while (value >= 0x80)
+	{
+		fputc((int)(value & 0x7F) | 0x80, file);
+		value >>= 7;
+		size++;
+	}
+	fputc((int)value, file);
+	size++;
+}
+
+// False when the varint runs past end or is longer than an unsigned
+static bool ReadVarint(const unsigned char* data, long long end, long long& offset, unsigned& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 35; shift += 7)
+	{
+		if (offset >= end)
+		{
+			return false;
+		}
+		unsigned char byte = data[offset++];
+		value |= (unsigned)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// One input record at offset, false when it runs past the input stream
+static bool ReadInputRecord(const unsigned char* inputs, long long inputSize, long long& offset, unsigned& ticks, int& flags, unsigned& speed)
+{
+	if (!ReadVarint(inputs, inputSize, offset, ticks) || offset >= inputSize)
+	{
+		return false;
+	}
+	flags = inputs[offset++];
+	speed = SIM_FULL_SPEED;
+	return !(flags & REPLAY_SPEED) || ReadVarint(inputs, inputSize, offset, speed);
+}
+
+static void AddKeyframe(ReplayRecorder& recorder, const SimState& state)
+{
+	ReplayKeyframe keyframe;
+	memset(&keyframe, 0, sizeof(keyframe));
+	keyframe.tick = recorder.tick;
+	keyframe.inputOffset = recorder.header.inputSize;
+	keyframe.lastInputTick = recorder.lastInputTick;
+	keyframe.playerDirection = recorder.playerDirection;
+	keyframe.playerSpeed = recorder.playerSpeed;
+	keyframe.state = state;
+	recorder.keyframes.push_back(keyframe);
+}
+
+bool ReplayBeginRecording(ReplayRecorder& recorder, const char* path, const SimState& state)
+{
+	recorder.file = fopen(path, "wb");
+	if (recorder.file == NULL)
+	{
+		printf("Replay %s could not be created\n", path);
+		return false;
+	}
+
+	memset(&recorder.header, 0, sizeof(recorder.header));
+	recorder.header.magic = REPLAY_MAGIC;
+	recorder.header.version = REPLAY_VERSION;
+	recorder.header.stateSize = (int)sizeof(SimState);
+	recorder.header.config = state.config;
+
+	// Never grows past this, the sim thread doesn't allocate mid-match
+	recorder.keyframes.clear();
+	recorder.keyframes.reserve(REPLAY_MAX_KEYFRAMES);
+	recorder.tick = 0;
+	recorder.lastInputTick = 0;
+	recorder.playerDirection = DIRECTION_STOP;
+	recorder.playerSpeed = SIM_FULL_SPEED;
+
+	// Filled in by ReplayEndRecording
+	fwrite(&recorder.header, sizeof(recorder.header), 1, recorder.file);
+	return true;
+}
+
+void ReplayRecordStep(ReplayRecorder& recorder, const SimState& state, const SimInput& input)
+{
+	if (recorder.file == NULL)
+	{
+		return;
+	}
+
+	if (recorder.tick % REPLAY_KEYFRAME_INTERVAL == 0 && recorder.keyframes.size() < (size_t)REPLAY_MAX_KEYFRAMES)
+	{
+		AddKeyframe(recorder, state);
+	}
+
+	// Keys always move at full speed, only analog input and partial ticks add the varint
+	bool partial = input.playerSpeed != SIM_FULL_SPEED;
+	if (input.playerDirection != recorder.playerDirection || input.playerSpeed != recorder.playerSpeed || input.start)
+	{
+		WriteVarint(recorder.file, (unsigned)(recorder.tick - recorder.lastInputTick), recorder.header.inputSize);
+		fputc((input.playerDirection + 1) | (input.start ? REPLAY_START : 0) | (partial ? REPLAY_SPEED : 0), recorder.file);
+		recorder.header.inputSize++;
+		if (partial)
+		{
+			WriteVarint(recorder.file, (unsigned)input.playerSpeed, recorder.header.inputSize);
+		}
+
+		recorder.lastInputTick = recorder.tick;
+		recorder.playerDirection = input.playerDirection;
+		recorder.playerSpeed = input.playerSpeed;
+	}
+
+	recorder.tick++;
+}
+
+bool ReplayEndRecording(ReplayRecorder& recorder, const SimState& state)
+{
+	if (recorder.file == NULL)
+	{
+		return false;
+	}
+
+	// Keyframes start 8 byte aligned so playback can read them in place
+	long long offset = (long long)sizeof(ReplayHeader) + recorder.header.inputSize;
+	while (offset % 8 != 0)
+	{
+		fputc(0, recorder.file);
+		offset++;
+	}
+
+	recorder.header.tickCount = recorder.tick;
+	recorder.header.playerPoints = state.playerPoints;
+	recorder.header.enemyPoints = state.enemyPoints;
+	recorder.header.keyframeCount = (int)recorder.keyframes.size();
+	recorder.header.keyframeOffset = offset;
+
+	fwrite(recorder.keyframes.data(), sizeof(ReplayKeyframe), recorder.keyframes.size(), recorder.file);
+
+	fseek(recorder.file, 0, SEEK_SET);
+	fwrite(&recorder.header, sizeof(recorder.header), 1, recorder.file);
+
+	bool ok = !ferror(recorder.file);
+	fclose(recorder.file);
+	recorder.file = NULL;
+	recorder.keyframes.clear();
+	return ok;
+}
+
+static const ReplayKeyframe* Keyframes(const ReplayPlayer& player)
+{
+	return (const ReplayKeyframe*)(player.data + player.header->keyframeOffset);
+}
+
+bool ReplayOpen(ReplayPlayer& player, const char* path)
+{
+	memset(&player, 0, sizeof(player));
+
+	player.data = MapFile(path, player.size);
+	if (player.data == NULL)
+	{
+		printf("Replay %s could not be opened\n", path);
+		return false;
+	}
+
+	const ReplayHeader* header = (const ReplayHeader*)player.data;
+	bool valid = player.size >= sizeof(ReplayHeader)
+		&& header->magic == REPLAY_MAGIC
+		&& header->version == REPLAY_VERSION
+		&& header->stateSize == (int)sizeof(SimState)
+		&& header->keyframeCount > 0
+		&& header->inputSize >= 0
+		&& header->tickCount >= 0
+		&& header->keyframeOffset % 8 == 0
+		&& (long long)sizeof(ReplayHeader) + header->inputSize <= header->keyframeOffset
+		&& header->keyframeOffset + (long long)header->keyframeCount * (long long)sizeof(ReplayKeyframe) <= (long long)player.size;
+
+	if (!valid)
+	{
+		printf("Replay %s is not a replay of this version\n", path);
+		UnmapFile(player.data, player.size);
+		player.data = NULL;
+		return false;
+	}
+
+	player.header = header;
+	player.inputs = player.data + sizeof(ReplayHeader);
+
+	// Every record ends inside the input stream, and every keyframe points
+	// into it at its own tick, so playback never reads past the mapping
+	long long offset = 0;
+	while (valid && offset < header->inputSize)
+	{
+		unsigned ticks, speed;
+		int flags;
+		valid = ReadInputRecord(player.inputs, header->inputSize, offset, ticks, flags, speed);
+	}
+	for (int i = 0; valid && i < header->keyframeCount; i++)
+	{
+		const ReplayKeyframe& keyframe = Keyframes(player)[i];
+		valid = keyframe.tick == i * REPLAY_KEYFRAME_INTERVAL
+			&& keyframe.tick <= header->tickCount
+			&& keyframe.inputOffset >= 0
+			&& keyframe.inputOffset <= header->inputSize;
+	}
+
+	if (!valid)
+	{
+		printf("Replay %s is damaged\n", path);
+		ReplayClose(player);
+		return false;
+	}
+
+	ReplaySeek(player, 0);
+	return true;
+}
+
+void ReplayClose(ReplayPlayer& player)
+{
+	if (player.data != NULL)
+	{
+		UnmapFile(player.data, player.size);
+	}
+	memset(&player, 0, sizeof(player));
+}
+
+void ReplaySeek(ReplayPlayer& player, int tick)
+{
+	if (tick < 0)
+	{
+		tick = 0;
+	}
+	if (tick > player.header->tickCount)
+	{
+		tick = player.header->tickCount;
+	}
+
+	// Keyframes are evenly spaced, restore the last one before the tick
+	int index = tick / REPLAY_KEYFRAME_INTERVAL;
+	if (index >= player.header->keyframeCount)
+	{
+		index = player.header->keyframeCount - 1;
+	}
+
+	const ReplayKeyframe& keyframe = Keyframes(player)[index];
+	player.tick = keyframe.tick;
+	player.state = keyframe.state;
+	player.input.playerDirection = keyframe.playerDirection;
+	player.input.playerSpeed = keyframe.playerSpeed;
+	player.input.start = false;
+	player.inputOffset = keyframe.inputOffset;
+	player.lastInputTick = keyframe.lastInputTick;
+
+	// Fast forward
+	while (player.tick < tick)
+	{
+		ReplayStep(player);
+	}
+}
+
+int ReplayStep(ReplayPlayer& player)
+{
+	player.input.start = false;
+
+	if (player.inputOffset < player.header->inputSize)
+	{
+		long long offset = player.inputOffset;
+		unsigned ticks, speed;
+		int flags;
+		bool read = ReadInputRecord(player.inputs, player.header->inputSize, offset, ticks, flags, speed);
+		int recordTick = player.lastInputTick + (int)ticks;
+
+		// ReplayOpen rejects streams that get cut short, the input just ends there
+		if (!read)
+		{
+			player.inputOffset = player.header->inputSize;
+		}
+		else if (recordTick == player.tick)
+		{
+			player.input.playerDirection = (flags & REPLAY_DIRECTION_MASK) - 1;
+			player.input.start = (flags & REPLAY_START) != 0;
+			player.input.playerSpeed = (int)speed;
+
+			player.inputOffset = offset;
+			player.lastInputTick = recordTick;
+		}
+	}
+
+	player.tick++;
+	return SimStep(player.state, player.input);
+}
+
+bool ReplayFinished(const ReplayPlayer& player)
+{
+	return player.tick >= player.header->tickCount;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "Simulation.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <vector>
+
+// Binary match replays.
+//
+// Layout: ReplayHeader, then the input stream, then ReplayHeader::keyframeCount keyframes.
+// The input stream only has a record when the player changes direction or speed or presses
+// ENTER: a varint with the ticks since the previous record, then one byte with the direction
+// in the low two bits, the ENTER press in the third and, in the fourth, whether a varint
+// with a speed below SIM_FULL_SPEED follows. A keyframe with the whole
+// SimState is taken every REPLAY_KEYFRAME_INTERVAL ticks, up to REPLAY_MAX_KEYFRAMES, so
+// playback can seek anywhere.
+
+const unsigned REPLAY_MAGIC = 0x50525050; // "PPRP"
+const int REPLAY_VERSION = 5;
+
+// Every 10 seconds of play
+const int REPLAY_KEYFRAME_INTERVAL = SIM_TICKS_PER_SECOND * 10;
+
+// Reserved when recording begins so the sim thread never allocates. About 10
+// minutes counting the waits between rounds, seeking past the last keyframe
+// fast-forwards from it.
+const int REPLAY_MAX_KEYFRAMES = 64;
+
+typedef struct ReplayHeader
+{
+	unsigned magic;
+	int version;
+	int stateSize; // sizeof(SimState) of the build that recorded it
+
+	SimConfig config;
+
+	int tickCount;
+	int playerPoints; // Final score, lets regression runs check the replay
+	int enemyPoints;
+
+	int keyframeCount;
+	long long inputSize;
+	long long keyframeOffset;
+} ReplayHeader;
+
+typedef struct ReplayKeyframe
+{
+	int tick;
+
+	// Input stream position right after this tick's state
+	long long inputOffset;
+	int lastInputTick;
+	int playerDirection;
+	int playerSpeed;
+
+	SimState state;
+} ReplayKeyframe;
+
+typedef struct ReplayRecorder
+{
+	FILE* file = NULL; // Not recording
+	ReplayHeader header;
+	std::vector<ReplayKeyframe> keyframes;
+
+	int tick;
+	int lastInputTick;
+	int playerDirection;
+	int playerSpeed;
+} ReplayRecorder;
+
+typedef struct ReplayPlayer
+{
+	// Memory mapped file
+	const unsigned char* data;
+	size_t size;
+
+	const ReplayHeader* header;
+	const unsigned char* inputs;
+
+	int tick;
+	SimState state;
+	SimInput input;
+
+	// Next record of the input stream
+	long long inputOffset;
+	int lastInputTick;
+} ReplayPlayer;
+
+// Recording, state is the match before its first step
+bool ReplayBeginRecording(ReplayRecorder& recorder, const char* path, const SimState& state);
+void ReplayRecordStep(ReplayRecorder& recorder, const SimState& state, const SimInput& input);
+bool ReplayEndRecording(ReplayRecorder& recorder, const SimState& state);
+
+// Playback
+bool ReplayOpen(ReplayPlayer& player, const char* path);
+void ReplayClose(ReplayPlayer& player);
+void ReplaySeek(ReplayPlayer& player, int tick);
+int ReplayStep(ReplayPlayer& player);
+bool ReplayFinished(const ReplayPlayer& player);
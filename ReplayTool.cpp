@@ -0,0 +1,173 @@
+#include "Replay.h"
+#include "WorkStealingPool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+typedef struct PlaybackRun
+{
+	char** paths;
+	std::vector<int> ok; // 1 when the replay ends with the recorded score
+	std::vector<long long> ticks;
+} PlaybackRun;
+
+void PrintUsage()
+{
+	printf("Usage: pingpong_replay record DIR COUNT [SEED]  records COUNT bot matches into DIR\n");
+	printf("       pingpong_replay play FILE...              replays and checks every file\n");
+	printf("       pingpong_replay seek FILE TICK            shows the match at TICK\n");
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// xorshift
+unsigned NextRandom(unsigned& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+int Record(const char* directory, int count, unsigned seed)
+{
+	for (int i = 0; i < count; i++)
+	{
+		char path[512];
+		snprintf(path, sizeof(path), "%s/match_%05d.ppr", directory, i);
+
+		SimState state;
+		SimInit(state, SimDefaultConfig());
+
+		ReplayRecorder recorder;
+		if (!ReplayBeginRecording(recorder, path, state))
+		{
+			return EXIT_FAILURE;
+		}
+
+		// Autopilot that only reacts on some ticks, so every match is different.
+		// Some reactions are only part of a tick, like a stick or a late key.
+		unsigned random = seed ^ (unsigned)(i * 104729) ^ 0x9E3779B9u;
+		SimInput input = { DIRECTION_STOP, SIM_FULL_SPEED, false };
+		while (!state.finished)
+		{
+			SimInput bot = SimAutopilotInput(state);
+			if (NextRandom(random) % 100 < 25)
+			{
+				input.playerDirection = bot.playerDirection;
+				input.playerSpeed = NextRandom(random) % 4 == 0 ? (int)(NextRandom(random) % SIM_FULL_SPEED) : SIM_FULL_SPEED;
+			}
+			input.start = bot.start;
+
+			ReplayRecordStep(recorder, state, input);
+			SimStep(state, input);
+		}
+
+		if (!ReplayEndRecording(recorder, state))
+		{
+			printf("Replay %s could not be written\n", path);
+			return EXIT_FAILURE;
+		}
+	}
+
+	printf("Recorded %d matches into %s\n", count, directory);
+	return EXIT_SUCCESS;
+}
+
+static void PlayOne(void* data, int taskIndex, int workerIndex)
+{
+	PlaybackRun& run = *(PlaybackRun*)data;
+
+	ReplayPlayer player;
+	if (!ReplayOpen(player, run.paths[taskIndex]))
+	{
+		return;
+	}
+
+	while (!ReplayFinished(player))
+	{
+		ReplayStep(player);
+	}
+
+	run.ok[taskIndex] = player.state.playerPoints == player.header->playerPoints
+		&& player.state.enemyPoints == player.header->enemyPoints;
+	run.ticks[taskIndex] = player.tick;
+
+	ReplayClose(player);
+}
+
+int Play(char** paths, int count)
+{
+	PlaybackRun run;
+	run.paths = paths;
+	run.ok.assign(count, 0);
+	run.ticks.assign(count, 0);
+
+	auto start = std::chrono::steady_clock::now();
+	RunParallel(count, PlayOne, &run);
+	double seconds = SecondsSince(start);
+
+	int failed = 0;
+	long long ticks = 0;
+	for (int i = 0; i < count; i++)
+	{
+		if (!run.ok[i])
+		{
+			printf("FAILED %s\n", paths[i]);
+			failed++;
+		}
+		ticks += run.ticks[i];
+	}
+
+	printf("replays: %d  failed: %d  ticks: %lld  seconds: %.3f  ticks/s: %.0f\n",
+		count, failed, ticks, seconds, ticks / (seconds > 0 ? seconds : 1));
+	return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int Seek(const char* path, int tick)
+{
+	ReplayPlayer player;
+	if (!ReplayOpen(player, path))
+	{
+		return EXIT_FAILURE;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	ReplaySeek(player, tick);
+	double seconds = SecondsSince(start);
+
+	const SimState& state = player.state;
+	printf("tick %d of %d (seek %.3f ms)\n", player.tick, player.header->tickCount, seconds * 1000);
+	printf("score %d - %d  time left %d\n", state.playerPoints, state.enemyPoints, state.timeLeft);
+	printf("ball %d,%d  player %d  enemy %d\n", state.ball.rect.x, state.ball.rect.y, state.player.rect.y, state.enemy.rect.y);
+
+	ReplayClose(player);
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char* args[])
+{
+	if (argc >= 4 && strcmp(args[1], "record") == 0)
+	{
+		unsigned seed = argc >= 5 ? (unsigned)strtoul(args[4], NULL, 10) : 2023;
+		return Record(args[2], atoi(args[3]), seed);
+	}
+
+	if (argc >= 3 && strcmp(args[1], "play") == 0)
+	{
+		return Play(args + 2, argc - 2);
+	}
+
+	if (argc == 4 && strcmp(args[1], "seek") == 0)
+	{
+		return Seek(args[2], atoi(args[3]));
+	}
+
+	PrintUsage();
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,314 @@
+#include "Resources.h"
+#include "AssetArchive.h"
+#include "WorkStealingPool.h"
+#include <SDL_image.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+enum ResourceState
+{
+	RESOURCE_QUEUED,
+	RESOURCE_READY,
+	RESOURCE_FAILED,
+	RESOURCE_FREED
+};
+
+typedef struct ResourceEntry
+{
+	const char* path;
+	ResourceType type;
+	std::atomic<int> state;
+	std::atomic<int> references;
+
+	// Whatever the type needs
+	SDL_Surface* surface;
+	Mix_Chunk* chunk;
+	void* bytes;
+	size_t size;
+	bool archived; // bytes point into the archive
+} ResourceEntry;
+
+static ResourceEntry resources[MAX_RESOURCES];
+static int resourceCount = 0;
+static std::atomic<int> resourcesPending(0);
+
+static AssetArchive resourceArchive;
+
+static std::thread resourceLoader;
+static std::mutex resourceLock;
+static std::condition_variable resourceLoaded;
+
+static void FreeResource(ResourceEntry& entry)
+{
+	Mix_FreeChunk(entry.chunk);
+	SDL_FreeSurface(entry.surface);
+	if (!entry.archived)
+	{
+		SDL_free(entry.bytes);
+	}
+
+	entry.archived = false;
+	entry.chunk = NULL;
+	entry.surface = NULL;
+	entry.bytes = NULL;
+	entry.size = 0;
+	entry.state = RESOURCE_FREED;
+}
+
+// Points SDL at the archived bytes, decoded ones are used in place
+static bool LoadArchivedResource(ResourceEntry& entry, const ArchiveEntry& archived)
+{
+	unsigned char* data = (unsigned char*)ArchiveData(resourceArchive, archived);
+	int size = (int)archived.size;
+
+	int frequency, channels;
+	Uint16 format;
+
+	switch (entry.type)
+	{
+	case ResourceType::IMAGE:
+		if (archived.kind == ARCHIVE_PIXELS)
+		{
+			entry.surface = SDL_CreateRGBSurfaceWithFormatFrom(data, archived.width, archived.height, 32, archived.pitch, archived.format);
+		}
+		else
+		{
+			entry.surface = IMG_Load_RW(SDL_RWFromConstMem(data, size), 1);
+		}
+		return entry.surface != NULL;
+
+	case ResourceType::SOUND:
+	case ResourceType::MUSIC:
+		// PCM decoded for another output format falls back to the loose file
+		if (archived.kind == ARCHIVE_PCM
+			&& Mix_QuerySpec(&frequency, &format, &channels)
+			&& frequency == archived.width && channels == archived.height && format == archived.format)
+		{
+			entry.chunk = Mix_QuickLoad_RAW(data, (Uint32)size);
+		}
+		else if (archived.kind == ARCHIVE_FILE)
+		{
+			entry.chunk = Mix_LoadWAV_RW(SDL_RWFromConstMem(data, size), 1);
+		}
+		return entry.chunk != NULL;
+
+	case ResourceType::FONT:
+		entry.bytes = data;
+		entry.size = archived.size;
+		entry.archived = true;
+		return true;
+	}
+	return false;
+}
+
+static void LoadResourceTask(void* data, int taskIndex, int workerIndex)
+{
+	ResourceEntry& entry = resources[taskIndex];
+	bool ok = false;
+
+	// Loose files for whatever the archive does not have
+	const ArchiveEntry* archived = ArchiveFind(resourceArchive, entry.path);
+	if (archived != NULL)
+	{
+		ok = LoadArchivedResource(entry, *archived);
+	}
+
+	if (!ok)
+	{
+		switch (entry.type)
+		{
+		case ResourceType::IMAGE:
+			entry.surface = IMG_Load(entry.path);
+			ok = entry.surface != NULL;
+			break;
+
+		case ResourceType::SOUND:
+		case ResourceType::MUSIC:
+			entry.chunk = Mix_LoadWAV(entry.path);
+			ok = entry.chunk != NULL;
+			break;
+
+		case ResourceType::FONT:
+			// Opened from memory on the main thread, SDL_ttf is not thread safe there
+			entry.bytes = SDL_LoadFile(entry.path, &entry.size);
+			ok = entry.bytes != NULL;
+			break;
+		}
+	}
+
+	if (!ok)
+	{
+		printf("Resource %s could not be loaded! SDL_Error: %s\n", entry.path, SDL_GetError());
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(resourceLock);
+		entry.state = ok ? RESOURCE_READY : RESOURCE_FAILED;
+		resourcesPending--;
+	}
+	resourceLoaded.notify_all();
+}
+
+static ResourceEntry* WaitForResource(ResourceHandle handle)
+{
+	if (handle < 0 || handle >= resourceCount)
+	{
+		return NULL;
+	}
+
+	ResourceEntry& entry = resources[handle];
+	if (entry.state == RESOURCE_QUEUED)
+	{
+		std::unique_lock<std::mutex> lock(resourceLock);
+		resourceLoaded.wait(lock, [&entry] { return entry.state != RESOURCE_QUEUED; });
+	}
+
+	return entry.state == RESOURCE_READY ? &entry : NULL;
+}
+
+bool UseResourceArchive(const char* path)
+{
+	ArchiveClose(resourceArchive);
+	return ArchiveOpen(resourceArchive, path);
+}
+
+bool UseResourceArchiveMemory(const unsigned char* data, size_t size)
+{
+	ArchiveClose(resourceArchive);
+	return ArchiveOpenMemory(resourceArchive, data, size);
+}
+
+ResourceHandle QueueResource(const char* path, ResourceType type)
+{
+	ResourceHandle existing = AcquireResource(path);
+	if (existing != NO_RESOURCE)
+	{
+		// Already queued, keep the single manager reference
+		resources[existing].references--;
+		return existing;
+	}
+
+	if (resourceCount == MAX_RESOURCES)
+	{
+		printf("Resource %s could not be queued, MAX_RESOURCES reached\n", path);
+		return NO_RESOURCE;
+	}
+
+	ResourceEntry& entry = resources[resourceCount];
+	entry.path = path;
+	entry.type = type;
+	entry.state = RESOURCE_QUEUED;
+	entry.references = 1;
+	resourcesPending++;
+
+	return resourceCount++;
+}
+
+void StartLoadingResources(int workers)
+{
+	// The calling thread goes on, the loader thread runs the pool
+	int count = resourceCount;
+	resourceLoader = std::thread([count, workers] {
+		RunParallel(count, LoadResourceTask, NULL, workers);
+	});
+}
+
+bool ResourcesLoaded()
+{
+	return resourcesPending == 0;
+}
+
+bool ResourceReady(ResourceHandle handle)
+{
+	return handle >= 0 && handle < resourceCount && resources[handle].state == RESOURCE_READY;
+}
+
+ResourceHandle AcquireResource(const char* path)
+{
+	for (int i = 0; i < resourceCount; i++)
+	{
+		if (strcmp(resources[i].path, path) == 0 && resources[i].state != RESOURCE_FREED)
+		{
+			resources[i].references++;
+			return i;
+		}
+	}
+	return NO_RESOURCE;
+}
+
+void ReleaseResource(ResourceHandle& handle)
+{
+	if (handle < 0 || handle >= resourceCount)
+	{
+		return;
+	}
+
+	ResourceEntry& entry = resources[handle];
+	if (--entry.references == 0)
+	{
+		// Can't free under a loader that is still writing it
+		WaitForResource(handle);
+		FreeResource(entry);
+	}
+	handle = NO_RESOURCE;
+}
+
+void UnloadResource(const char* path)
+{
+	ResourceHandle handle = AcquireResource(path);
+	if (handle != NO_RESOURCE)
+	{
+		// The one just taken plus the manager's
+		resources[handle].references--;
+		ReleaseResource(handle);
+	}
+}
+
+SDL_Surface* ResourceImage(ResourceHandle handle)
+{
+	ResourceEntry* entry = WaitForResource(handle);
+	return entry != NULL ? entry->surface : NULL;
+}
+
+Mix_Chunk* ResourceSound(ResourceHandle handle)
+{
+	ResourceEntry* entry = WaitForResource(handle);
+	return entry != NULL ? entry->chunk : NULL;
+}
+
+SDL_RWops* ResourceStream(ResourceHandle handle)
+{
+	ResourceEntry* entry = WaitForResource(handle);
+	return entry != NULL ? SDL_RWFromConstMem(entry->bytes, (int)entry->size) : NULL;
+}
+
+void QuitResources()
+{
+	if (resourceLoader.joinable())
+	{
+		resourceLoader.join();
+	}
+
+	for (int i = 0; i < resourceCount; i++)
+	{
+		ResourceEntry& entry = resources[i];
+		if (entry.state == RESOURCE_FREED)
+		{
+			continue;
+		}
+
+		if (entry.references != 1)
+		{
+			printf("Resource %s still has %d references\n", entry.path, entry.references - 1);
+		}
+		FreeResource(entry);
+		entry.references = 0;
+	}
+
+	resourceCount = 0;
+	ArchiveClose(resourceArchive);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <SDL.h>
+#include <SDL_mixer.h>
+
+// Resource manager. Every asset is queued once at startup and decoded on a
+// background thread pool while the game keeps running. Images, sounds and
+// music are fully decoded there; fonts are read into memory and opened from
+// it on first use, so after startup nothing touches the disk.
+//
+// Handles are reference counted. The manager holds the first reference of
+// every queued asset and drops it in QuitResources, or earlier with UnloadResource.
+
+enum class ResourceType
+{
+	IMAGE,
+	SOUND,
+	MUSIC,
+	FONT
+};
+
+typedef int ResourceHandle;
+const ResourceHandle NO_RESOURCE = -1;
+
+const int MAX_RESOURCES = 32;
+
+// Loads assets from a pingpong_pack archive instead of loose files. Assets
+// missing from it still come from disk. Call before StartLoadingResources.
+bool UseResourceArchive(const char* path);
+bool UseResourceArchiveMemory(const unsigned char* data, size_t size);
+
+// Queue every asset before StartLoadingResources
+ResourceHandle QueueResource(const char* path, ResourceType type);
+void StartLoadingResources(int workers = 0);
+
+bool ResourcesLoaded();
+bool ResourceReady(ResourceHandle handle);
+
+// Takes a reference, NO_RESOURCE when the path was never queued
+ResourceHandle AcquireResource(const char* path);
+void ReleaseResource(ResourceHandle& handle);
+
+// Drops the manager's own reference, the data goes away with the last user
+void UnloadResource(const char* path);
+
+// These wait when the resource is still loading. NULL if it failed.
+SDL_Surface* ResourceImage(ResourceHandle handle);
+Mix_Chunk* ResourceSound(ResourceHandle handle); // Sounds and music
+SDL_RWops* ResourceStream(ResourceHandle handle); // Read-only view of the file in memory
+
+// Waits for the loaders and frees everything, reporting handles still held
+void QuitResources();
@@ -0,0 +1,385 @@
+#include "Rollback.h"
+#include "Profiler.h"
+#include <stdio.h>
+#include <string.h>
+
+const unsigned NET_MAGIC = 0x504E5050; // "PPNP"
+
+enum NetPacketType
+{
+	NET_PACKET_HELLO = 1, // Joining, until the host answers
+	NET_PACKET_INPUT = 2
+};
+
+// Inputs one packet carries, the oldest unacknowledged ones are sent again later
+const int NET_MAX_INPUTS_PER_PACKET = 64;
+
+// Input byte: direction + 1 in the low two bits, ENTER in the third
+const unsigned char NET_INPUT_START = 4;
+const unsigned char NET_INPUT_DIRECTION = 3;
+const unsigned char NET_INPUT_STOP = DIRECTION_STOP + 1;
+
+static unsigned char EncodeInput(int direction, bool start)
+{
+	return (unsigned char)((direction + 1) | (start ? NET_INPUT_START : 0));
+}
+
+static int InputDirection(unsigned char input)
+{
+	return (input & NET_INPUT_DIRECTION) - 1;
+}
+
+// Little endian whatever the machine, both peers read the same bytes
+static unsigned char* PutInt(unsigned char* out, unsigned value)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		*out++ = (unsigned char)(value >> (i * 8));
+	}
+	return out;
+}
+
+static const unsigned char* GetInt(const unsigned char* in, unsigned& value)
+{
+	value = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		value |= (unsigned)*in++ << (i * 8);
+	}
+	return in;
+}
+
+static SimInput TickInput(const RollbackSession& session, int tick, unsigned char remote)
+{
+	unsigned char local = session.localInputs[tick & (NET_INPUT_HISTORY - 1)];
+	unsigned char player = session.host ? local : remote;
+	unsigned char enemy = session.host ? remote : local;
+
+	SimInput input;
+	input.playerDirection = InputDirection(player);
+	input.playerSpeed = SIM_FULL_SPEED;
+	input.enemyDirection = InputDirection(enemy);
+	input.start = ((player | enemy) & NET_INPUT_START) != 0;
+	return input;
+}
+
+static int Simulate(RollbackSession& session, int tick)
+{
+	// The peer keeps doing what it did last, presses are not repeated
+	unsigned char remote = NET_INPUT_STOP;
+	if (tick <= session.remoteTick)
+	{
+		remote = session.remoteInputs[tick & (NET_INPUT_HISTORY - 1)];
+	}
+	else if (session.remoteTick >= 0)
+	{
+		remote = session.remoteInputs[session.remoteTick & (NET_INPUT_HISTORY - 1)] & NET_INPUT_DIRECTION;
+	}
+
+	session.usedRemote[tick & (NET_INPUT_HISTORY - 1)] = remote;
+	session.saved[tick % ROLLBACK_WINDOW] = session.state;
+	return SimStep(session.state, TickInput(session, tick, remote));
+}
+
+static void Resimulate(RollbackSession& session)
+{
+	long long start = ProfileNow();
+
+	int from = session.rollbackFrom;
+	session.state = session.saved[from % ROLLBACK_WINDOW];
+	for (int tick = from; tick < session.tick; tick++)
+	{
+		Simulate(session, tick);
+	}
+	session.rollbackFrom = session.tick;
+
+	long long end = ProfileNow();
+	ProfileRecord(PROFILE_ROLLBACK, start, end);
+
+	RollbackStats& stats = session.stats;
+	int ticks = session.tick - from;
+	stats.rollbacks++;
+	stats.rolledBackTicks += ticks;
+	stats.totalNs += end - start;
+	stats.maxTicks = ticks > stats.maxTicks ? ticks : stats.maxTicks;
+	stats.maxNs = end - start > stats.maxNs ? end - start : stats.maxNs;
+}
+
+static void CheckHash(RollbackSession& session, int tick, unsigned hash)
+{
+	if (tick > session.hashedTick)
+	{
+		// Checked once this side confirms it too
+		session.peerHashTick = tick;
+		session.peerHash = hash;
+		return;
+	}
+
+	if (tick <= session.hashedTick - NET_HASH_HISTORY)
+	{
+		return;
+	}
+
+	session.stats.hashesChecked++;
+	if (session.hashes[tick & (NET_HASH_HISTORY - 1)] != hash && session.stats.desyncTick < 0)
+	{
+		session.stats.desyncTick = tick;
+		printf("Network match desync at tick %d!\n", tick);
+	}
+}
+
+static void UpdateHashes(RollbackSession& session)
+{
+	int confirmed = RollbackConfirmedTick(session);
+	for (int tick = session.hashedTick + 1; tick <= confirmed; tick++)
+	{
+		// The state right after the tick
+		const SimState& state = tick + 1 == session.tick ? session.state : session.saved[(tick + 1) % ROLLBACK_WINDOW];
+		session.hashes[tick & (NET_HASH_HISTORY - 1)] = SimHash(state);
+	}
+	session.hashedTick = confirmed > session.hashedTick ? confirmed : session.hashedTick;
+
+	if (session.peerHashTick >= 0 && session.peerHashTick <= session.hashedTick)
+	{
+		int tick = session.peerHashTick;
+		session.peerHashTick = -1;
+		CheckHash(session, tick, session.peerHash);
+	}
+}
+
+static void SendHello(RollbackSession& session)
+{
+	unsigned char packet[5];
+	unsigned char* out = PutInt(packet, NET_MAGIC);
+	*out++ = NET_PACKET_HELLO;
+	NetSend(session.socket, session.peer, packet, (int)(out - packet));
+	session.lastSend = ProfileNow();
+}
+
+static void SendInputs(RollbackSession& session)
+{
+	int first = session.peerAck + 1;
+	if (first < session.localTick - NET_MAX_INPUTS_PER_PACKET + 1)
+	{
+		first = session.localTick - NET_MAX_INPUTS_PER_PACKET + 1;
+	}
+	int count = session.localTick - first + 1;
+
+	unsigned char packet[MAX_NET_PACKET];
+	unsigned char* out = PutInt(packet, NET_MAGIC);
+	*out++ = NET_PACKET_INPUT;
+	out = PutInt(out, (unsigned)session.remoteTick);
+	out = PutInt(out, (unsigned)first);
+	*out++ = (unsigned char)count;
+	for (int tick = first; tick <= session.localTick; tick++)
+	{
+		*out++ = session.localInputs[tick & (NET_INPUT_HISTORY - 1)];
+	}
+	out = PutInt(out, (unsigned)session.hashedTick);
+	out = PutInt(out, session.hashedTick >= 0 ? session.hashes[session.hashedTick & (NET_HASH_HISTORY - 1)] : 0);
+
+	NetSend(session.socket, session.peer, packet, (int)(out - packet));
+	session.lastSend = ProfileNow();
+}
+
+static void ReadInputs(RollbackSession& session, const unsigned char* in, int size)
+{
+	// Ack, first tick, count, inputs, hash tick, hash
+	if (size < 9 || size < 9 + in[8] + 8)
+	{
+		return;
+	}
+
+	unsigned ack, first, hashTick, hash;
+	in = GetInt(in, ack);
+	in = GetInt(in, first);
+	int count = *in++;
+
+	if ((int)ack > session.peerAck)
+	{
+		session.peerAck = (int)ack;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		int tick = (int)first + i;
+		unsigned char input = in[i];
+
+		// Only the next one in order, older ones arrived already
+		if (tick != session.remoteTick + 1)
+		{
+			continue;
+		}
+
+		// Too far ahead to keep, it comes again
+		if (tick - session.tick >= NET_INPUT_HISTORY - ROLLBACK_WINDOW)
+		{
+			break;
+		}
+
+		session.remoteInputs[tick & (NET_INPUT_HISTORY - 1)] = input;
+		session.remoteTick = tick;
+
+		if (tick < session.tick && session.usedRemote[tick & (NET_INPUT_HISTORY - 1)] != input && tick < session.rollbackFrom)
+		{
+			session.rollbackFrom = tick;
+		}
+	}
+	in += count;
+
+	in = GetInt(in, hashTick);
+	GetInt(in, hash);
+	if ((int)hashTick >= 0)
+	{
+		CheckHash(session, (int)hashTick, hash);
+	}
+}
+
+static void Receive(RollbackSession& session)
+{
+	unsigned char packet[MAX_NET_PACKET];
+	NetAddress from;
+	int size;
+	while ((size = NetReceive(session.socket, from, packet, sizeof(packet))) >= 0)
+	{
+		unsigned magic = 0;
+		if (size >= 5)
+		{
+			GetInt(packet, magic);
+		}
+		if (magic != NET_MAGIC)
+		{
+			continue;
+		}
+
+		if (!session.connected)
+		{
+			// The host takes whoever comes first, the joining side waits for its host
+			if (session.host)
+			{
+				session.peer = from;
+			}
+			else if (!NetSameAddress(from, session.peer))
+			{
+				continue;
+			}
+			session.connected = true;
+		}
+		else if (!NetSameAddress(from, session.peer))
+		{
+			continue;
+		}
+
+		if (packet[4] == NET_PACKET_INPUT)
+		{
+			ReadInputs(session, packet + 5, size - 5);
+		}
+	}
+}
+
+bool RollbackOpen(RollbackSession& session, const SimConfig& config, const NetSetup& setup)
+{
+	RollbackClose(session);
+
+	session.host = setup.join == NULL;
+	session.connected = false;
+	if (!session.host && !NetResolve(setup.join, session.peer))
+	{
+		return false;
+	}
+
+	if (!NetOpen(session.socket, session.host ? setup.port : 0))
+	{
+		return false;
+	}
+	session.socket.shim = setup.shim;
+
+	SimConfig networkConfig = config;
+	networkConfig.enemyHuman = true;
+	SimInit(session.state, networkConfig);
+	session.tick = 0;
+
+	// Nobody can have pressed anything during the delay of the first ticks
+	session.inputDelay = setup.inputDelay < 0 ? 0 : setup.inputDelay > NET_MAX_INPUT_DELAY ? NET_MAX_INPUT_DELAY : setup.inputDelay;
+	memset(session.localInputs, NET_INPUT_STOP, sizeof(session.localInputs));
+	memset(session.remoteInputs, NET_INPUT_STOP, sizeof(session.remoteInputs));
+	session.localTick = session.inputDelay - 1;
+	session.remoteTick = session.inputDelay - 1;
+	session.peerAck = session.inputDelay - 1;
+	session.rollbackFrom = 0;
+
+	session.hashedTick = -1;
+	session.peerHashTick = -1;
+	session.lastSend = 0;
+
+	memset(&session.stats, 0, sizeof(session.stats));
+	session.stats.desyncTick = -1;
+
+	if (session.host)
+	{
+		printf("Hosting a network match on port %d\n", NetLocalPort(session.socket));
+	}
+	return true;
+}
+
+void RollbackClose(RollbackSession& session)
+{
+	NetClose(session.socket);
+	session.connected = false;
+}
+
+void RollbackPoll(RollbackSession& session)
+{
+	Receive(session);
+
+	if (!session.connected)
+	{
+		if (!session.host && ProfileNow() - session.lastSend >= NET_HELLO_INTERVAL_MS * 1000000LL)
+		{
+			SendHello(session);
+		}
+		return;
+	}
+
+	if (session.rollbackFrom < session.tick)
+	{
+		Resimulate(session);
+	}
+	session.rollbackFrom = session.tick;
+	UpdateHashes(session);
+
+	if (ProfileNow() - session.lastSend >= NET_RESEND_INTERVAL_MS * 1000000LL)
+	{
+		SendInputs(session);
+	}
+}
+
+int RollbackAdvance(RollbackSession& session, int direction, bool start)
+{
+	RollbackPoll(session);
+
+	if (!session.connected || session.tick - session.remoteTick > ROLLBACK_MAX_PREDICTION)
+	{
+		if (session.connected)
+		{
+			session.stats.stalls++;
+		}
+		return ROLLBACK_STALLED;
+	}
+
+	session.localTick = session.tick + session.inputDelay;
+	session.localInputs[session.localTick & (NET_INPUT_HISTORY - 1)] = EncodeInput(direction, start);
+
+	int events = Simulate(session, session.tick);
+	session.tick++;
+	session.rollbackFrom = session.tick;
+
+	UpdateHashes(session);
+	SendInputs(session);
+	return events;
+}
+
+int RollbackConfirmedTick(const RollbackSession& session)
+{
+	return session.remoteTick < session.tick - 1 ? session.remoteTick : session.tick - 1;
+}
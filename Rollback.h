@@ -0,0 +1,97 @@
+#pragma once
+#include "Simulation.h"
+#include "NetSocket.h"
+#include <stddef.h>
+
+// Two player network matches with input prediction and rollback. The host
+// plays the right paddle (the player), whoever joins the left one (the enemy).
+//
+// Both sides run the same deterministic simulation from the same inputs. A
+// tick whose remote input hasn't arrived yet runs with a prediction, the
+// peer's last direction. When the real input turns out different, the state
+// saved before that tick is restored and every tick since is simulated again.
+// Peers send each other the hash of their newest confirmed state, a mismatch
+// means the simulations went apart.
+//
+// Every packet carries all the inputs the peer hasn't acknowledged, so a lost
+// packet only costs time until the next one arrives.
+
+const int ROLLBACK_WINDOW = 16; // Saved states
+const int ROLLBACK_MAX_PREDICTION = 10; // Ticks ahead of the peer's input before waiting for it, below ROLLBACK_WINDOW
+const int NET_INPUT_HISTORY = 128; // Power of two
+const int NET_HASH_HISTORY = 64; // Power of two
+const int NET_DEFAULT_INPUT_DELAY = 2; // Ticks, hides some latency without rolling back
+const int NET_MAX_INPUT_DELAY = 8;
+const int NET_DEFAULT_PORT = 7777;
+const int NET_HELLO_INTERVAL_MS = 100;
+const int NET_RESEND_INTERVAL_MS = 16; // While waiting, packets are still sent this often
+
+// Returned by RollbackAdvance when the tick couldn't run
+const int ROLLBACK_STALLED = -1;
+
+typedef struct NetSetup
+{
+	const char* join = NULL; // "host:port" of the match to join, NULL to host one
+	uint16_t port = NET_DEFAULT_PORT; // Hosting
+	int inputDelay = NET_DEFAULT_INPUT_DELAY;
+	NetShim shim = {};
+} NetSetup;
+
+typedef struct RollbackStats
+{
+	int rollbacks;
+	long long rolledBackTicks;
+	int maxTicks; // Deepest rollback
+	long long totalNs;
+	long long maxNs; // Slowest rollback
+	int stalls; // Ticks spent waiting for the peer
+	int desyncTick; // First tick whose hashes differed, -1 none
+	int hashesChecked;
+} RollbackStats;
+
+typedef struct RollbackSession
+{
+	NetSocket socket;
+	NetAddress peer;
+	bool host;
+	bool connected;
+	int inputDelay;
+
+	// The match after tick - 1. saved[t % ROLLBACK_WINDOW] is the state before tick t.
+	SimState state;
+	int tick; // Next to simulate
+	SimState saved[ROLLBACK_WINDOW];
+
+	// Encoded inputs by tick % NET_INPUT_HISTORY
+	unsigned char localInputs[NET_INPUT_HISTORY];
+	unsigned char remoteInputs[NET_INPUT_HISTORY];
+	unsigned char usedRemote[NET_INPUT_HISTORY]; // Received or predicted, what the tick ran with
+	int localTick; // Newest local input
+	int remoteTick; // Newest remote input, every one before it arrived too
+	int peerAck; // Newest local input the peer has
+	int rollbackFrom; // Oldest tick that ran with a wrong prediction, tick when none
+
+	// Hashes of the confirmed states, by tick % NET_HASH_HISTORY
+	unsigned hashes[NET_HASH_HISTORY];
+	int hashedTick;
+	int peerHashTick; // Waiting for this side to confirm it, -1 none
+	unsigned peerHash;
+
+	long long lastSend;
+	RollbackStats stats;
+} RollbackSession;
+
+// Hosts or joins, config.enemyHuman is turned on. The peer connects later,
+// RollbackAdvance stalls until it does.
+bool RollbackOpen(RollbackSession& session, const SimConfig& config, const NetSetup& setup);
+void RollbackClose(RollbackSession& session);
+
+// Runs the next tick with this side's input, returns its events or
+// ROLLBACK_STALLED while the peer is missing or too far behind.
+int RollbackAdvance(RollbackSession& session, int direction, bool start);
+
+// Receives, rolls back and keeps the peer up to date without running a tick
+void RollbackPoll(RollbackSession& session);
+
+// Newest tick both sides have every input for
+int RollbackConfirmedTick(const RollbackSession& session);
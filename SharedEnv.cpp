@@ -0,0 +1,260 @@
+#include "SharedEnv.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ENV_PAUSE() _mm_pause()
+#else
+#define ENV_PAUSE() sched_yield()
+#endif
+
+static_assert(offsetof(EnvSharedHeader, request) == 64 && offsetof(EnvSharedHeader, response) == 128, "Trainers map the header by these offsets");
+
+static size_t AlignUp(size_t value)
+{
+	return (value + 63) & ~(size_t)63;
+}
+
+// Spinning only helps when the other side runs on another core meanwhile
+static int SpinCount()
+{
+	static const int spins = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? ENV_SPIN_COUNT : 0;
+	return spins;
+}
+
+// Returns once word is no longer seen
+static void WaitFor(std::atomic<uint32_t>& word, std::atomic<uint32_t>& sleeping, uint32_t seen)
+{
+	for (int i = 0; i < SpinCount(); i++)
+	{
+		if (word.load(std::memory_order_acquire) != seen)
+		{
+			return;
+		}
+		ENV_PAUSE();
+	}
+
+	// With both sides sequentially consistent, either the signal sees sleeping
+	// or this sees the new word before going to sleep
+	sleeping.store(1);
+	while (word.load() == seen)
+	{
+		syscall(SYS_futex, (uint32_t*)&word, FUTEX_WAIT, seen, NULL, NULL, 0);
+	}
+	sleeping.store(0, std::memory_order_relaxed);
+}
+
+static void Signal(std::atomic<uint32_t>& word, std::atomic<uint32_t>& sleeping)
+{
+	word.fetch_add(1);
+	if (sleeping.load())
+	{
+		syscall(SYS_futex, (uint32_t*)&word, FUTEX_WAKE, 1, NULL, NULL, 0);
+	}
+}
+
+static void PointArrays(EnvShared& shared)
+{
+	unsigned char* base = (unsigned char*)shared.header;
+	shared.actions = (int*)(base + shared.header->actionsOffset);
+	shared.observations = (float*)(base + shared.header->observationsOffset);
+	shared.rewards = (float*)(base + shared.header->rewardsOffset);
+	shared.dones = base + shared.header->donesOffset;
+}
+
+static void Unmap(EnvShared& shared)
+{
+	if (shared.header != NULL)
+	{
+		munmap(shared.header, shared.size);
+	}
+	memset(&shared, 0, sizeof(shared));
+}
+
+bool EnvServerOpen(EnvServer& server, const char* name, int count, const SimConfig& config)
+{
+	memset(&server.shared, 0, sizeof(server.shared));
+	snprintf(server.name, sizeof(server.name), "/%s", name);
+
+	size_t actions = AlignUp(sizeof(EnvSharedHeader));
+	size_t observations = actions + AlignUp(count * sizeof(int));
+	size_t rewards = observations + AlignUp(count * ENV_OBSERVATION_SIZE * sizeof(float));
+	size_t dones = rewards + AlignUp(count * sizeof(float));
+	size_t size = dones + AlignUp(count);
+
+	shm_unlink(server.name);
+	int fd = shm_open(server.name, O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd < 0 || ftruncate(fd, (off_t)size) != 0)
+	{
+		printf("Shared memory %s could not be created!\n", server.name);
+		if (fd >= 0)
+		{
+			close(fd);
+			shm_unlink(server.name);
+		}
+		return false;
+	}
+
+	void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED)
+	{
+		printf("Shared memory %s could not be mapped!\n", server.name);
+		shm_unlink(server.name);
+		return false;
+	}
+
+	// ftruncate zeroed it, atomics included
+	EnvSharedHeader* header = (EnvSharedHeader*)memory;
+	header->version = ENV_SHARED_VERSION;
+	header->count = count;
+	header->observationSize = ENV_OBSERVATION_SIZE;
+	header->actionsOffset = (uint32_t)actions;
+	header->observationsOffset = (uint32_t)observations;
+	header->rewardsOffset = (uint32_t)rewards;
+	header->donesOffset = (uint32_t)dones;
+	header->size = (uint32_t)size;
+
+	server.shared.header = header;
+	server.shared.size = size;
+	server.request = 0;
+	PointArrays(server.shared);
+
+	VecEnvInit(server.env, count, config);
+	VecEnvReset(server.env, 0, server.shared.observations);
+
+	// Last, a trainer attaching early sees no magic yet
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = ENV_SHARED_MAGIC;
+	return true;
+}
+
+void EnvServe(EnvServer& server)
+{
+	EnvShared& shared = server.shared;
+	EnvSharedHeader* header = shared.header;
+
+	// Counted from the open, a trainer may send before this starts
+	for (;;)
+	{
+		WaitFor(header->request, header->requestSleeping, server.request);
+		server.request++;
+
+		int command = header->command;
+		switch (command)
+		{
+		case ENV_COMMAND_RESET:
+			VecEnvReset(server.env, header->seed, shared.observations);
+			break;
+
+		case ENV_COMMAND_STEP:
+			VecEnvStep(server.env, shared.actions, shared.observations, shared.rewards, shared.dones);
+			break;
+
+		default:
+			break;
+		}
+
+		Signal(header->response, header->responseSleeping);
+		if (command == ENV_COMMAND_CLOSE)
+		{
+			return;
+		}
+	}
+}
+
+void EnvServerClose(EnvServer& server)
+{
+	if (server.shared.header == NULL)
+	{
+		return;
+	}
+
+	VecEnvFree(server.env);
+	Unmap(server.shared);
+	shm_unlink(server.name);
+}
+
+bool EnvClientOpen(EnvClient& client, const char* name)
+{
+	memset(&client.shared, 0, sizeof(client.shared));
+
+	char path[64];
+	snprintf(path, sizeof(path), "/%s", name);
+	int fd = shm_open(path, O_RDWR, 0);
+	struct stat info;
+	if (fd < 0 || fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(EnvSharedHeader))
+	{
+		printf("Shared memory %s could not be opened!\n", path);
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+		return false;
+	}
+
+	void* memory = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED)
+	{
+		printf("Shared memory %s could not be mapped!\n", path);
+		return false;
+	}
+
+	client.shared.header = (EnvSharedHeader*)memory;
+	client.shared.size = (size_t)info.st_size;
+
+	EnvSharedHeader* header = client.shared.header;
+	if (header->magic != ENV_SHARED_MAGIC || header->version != ENV_SHARED_VERSION || header->size != client.shared.size)
+	{
+		printf("%s is not a PingPong environment of version %u!\n", path, ENV_SHARED_VERSION);
+		Unmap(client.shared);
+		return false;
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	PointArrays(client.shared);
+	return true;
+}
+
+static void Send(EnvClient& client, int command)
+{
+	EnvSharedHeader* header = client.shared.header;
+	uint32_t seen = header->response.load();
+
+	header->command = command;
+	Signal(header->request, header->requestSleeping);
+
+	WaitFor(header->response, header->responseSleeping, seen);
+	std::atomic_thread_fence(std::memory_order_acquire);
+}
+
+void EnvClientReset(EnvClient& client, unsigned seed)
+{
+	client.shared.header->seed = seed;
+	Send(client, ENV_COMMAND_RESET);
+}
+
+void EnvClientStep(EnvClient& client)
+{
+	Send(client, ENV_COMMAND_STEP);
+}
+
+void EnvClientClose(EnvClient& client)
+{
+	if (client.shared.header == NULL)
+	{
+		return;
+	}
+
+	Send(client, ENV_COMMAND_CLOSE);
+	Unmap(client.shared);
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "VecEnv.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// VecEnv served to a trainer in another process through POSIX shared memory,
+// Linux only (futex). Actions, observations, rewards and done flags live in
+// the mapping itself: the server steps the matches straight out of and into
+// it, so nothing is copied or serialized on the way.
+//
+// The trainer writes a command, bumps request and waits for response to
+// move. Both sides spin briefly first and only sleep on the futex when the
+// other is slow, and only wake it when it is actually asleep, so while both
+// keep up a step costs no system call at all.
+//
+// Layout, for trainers in other languages: an EnvSharedHeader at offset 0 of
+// /dev/shm/NAME, then each array at the byte offset the header gives, 64 byte
+// aligned. actions are int32 directions, observations float32
+// [count][observationSize], rewards float32, dones uint8. The request and
+// response futex words are at bytes 64 and 128, each followed by its
+// sleeping flag.
+
+const uint32_t ENV_SHARED_MAGIC = 0x45505050; // "PPPE"
+const uint32_t ENV_SHARED_VERSION = 1;
+
+const int ENV_SPIN_COUNT = 4000; // Polls before sleeping, only with more than one core
+
+enum EnvCommand
+{
+	ENV_COMMAND_NONE,
+	ENV_COMMAND_RESET,
+	ENV_COMMAND_STEP,
+	ENV_COMMAND_CLOSE
+};
+
+typedef struct EnvSharedHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	int32_t count;
+	int32_t observationSize;
+	uint32_t actionsOffset;
+	uint32_t observationsOffset;
+	uint32_t rewardsOffset;
+	uint32_t donesOffset;
+	uint32_t size; // Of the whole mapping
+
+	// Written by the trainer before it bumps request
+	int32_t command;
+	uint32_t seed;
+
+	// Futex words, each side writes its own cache line
+	alignas(64) std::atomic<uint32_t> request;
+	std::atomic<uint32_t> requestSleeping; // The server waits in the futex
+	alignas(64) std::atomic<uint32_t> response;
+	std::atomic<uint32_t> responseSleeping; // The trainer waits in the futex
+} EnvSharedHeader;
+
+typedef struct EnvShared
+{
+	EnvSharedHeader* header;
+	size_t size;
+
+	int* actions;
+	float* observations;
+	float* rewards;
+	unsigned char* dones;
+} EnvShared;
+
+typedef struct EnvServer
+{
+	EnvShared shared;
+	VecEnv env;
+	char name[64];
+	uint32_t request; // Last one handled
+} EnvServer;
+
+typedef struct EnvClient
+{
+	EnvShared shared;
+} EnvClient;
+
+// Creates /dev/shm/NAME for count matches, replacing a stale one
+bool EnvServerOpen(EnvServer& server, const char* name, int count, const SimConfig& config);
+
+// Runs commands until the trainer sends ENV_COMMAND_CLOSE
+void EnvServe(EnvServer& server);
+
+// Unmaps and removes the name
+void EnvServerClose(EnvServer& server);
+
+// Trainer side. Write shared.actions before a step, read the rest after it.
+bool EnvClientOpen(EnvClient& client, const char* name);
+void EnvClientReset(EnvClient& client, unsigned seed);
+void EnvClientStep(EnvClient& client);
+
+// Stops the server and unmaps
+void EnvClientClose(EnvClient& client);
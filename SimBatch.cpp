@@ -0,0 +1,256 @@
+#include "SimBatchKernel.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if SIM_BATCH_X86
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace
+{
+	struct ScalarLanes
+	{
+		typedef int Pack;
+		static const int WIDTH = 1;
+
+		static Pack Load(const int* p) { return *p; }
+		static void Store(int* p, Pack a) { *p = a; }
+		static Pack Set(int v) { return v; }
+		static Pack Add(Pack a, Pack b) { return (int)((unsigned)a + (unsigned)b); }
+		static Pack Sub(Pack a, Pack b) { return (int)((unsigned)a - (unsigned)b); }
+		static Pack Mul(Pack a, Pack b) { return (int)((unsigned)a * (unsigned)b); }
+		static Pack And(Pack a, Pack b) { return a & b; }
+		static Pack Or(Pack a, Pack b) { return a | b; }
+		static Pack AndNot(Pack a, Pack b) { return ~a & b; }
+		static Pack CmpEq(Pack a, Pack b) { return a == b ? -1 : 0; }
+		static Pack CmpGt(Pack a, Pack b) { return a > b ? -1 : 0; }
+		static Pack Select(Pack mask, Pack a, Pack b) { return (mask & a) | (~mask & b); }
+		static Pack ShiftRight(Pack a) { return a >> SUBPIXEL_SHIFT; }
+		static Pack ShiftLeft(Pack a) { return (int)((unsigned)a << SUBPIXEL_SHIFT); }
+		static bool Any(Pack mask) { return mask != 0; }
+	};
+
+#if SIM_BATCH_X86
+	struct Sse2Lanes
+	{
+		typedef __m128i Pack;
+		static const int WIDTH = 4;
+
+		static Pack Load(const int* p) { return _mm_loadu_si128((const __m128i*)p); }
+		static void Store(int* p, Pack a) { _mm_storeu_si128((__m128i*)p, a); }
+		static Pack Set(int v) { return _mm_set1_epi32(v); }
+		static Pack Add(Pack a, Pack b) { return _mm_add_epi32(a, b); }
+		static Pack Sub(Pack a, Pack b) { return _mm_sub_epi32(a, b); }
+		static Pack Mul(Pack a, Pack b)
+		{
+			// SSE2 has no 32 bit low multiply, do even and odd lanes separately
+			__m128i even = _mm_mul_epu32(a, b);
+			__m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+			return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+		}
+		static Pack And(Pack a, Pack b) { return _mm_and_si128(a, b); }
+		static Pack Or(Pack a, Pack b) { return _mm_or_si128(a, b); }
+		static Pack AndNot(Pack a, Pack b) { return _mm_andnot_si128(a, b); }
+		static Pack CmpEq(Pack a, Pack b) { return _mm_cmpeq_epi32(a, b); }
+		static Pack CmpGt(Pack a, Pack b) { return _mm_cmpgt_epi32(a, b); }
+		static Pack Select(Pack mask, Pack a, Pack b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+		static Pack ShiftRight(Pack a) { return _mm_srai_epi32(a, SUBPIXEL_SHIFT); }
+		static Pack ShiftLeft(Pack a) { return _mm_slli_epi32(a, SUBPIXEL_SHIFT); }
+		static bool Any(Pack mask) { return _mm_movemask_epi8(mask) != 0; }
+	};
+#endif
+
+	const int LANE_ARRAYS = 23;
+
+	bool CpuHasAvx2()
+	{
+#if SIM_BATCH_X86 && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+		__cpuidex(info, 7, 0);
+		return osSavesYmm && (info[1] & (1 << 5));
+#elif SIM_BATCH_X86
+		return __builtin_cpu_supports("avx2");
+#else
+		return false;
+#endif
+	}
+}
+
+#if SIM_BATCH_X86
+// SimBatchAvx2.cpp, built with AVX2 enabled
+void SimBatchStepAvx2(SimBatch& batch);
+#endif
+
+void SimBatchInit(SimBatch& batch, int count, const SimConfig& config)
+{
+	batch.count = count;
+	batch.capacity = (count + SIM_BATCH_LANES - 1) / SIM_BATCH_LANES * SIM_BATCH_LANES;
+	batch.config = config;
+
+	batch.memory = (int*)calloc((size_t)batch.capacity * LANE_ARRAYS, sizeof(int));
+
+	int** arrays[LANE_ARRAYS] = {
+		&batch.ballX, &batch.ballY, &batch.ballVelocity, &batch.ballXDirection, &batch.ballYDirection,
+		&batch.playerY, &batch.playerYDirection, &batch.enemyY, &batch.enemyYDirection,
+		&batch.playerPoints, &batch.enemyPoints,
+		&batch.playedTicks, &batch.secondTicks, &batch.timeLeft,
+		&batch.enemyTargetY, &batch.enemyReaction, &batch.enemyRandom,
+		&batch.waitingToBegin, &batch.newRound, &batch.finished,
+		&batch.inputDirection, &batch.inputStart,
+		&batch.events
+	};
+	for (int i = 0; i < LANE_ARRAYS; i++)
+	{
+		*arrays[i] = batch.memory + (size_t)i * batch.capacity;
+	}
+
+	// Every match starts like SimInit, padding lanes are already over
+	SimState state;
+	SimInit(state, config);
+	for (int i = 0; i < batch.capacity; i++)
+	{
+		SimBatchSetState(batch, i, state);
+		batch.finished[i] = i < count ? 0 : -1;
+	}
+}
+
+void SimBatchFree(SimBatch& batch)
+{
+	free(batch.memory);
+	memset(&batch, 0, sizeof(batch));
+}
+
+SimKernel SimBatchBestKernel()
+{
+#if SIM_BATCH_X86
+	return CpuHasAvx2() ? SimKernel::AVX2 : SimKernel::SSE2;
+#else
+	return SimKernel::SCALAR;
+#endif
+}
+
+const char* SimKernelName(SimKernel kernel)
+{
+	switch (kernel)
+	{
+	case SimKernel::SCALAR:
+		return "scalar";
+	case SimKernel::SSE2:
+		return "sse2";
+	case SimKernel::AVX2:
+		return "avx2";
+	default:
+		return "auto";
+	}
+}
+
+void SimBatchStep(SimBatch& batch, SimKernel kernel)
+{
+	if (kernel == SimKernel::AUTO)
+	{
+		kernel = SimBatchBestKernel();
+	}
+
+	switch (kernel)
+	{
+#if SIM_BATCH_X86
+	case SimKernel::AVX2:
+		if (CpuHasAvx2())
+		{
+			SimBatchStepAvx2(batch);
+			break;
+		}
+		// Fall back to SSE2
+	case SimKernel::SSE2:
+		BatchStepLanes<Sse2Lanes>(batch, 0, batch.capacity);
+		break;
+#endif
+
+	default:
+		BatchStepLanes<ScalarLanes>(batch, 0, batch.capacity);
+		break;
+	}
+}
+
+void SimBatchAutopilot(SimBatch& batch)
+{
+	// Same decision as SimAutopilotInput, laid out so the compiler can vectorize it
+	const int playerVelocity = batch.config.playerVelocity;
+	for (int i = 0; i < batch.capacity; i++)
+	{
+		int paddleCenter = (batch.playerY[i] >> SUBPIXEL_SHIFT) + PADDLE_HEIGHT / 2;
+		int ballCenter = (batch.ballY[i] >> SUBPIXEL_SHIFT) + BALL_SIZE / 2;
+
+		int up = ballCenter < paddleCenter - playerVelocity;
+		int down = !up & (ballCenter > paddleCenter + playerVelocity);
+
+		batch.inputDirection[i] = down - up;
+		batch.inputStart[i] = batch.waitingToBegin[i] & 1;
+	}
+}
+
+void SimBatchGetState(const SimBatch& batch, int index, SimState& state)
+{
+	// Borders, sizes and paddle columns never change
+	SimInit(state, batch.config);
+
+	state.newRound = batch.newRound[index] != 0;
+	state.waitingToBegin = batch.waitingToBegin[index] != 0;
+	state.finished = batch.finished[index] != 0;
+
+	state.playerPoints = batch.playerPoints[index];
+	state.enemyPoints = batch.enemyPoints[index];
+	state.playedTicks = batch.playedTicks[index];
+	state.timeLeft = batch.timeLeft[index];
+	state.enemyTargetY = batch.enemyTargetY[index];
+	state.enemyReaction = batch.enemyReaction[index];
+	state.enemyRandom = (unsigned)batch.enemyRandom[index];
+
+	state.ball.x = batch.ballX[index];
+	state.ball.y = batch.ballY[index];
+	state.ball.rect.x = state.ball.x >> SUBPIXEL_SHIFT;
+	state.ball.rect.y = state.ball.y >> SUBPIXEL_SHIFT;
+	state.ball.velocity = batch.ballVelocity[index];
+	state.ball.xDirection = batch.ballXDirection[index];
+	state.ball.yDirection = batch.ballYDirection[index];
+
+	state.player.y = batch.playerY[index];
+	state.player.rect.y = state.player.y >> SUBPIXEL_SHIFT;
+	state.player.yDirection = batch.playerYDirection[index];
+
+	state.enemy.y = batch.enemyY[index];
+	state.enemy.rect.y = state.enemy.y >> SUBPIXEL_SHIFT;
+	state.enemy.yDirection = batch.enemyYDirection[index];
+}
+
+void SimBatchSetState(SimBatch& batch, int index, const SimState& state)
+{
+	batch.newRound[index] = state.newRound ? -1 : 0;
+	batch.waitingToBegin[index] = state.waitingToBegin ? -1 : 0;
+	batch.finished[index] = state.finished ? -1 : 0;
+
+	batch.playerPoints[index] = state.playerPoints;
+	batch.enemyPoints[index] = state.enemyPoints;
+	batch.playedTicks[index] = state.playedTicks;
+	batch.secondTicks[index] = state.playedTicks % SIM_TICKS_PER_SECOND;
+	batch.timeLeft[index] = state.config.matchDuration - state.playedTicks / SIM_TICKS_PER_SECOND;
+	batch.enemyTargetY[index] = state.enemyTargetY;
+	batch.enemyReaction[index] = state.enemyReaction;
+	batch.enemyRandom[index] = (int)state.enemyRandom;
+
+	batch.ballX[index] = state.ball.x;
+	batch.ballY[index] = state.ball.y;
+	batch.ballVelocity[index] = state.ball.velocity;
+	batch.ballXDirection[index] = state.ball.xDirection;
+	batch.ballYDirection[index] = state.ball.yDirection;
+
+	batch.playerY[index] = state.player.y;
+	batch.playerYDirection[index] = state.player.yDirection;
+	batch.enemyY[index] = state.enemy.y;
+	batch.enemyYDirection[index] = state.enemy.yDirection;
+}
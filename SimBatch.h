@@ -0,0 +1,79 @@
+#pragma once
+#include "Simulation.h"
+
+// Many matches stored as structure-of-arrays and stepped together with SIMD.
+// Every lane follows exactly the same rules as SimStep, all kernels give identical results.
+
+enum class SimKernel {
+	AUTO,
+	SCALAR,
+	SSE2,
+	AVX2
+};
+
+// Widest kernel lanes, the arrays are padded to a multiple of it
+const int SIM_BATCH_LANES = 8;
+
+typedef struct SimBatch
+{
+	int count; // Matches in use
+	int capacity; // Padded count, extra lanes stay finished
+
+	SimConfig config; // Shared by every match in the batch, the enemy is always the bot
+
+	// Ball
+	int* ballX; // Sub-pixel
+	int* ballY;
+	int* ballVelocity;
+	int* ballXDirection;
+	int* ballYDirection;
+
+	// Paddles, x never changes
+	int* playerY; // Sub-pixel
+	int* playerYDirection;
+	int* enemyY;
+	int* enemyYDirection;
+
+	// Score
+	int* playerPoints;
+	int* enemyPoints;
+
+	// Timer
+	int* playedTicks;
+	int* secondTicks; // playedTicks % SIM_TICKS_PER_SECOND, avoids a vector division
+	int* timeLeft;
+
+	// Enemy AI
+	int* enemyTargetY;
+	int* enemyReaction;
+	int* enemyRandom;
+
+	// Main conditions, 0 or -1 masks
+	int* waitingToBegin;
+	int* newRound;
+	int* finished;
+
+	// Input for the next step, the paddle always moves at SIM_FULL_SPEED
+	int* inputDirection;
+	int* inputStart; // 0 or 1
+
+	// SIM_EVENT flags of the last step
+	int* events;
+
+	int* memory;
+} SimBatch;
+
+void SimBatchInit(SimBatch& batch, int count, const SimConfig& config);
+void SimBatchFree(SimBatch& batch);
+
+void SimBatchStep(SimBatch& batch, SimKernel kernel = SimKernel::AUTO);
+
+// Fills the inputs with SimAutopilotInput for every match
+void SimBatchAutopilot(SimBatch& batch);
+
+// Conversion from and to the single match state
+void SimBatchGetState(const SimBatch& batch, int index, SimState& state);
+void SimBatchSetState(SimBatch& batch, int index, const SimState& state);
+
+SimKernel SimBatchBestKernel();
+const char* SimKernelName(SimKernel kernel);
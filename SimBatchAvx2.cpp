@@ -0,0 +1,36 @@
+// Built with AVX2 enabled (-mavx2, /arch:AVX2), only called after a CPU check
+#include "SimBatchKernel.h"
+
+#if SIM_BATCH_X86
+#include <immintrin.h>
+
+namespace
+{
+	struct Avx2Lanes
+	{
+		typedef __m256i Pack;
+		static const int WIDTH = 8;
+
+		static Pack Load(const int* p) { return _mm256_loadu_si256((const __m256i*)p); }
+		static void Store(int* p, Pack a) { _mm256_storeu_si256((__m256i*)p, a); }
+		static Pack Set(int v) { return _mm256_set1_epi32(v); }
+		static Pack Add(Pack a, Pack b) { return _mm256_add_epi32(a, b); }
+		static Pack Sub(Pack a, Pack b) { return _mm256_sub_epi32(a, b); }
+		static Pack Mul(Pack a, Pack b) { return _mm256_mullo_epi32(a, b); }
+		static Pack And(Pack a, Pack b) { return _mm256_and_si256(a, b); }
+		static Pack Or(Pack a, Pack b) { return _mm256_or_si256(a, b); }
+		static Pack AndNot(Pack a, Pack b) { return _mm256_andnot_si256(a, b); }
+		static Pack CmpEq(Pack a, Pack b) { return _mm256_cmpeq_epi32(a, b); }
+		static Pack CmpGt(Pack a, Pack b) { return _mm256_cmpgt_epi32(a, b); }
+		static Pack Select(Pack mask, Pack a, Pack b) { return _mm256_blendv_epi8(b, a, mask); }
+		static Pack ShiftRight(Pack a) { return _mm256_srai_epi32(a, SUBPIXEL_SHIFT); }
+		static Pack ShiftLeft(Pack a) { return _mm256_slli_epi32(a, SUBPIXEL_SHIFT); }
+		static bool Any(Pack mask) { return _mm256_movemask_epi8(mask) != 0; }
+	};
+}
+
+void SimBatchStepAvx2(SimBatch& batch)
+{
+	BatchStepLanes<Avx2Lanes>(batch, 0, batch.capacity);
+}
+#endif
@@ -0,0 +1,286 @@
+#pragma once
+#include "SimBatch.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIM_BATCH_X86 1
+#else
+#define SIM_BATCH_X86 0
+#endif
+
+// SimStep written once over a "lanes" type, instantiated for scalar, SSE2 and AVX2.
+// Lanes provides: Pack, WIDTH, Load, Store, Set, Add, Sub, Mul, And, Or, AndNot(a, b) = ~a & b,
+// CmpEq, CmpGt, Select(mask, a, b), ShiftRight (arithmetic) and ShiftLeft by SUBPIXEL_SHIFT,
+// and Any(mask) to leave loops early.
+// Masks are 0 or -1 in every lane. Only included by the SimBatch translation units.
+
+template <typename L>
+static typename L::Pack BatchCollision(
+	typename L::Pack ax, typename L::Pack ay, int aw, int ah,
+	typename L::Pack bx, typename L::Pack by, int bw, int bh)
+{
+	// Same test as CheckCollision, written as "every side overlaps"
+	typename L::Pack hit = L::CmpGt(L::Add(ay, L::Set(ah)), by);
+	hit = L::And(hit, L::CmpGt(L::Add(by, L::Set(bh)), ay));
+	hit = L::And(hit, L::CmpGt(L::Add(ax, L::Set(aw)), bx));
+	hit = L::And(hit, L::CmpGt(L::Add(bx, L::Set(bw)), ax));
+	return hit;
+}
+
+// Arena layout, the same SimInit builds
+const int BATCH_ENEMY_FACE = (ARENA_PADDING + PADDLE_WIDTH) << SUBPIXEL_SHIFT;
+const int BATCH_BALL_TOP = ARENA_PADDING << SUBPIXEL_SHIFT;
+const int BATCH_BALL_SPAN = ((ARENA_HEIGHT - ARENA_PADDING - BALL_SIZE) << SUBPIXEL_SHIFT) - BATCH_BALL_TOP;
+
+// PredictBallY folds with loops, here one step each way is enough
+static_assert(ARENA_WIDTH << SUBPIXEL_SHIFT < 2 * BATCH_BALL_SPAN, "The ball can bounce off TOP and BOTTOM twice on the way to the enemy");
+
+// EnemyRethink, for the lanes in mask
+template <typename L>
+static void BatchEnemyRethink(const SimConfig& config, typename L::Pack mask,
+	typename L::Pack ballX, typename L::Pack ballY, typename L::Pack ballXDirection, typename L::Pack ballYDirection,
+	typename L::Pack& enemyTargetY, typename L::Pack& enemyReaction, typename L::Pack& enemyRandom)
+{
+	typedef typename L::Pack P;
+	const P zero = L::Set(0);
+	const P span = L::Set(BATCH_BALL_SPAN);
+	const P twoSpans = L::Set(2 * BATCH_BALL_SPAN);
+
+	P distance = L::Sub(ballX, L::Set(BATCH_ENEMY_FACE));
+	distance = L::And(L::CmpGt(distance, zero), distance);
+
+	P y = L::Sub(L::Add(ballY, L::Mul(ballYDirection, distance)), L::Set(BATCH_BALL_TOP));
+	y = L::Add(y, L::And(L::CmpGt(zero, y), twoSpans));
+	y = L::Sub(y, L::AndNot(L::CmpGt(twoSpans, y), twoSpans));
+	y = L::Select(L::CmpGt(y, span), L::Sub(twoSpans, y), y);
+	P landing = L::Add(L::ShiftRight(L::Add(y, L::Set(BATCH_BALL_TOP))), L::Set(BALL_SIZE / 2));
+
+	// Two sub-pixel shifts make the 16 the generator needs, both on values
+	// that are masked or positive
+	P random = L::Add(L::Mul(enemyRandom, L::Set(1664525)), L::Set(1013904223));
+	P bits = L::And(L::ShiftRight(L::ShiftRight(random)), L::Set(0xFFFF));
+	P error = L::ShiftRight(L::ShiftRight(L::Mul(bits, L::Set(2 * config.aimError + 1))));
+	error = L::Sub(error, L::Set(config.aimError));
+
+	P target = L::Select(L::CmpGt(zero, ballXDirection), L::Add(landing, error), L::Set(ARENA_HEIGHT / 2));
+	enemyTargetY = L::Select(mask, target, enemyTargetY);
+	enemyReaction = L::Select(mask, L::Set(config.reactionDelay), enemyReaction);
+	enemyRandom = L::Select(mask, random, enemyRandom);
+}
+
+template <typename L>
+static void BatchStepLanes(SimBatch& b, int first, int last)
+{
+	typedef typename L::Pack P;
+	const SimConfig& config = b.config;
+
+	// Arena layout, the same SimInit builds
+	const int playerX = ARENA_WIDTH - PADDLE_WIDTH - ARENA_PADDING;
+	const int enemyX = ARENA_PADDING;
+	const int topY = 0, topH = ARENA_PADDING;
+	const int rightX = ARENA_WIDTH - ARENA_PADDING;
+	const int bottomY = ARENA_HEIGHT - ARENA_PADDING, bottomH = ARENA_HEIGHT;
+	const int leftX = 0, leftW = ARENA_PADDING;
+
+	const P zero = L::Set(0);
+	const P one = L::Set(1);
+	const P allOnes = L::Set(-1);
+
+	for (int i = first; i < last; i += L::WIDTH)
+	{
+		P ballX = L::Load(b.ballX + i);
+		P ballY = L::Load(b.ballY + i);
+		P ballVelocity = L::Load(b.ballVelocity + i);
+		P ballXDirection = L::Load(b.ballXDirection + i);
+		P ballYDirection = L::Load(b.ballYDirection + i);
+		P playerY = L::Load(b.playerY + i);
+		P playerYDirection = L::Load(b.playerYDirection + i);
+		P enemyY = L::Load(b.enemyY + i);
+		P enemyYDirection = L::Load(b.enemyYDirection + i);
+		P playerPoints = L::Load(b.playerPoints + i);
+		P enemyPoints = L::Load(b.enemyPoints + i);
+		P playedTicks = L::Load(b.playedTicks + i);
+		P secondTicks = L::Load(b.secondTicks + i);
+		P timeLeft = L::Load(b.timeLeft + i);
+		P enemyTargetY = L::Load(b.enemyTargetY + i);
+		P enemyReaction = L::Load(b.enemyReaction + i);
+		P enemyRandom = L::Load(b.enemyRandom + i);
+		P waitingToBegin = L::Load(b.waitingToBegin + i);
+		P newRound = L::Load(b.newRound + i);
+		P finished = L::Load(b.finished + i);
+		P start = L::CmpGt(L::Load(b.inputStart + i), zero);
+
+		P events = L::And(finished, L::Set(SIM_EVENT_MATCH_OVER));
+		P live = L::AndNot(finished, allOnes);
+
+		// New round
+		P reset = L::And(newRound, live);
+		ballVelocity = L::Select(reset, L::Set(config.intialBallVelocity), ballVelocity);
+		ballXDirection = L::Select(reset, L::Set(DIRECTION_RIGHT), ballXDirection);
+		ballYDirection = L::Select(reset, L::Set(DIRECTION_UP), ballYDirection);
+		playerYDirection = L::Select(reset, zero, playerYDirection);
+		enemyYDirection = L::Select(reset, zero, enemyYDirection);
+		ballX = L::Select(reset, L::Set(((ARENA_WIDTH - BALL_SIZE) / 2) << SUBPIXEL_SHIFT), ballX);
+		ballY = L::Select(reset, L::Set(((ARENA_HEIGHT - BALL_SIZE) / 2) << SUBPIXEL_SHIFT), ballY);
+		playerY = L::Select(reset, L::Set(((ARENA_HEIGHT - PADDLE_HEIGHT) / 2) << SUBPIXEL_SHIFT), playerY);
+		enemyY = L::Select(reset, L::Set(((ARENA_HEIGHT - PADDLE_HEIGHT) / 2) << SUBPIXEL_SHIFT), enemyY);
+		BatchEnemyRethink<L>(config, reset, ballX, ballY, ballXDirection, ballYDirection, enemyTargetY, enemyReaction, enemyRandom);
+		waitingToBegin = L::Or(waitingToBegin, reset);
+		newRound = L::AndNot(reset, newRound);
+		events = L::Or(events, L::And(reset, L::Set(SIM_EVENT_ROUND_RESET)));
+
+		// Waiting for ENTER
+		P waiting = L::And(waitingToBegin, live);
+		P started = L::And(waiting, start);
+		live = L::AndNot(L::AndNot(start, waiting), live);
+		waitingToBegin = L::AndNot(started, waitingToBegin);
+		events = L::Or(events, L::And(started, L::Set(SIM_EVENT_ROUND_STARTED)));
+
+		// Timer
+		playedTicks = L::Add(playedTicks, L::And(live, one));
+		secondTicks = L::Add(secondTicks, L::And(live, one));
+		P secondDone = L::CmpEq(secondTicks, L::Set(SIM_TICKS_PER_SECOND));
+		secondTicks = L::AndNot(secondDone, secondTicks);
+		timeLeft = L::Sub(timeLeft, L::And(secondDone, one));
+
+		P over = L::And(live, L::CmpGt(one, timeLeft));
+		finished = L::Or(finished, over);
+		events = L::Or(events, L::And(over, L::Set(SIM_EVENT_MATCH_OVER)));
+		live = L::AndNot(over, live);
+
+		// Move Paddles
+		playerYDirection = L::Select(live, L::Load(b.inputDirection + i), playerYDirection);
+
+		// Enemy AI, see EnemyMovement
+		P reacting = L::And(live, L::CmpGt(enemyReaction, zero));
+		enemyReaction = L::Sub(enemyReaction, L::And(reacting, one));
+
+		P enemyCenter = L::Add(L::ShiftRight(enemyY), L::Set(PADDLE_HEIGHT / 2));
+		P enemyUp = L::CmpGt(L::Sub(enemyCenter, L::Set(config.enemyVelocity)), enemyTargetY);
+		P enemyDown = L::AndNot(enemyUp, L::CmpGt(enemyTargetY, L::Add(enemyCenter, L::Set(config.enemyVelocity))));
+		P steer = L::AndNot(reacting, live);
+		enemyYDirection = L::Select(steer, L::Sub(L::And(enemyDown, one), L::And(enemyUp, one)), enemyYDirection);
+
+		playerY = L::Add(playerY, L::And(live, L::ShiftLeft(L::Mul(L::Set(config.playerVelocity), playerYDirection))));
+		enemyY = L::Add(enemyY, L::And(live, L::ShiftLeft(L::Mul(L::Set(config.enemyVelocity), enemyYDirection))));
+
+		P playerRectY = L::ShiftRight(playerY);
+		P enemyRectY = L::ShiftRight(enemyY);
+
+		// Player Paddle and Borders
+		P hit = L::And(live, BatchCollision<L>(L::Set(playerX), playerRectY, PADDLE_WIDTH, PADDLE_HEIGHT, zero, L::Set(topY), ARENA_WIDTH, topH));
+		playerYDirection = L::AndNot(hit, playerYDirection);
+		playerRectY = L::Select(hit, L::Set(topH), playerRectY);
+		playerY = L::Select(hit, L::ShiftLeft(playerRectY), playerY);
+
+		hit = L::And(live, BatchCollision<L>(L::Set(playerX), playerRectY, PADDLE_WIDTH, PADDLE_HEIGHT, zero, L::Set(bottomY), ARENA_WIDTH, bottomH));
+		playerYDirection = L::AndNot(hit, playerYDirection);
+		playerRectY = L::Select(hit, L::Set(bottomY - PADDLE_HEIGHT), playerRectY);
+		playerY = L::Select(hit, L::ShiftLeft(playerRectY), playerY);
+
+		// enemy Paddle and Borders
+		hit = L::And(live, BatchCollision<L>(L::Set(enemyX), enemyRectY, PADDLE_WIDTH, PADDLE_HEIGHT, zero, L::Set(topY), ARENA_WIDTH, topH));
+		enemyYDirection = L::AndNot(hit, enemyYDirection);
+		enemyRectY = L::Select(hit, L::Set(topH), enemyRectY);
+		enemyY = L::Select(hit, L::ShiftLeft(enemyRectY), enemyY);
+
+		hit = L::And(live, BatchCollision<L>(L::Set(enemyX), enemyRectY, PADDLE_WIDTH, PADDLE_HEIGHT, zero, L::Set(bottomY), ARENA_WIDTH, bottomH));
+		enemyYDirection = L::AndNot(hit, enemyYDirection);
+		enemyRectY = L::Select(hit, L::Set(bottomY - PADDLE_HEIGHT), enemyRectY);
+		enemyY = L::Select(hit, L::ShiftLeft(enemyRectY), enemyY);
+
+		// Sweep the ball, see SweepBall
+		const P size = L::Set(BALL_SIZE << SUBPIXEL_SHIFT);
+		P remaining = L::And(live, L::ShiftLeft(ballVelocity));
+
+		for (int bounce = 0; bounce < SIM_MAX_BOUNCES; bounce++)
+		{
+			P active = L::CmpGt(remaining, zero);
+			if (!L::Any(active))
+			{
+				break;
+			}
+
+			P up = L::CmpGt(zero, ballYDirection);
+			P right = L::CmpGt(ballXDirection, zero);
+
+			// Top or bottom border
+			P distanceY = L::Select(up,
+				L::Sub(ballY, L::Set((topY + topH) << SUBPIXEL_SHIFT)),
+				L::Sub(L::Set(bottomY << SUBPIXEL_SHIFT), L::Add(ballY, size)));
+
+			// Paddle face, then the border behind it
+			P paddleY = L::Select(right, playerY, enemyY);
+			P distancePaddle = L::Select(right,
+				L::Sub(L::Set(playerX << SUBPIXEL_SHIFT), L::Add(ballX, size)),
+				L::Sub(ballX, L::Set((enemyX + PADDLE_WIDTH) << SUBPIXEL_SHIFT)));
+			P distanceGoal = L::Select(right,
+				L::Sub(L::Set(rightX << SUBPIXEL_SHIFT), L::Add(ballX, size)),
+				L::Sub(ballX, L::Set((leftX + leftW) << SUBPIXEL_SHIFT)));
+
+			P yAtPaddle = L::Add(ballY, L::Mul(ballYDirection, distancePaddle));
+			P paddleHit = L::CmpGt(distancePaddle, allOnes);
+			paddleHit = L::AndNot(L::CmpGt(distancePaddle, distanceY), paddleHit);
+			paddleHit = L::And(paddleHit, L::CmpGt(L::Add(paddleY, L::Set(PADDLE_HEIGHT << SUBPIXEL_SHIFT)), yAtPaddle));
+			paddleHit = L::And(paddleHit, L::CmpGt(L::Add(yAtPaddle, size), paddleY));
+
+			P distanceX = L::Select(paddleHit, distancePaddle, distanceGoal);
+			distanceX = L::And(L::CmpGt(distanceX, zero), distanceX);
+			distanceY = L::And(L::CmpGt(distanceY, zero), distanceY);
+
+			P step = L::Select(L::CmpGt(distanceX, distanceY), distanceY, distanceX);
+			step = L::Select(L::CmpGt(step, remaining), remaining, step);
+			step = L::And(active, step);
+
+			ballX = L::Add(ballX, L::Mul(ballXDirection, step));
+			ballY = L::Add(ballY, L::Mul(ballYDirection, step));
+			remaining = L::Sub(remaining, step);
+
+			P hitY = L::And(active, L::CmpEq(distanceY, step));
+			ballYDirection = L::Select(hitY, L::Sub(zero, ballYDirection), ballYDirection);
+			events = L::Or(events, L::And(hitY, L::Set(SIM_EVENT_BOUNCE)));
+
+			P hitX = L::And(active, L::CmpEq(distanceX, step));
+			P paddleBounce = L::And(hitX, paddleHit);
+			P goal = L::AndNot(paddleHit, hitX);
+			ballXDirection = L::Select(hitX, L::Sub(zero, ballXDirection), ballXDirection);
+			ballVelocity = L::Add(ballVelocity, L::And(paddleBounce, one));
+			events = L::Or(events, L::And(paddleBounce, L::Set(SIM_EVENT_BOUNCE | SIM_EVENT_PADDLE_HIT)));
+
+			// Scored
+			P enemyScored = L::And(goal, right);
+			P playerScored = L::AndNot(right, goal);
+			enemyPoints = L::Add(enemyPoints, L::And(enemyScored, one));
+			playerPoints = L::Add(playerPoints, L::And(playerScored, one));
+			events = L::Or(events, L::And(enemyScored, L::Set(SIM_EVENT_BOUNCE | SIM_EVENT_ENEMY_SCORED)));
+			events = L::Or(events, L::And(playerScored, L::Set(SIM_EVENT_BOUNCE | SIM_EVENT_PLAYER_SCORED)));
+			newRound = L::Or(newRound, goal);
+			remaining = L::AndNot(goal, remaining);
+		}
+
+		// A paddle sent the ball back, wall bounces are already in the plan
+		P returned = L::CmpGt(L::And(events, L::Set(SIM_EVENT_PADDLE_HIT)), zero);
+		BatchEnemyRethink<L>(config, returned, ballX, ballY, ballXDirection, ballYDirection, enemyTargetY, enemyReaction, enemyRandom);
+
+		L::Store(b.ballX + i, ballX);
+		L::Store(b.ballY + i, ballY);
+		L::Store(b.ballVelocity + i, ballVelocity);
+		L::Store(b.ballXDirection + i, ballXDirection);
+		L::Store(b.ballYDirection + i, ballYDirection);
+		L::Store(b.playerY + i, playerY);
+		L::Store(b.playerYDirection + i, playerYDirection);
+		L::Store(b.enemyY + i, enemyY);
+		L::Store(b.enemyYDirection + i, enemyYDirection);
+		L::Store(b.playerPoints + i, playerPoints);
+		L::Store(b.enemyPoints + i, enemyPoints);
+		L::Store(b.playedTicks + i, playedTicks);
+		L::Store(b.secondTicks + i, secondTicks);
+		L::Store(b.timeLeft + i, timeLeft);
+		L::Store(b.enemyTargetY + i, enemyTargetY);
+		L::Store(b.enemyReaction + i, enemyReaction);
+		L::Store(b.enemyRandom + i, enemyRandom);
+		L::Store(b.waitingToBegin + i, waitingToBegin);
+		L::Store(b.newRound + i, newRound);
+		L::Store(b.finished + i, finished);
+		L::Store(b.events + i, events);
+	}
+}
@@ -0,0 +1,336 @@
+#include "Simulation.h"
+#include "SimBatch.h"
+#include "Replay.h"
+#include "AllocCounter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+
+// Rule checks that the tools can't see from their totals, run by `make check`.
+// Each test prints what went wrong and returns false.
+
+const int TEST_MATCHES = 16;
+
+// Varied but reproducible matches, so the bounces happen everywhere
+SimConfig TestConfig(int index)
+{
+	SimConfig config = SimDefaultConfig();
+	config.intialBallVelocity += index % 3;
+	config.enemyVelocity += index % 4;
+	config.reactionDelay = (index * 7) % 20;
+	config.aimError = (index * 13) % 40;
+	config.matchDuration = 30;
+	return config;
+}
+
+// TOP and BOTTOM bounces are already in the enemy's plan, only paddle hits
+// and round resets should draw a new one
+bool TestWallBounceKeepsPlan()
+{
+	int wallBounces = 0;
+
+	for (int i = 0; i < TEST_MATCHES; i++)
+	{
+		SimState state;
+		SimInit(state, TestConfig(i));
+
+		while (!state.finished)
+		{
+			SimState before = state;
+			int events = SimStep(state, SimAutopilotInput(state));
+
+			if (!(events & SIM_EVENT_BOUNCE) || (events & (SIM_EVENT_PADDLE_HIT | SIM_EVENT_ROUND_RESET)))
+			{
+				continue;
+			}
+			if (events & (SIM_EVENT_PLAYER_SCORED | SIM_EVENT_ENEMY_SCORED))
+			{
+				continue;
+			}
+
+			// Only EnemyMovement's countdown may have changed
+			int reaction = before.enemyReaction > 0 ? before.enemyReaction - 1 : 0;
+			if (state.enemyTargetY != before.enemyTargetY || state.enemyReaction != reaction || state.enemyRandom != before.enemyRandom)
+			{
+				printf("Match %d tick %d: a wall bounce changed the enemy plan, target %d -> %d, reaction %d -> %d\n",
+					i, state.playedTicks, before.enemyTargetY, state.enemyTargetY, before.enemyReaction, state.enemyReaction);
+				return false;
+			}
+			wallBounces++;
+		}
+	}
+
+	if (wallBounces == 0)
+	{
+		printf("No wall bounce happened\n");
+		return false;
+	}
+
+	return true;
+}
+
+// Deterministic, the same run every time
+unsigned testRandom = 12345;
+
+int TestRandom(int first, int last)
+{
+	testRandom = testRandom * 1664525u + 1013904223u;
+	return first + (int)((testRandom >> 8) % (unsigned)(last - first + 1));
+}
+
+// Lanes with varied states and random input, each kernel against SimStep
+// tick by tick. An odd count keeps some padding lanes in the last pack.
+const int EQUIVALENCE_LANES = 61;
+const int EQUIVALENCE_TICKS = 3000;
+
+bool TestKernelsMatchSimStep()
+{
+	const SimKernel kernels[] = { SimKernel::SCALAR, SimKernel::SSE2, SimKernel::AVX2 };
+
+	for (int c = 0; c < 3; c++)
+	{
+		SimConfig config = TestConfig(c * 5 + 1);
+
+		// Seeds: a random point of a match played with random input, a
+		// quarter with a faster ball than a match would reach
+		SimState seeds[EQUIVALENCE_LANES];
+		for (int i = 0; i < EQUIVALENCE_LANES; i++)
+		{
+			SimState& state = seeds[i];
+			SimInit(state, config);
+			state.enemyRandom = (unsigned)TestRandom(0, 1 << 30);
+
+			int ticks = TestRandom(0, config.matchDuration * SIM_TICKS_PER_SECOND);
+			for (int t = 0; t < ticks && !state.finished; t++)
+			{
+				SimInput input = SimAutopilotInput(state);
+				input.playerDirection = TestRandom(0, 3) == 0 ? TestRandom(-1, 1) : input.playerDirection;
+				SimStep(state, input);
+			}
+			if (i % 4 == 1)
+			{
+				state.ball.velocity += TestRandom(1, 12);
+			}
+		}
+
+		for (SimKernel kernel : kernels)
+		{
+			SimBatch batch;
+			SimBatchInit(batch, EQUIVALENCE_LANES, config);
+
+			SimState reference[EQUIVALENCE_LANES];
+			int events[EQUIVALENCE_LANES];
+			for (int i = 0; i < EQUIVALENCE_LANES; i++)
+			{
+				reference[i] = seeds[i];
+				SimBatchSetState(batch, i, reference[i]);
+			}
+
+			for (int tick = 0; tick < EQUIVALENCE_TICKS; tick++)
+			{
+				for (int i = 0; i < EQUIVALENCE_LANES; i++)
+				{
+					SimInput input = SimAutopilotInput(reference[i]);
+					input.playerDirection = TestRandom(0, 2) == 0 ? TestRandom(-1, 1) : input.playerDirection;
+					input.start = TestRandom(0, 20) == 0;
+					batch.inputDirection[i] = input.playerDirection;
+					batch.inputStart[i] = input.start ? 1 : 0;
+
+					events[i] = SimStep(reference[i], input);
+				}
+
+				SimBatchStep(batch, kernel);
+
+				for (int i = 0; i < EQUIVALENCE_LANES; i++)
+				{
+					SimState state;
+					SimBatchGetState(batch, i, state);
+					if (SimHash(state) != SimHash(reference[i]) || batch.events[i] != events[i])
+					{
+						printf("%s, config %d, lane %d, tick %d: %08x events %x, SimStep %08x events %x\n",
+							SimKernelName(kernel), c, i, tick, SimHash(state), batch.events[i], SimHash(reference[i]), events[i]);
+						SimBatchFree(batch);
+						return false;
+					}
+				}
+			}
+
+			SimBatchFree(batch);
+		}
+	}
+
+	return true;
+}
+
+// A player waiting long before the first round, recorded past the last
+// keyframe the recorder has room for: no step may allocate, and the replay
+// still plays back and seeks to the same states
+const char* TEST_REPLAY_PATH = "pingpong_test.ppr";
+const int TEST_REPLAY_WAIT = (REPLAY_MAX_KEYFRAMES + 10) * REPLAY_KEYFRAME_INTERVAL;
+
+bool TestLongReplayNeverAllocates()
+{
+	SimState state;
+	SimInit(state, SimDefaultConfig());
+
+	ReplayRecorder recorder;
+	if (!ReplayBeginRecording(recorder, TEST_REPLAY_PATH, state))
+	{
+		return false;
+	}
+
+	// Past the last keyframe, seeking has to fast-forward to it
+	const int seekTick = TEST_REPLAY_WAIT + REPLAY_KEYFRAME_INTERVAL / 2;
+	SimState seekState = state;
+
+	long long allocations = AllocationCount();
+	int tick = 0;
+	while (!state.finished)
+	{
+		SimInput input = SimAutopilotInput(state);
+		input.start = input.start && tick >= TEST_REPLAY_WAIT;
+		ReplayRecordStep(recorder, state, input);
+		SimStep(state, input);
+		tick++;
+
+		if (tick == seekTick)
+		{
+			seekState = state;
+		}
+	}
+	allocations = AllocationCount() - allocations;
+
+	if (!ReplayEndRecording(recorder, state))
+	{
+		printf("The replay could not be written\n");
+		return false;
+	}
+	if (allocations != 0)
+	{
+		printf("Recording %d ticks allocated %lld times\n", tick, allocations);
+		remove(TEST_REPLAY_PATH);
+		return false;
+	}
+
+	ReplayPlayer player;
+	bool ok = ReplayOpen(player, TEST_REPLAY_PATH);
+	if (ok)
+	{
+		while (!ReplayFinished(player))
+		{
+			ReplayStep(player);
+		}
+		ok = SimHash(player.state) == SimHash(state);
+
+		ReplaySeek(player, seekTick);
+		ok = ok && SimHash(player.state) == SimHash(seekState);
+		if (!ok)
+		{
+			printf("The replay of %d ticks doesn't play back the recorded match\n", tick);
+		}
+		ReplayClose(player);
+	}
+
+	remove(TEST_REPLAY_PATH);
+	return ok;
+}
+
+// Records a short match, then damages it with change and checks ReplayOpen refuses it
+bool ReplayRejected(void (*change)(FILE* file, const ReplayHeader& header))
+{
+	SimState state;
+	SimInit(state, SimDefaultConfig());
+	state.config.matchDuration = 20;
+
+	ReplayRecorder recorder;
+	if (!ReplayBeginRecording(recorder, TEST_REPLAY_PATH, state))
+	{
+		return false;
+	}
+	while (!state.finished)
+	{
+		SimInput input = SimAutopilotInput(state);
+		ReplayRecordStep(recorder, state, input);
+		SimStep(state, input);
+	}
+	ReplayEndRecording(recorder, state);
+
+	FILE* file = fopen(TEST_REPLAY_PATH, "r+b");
+	ReplayHeader header;
+	bool ok = file != NULL && fread(&header, sizeof(header), 1, file) == 1;
+	if (ok)
+	{
+		change(file, header);
+		fclose(file);
+
+		ReplayPlayer player;
+		ok = !ReplayOpen(player, TEST_REPLAY_PATH);
+		if (!ok)
+		{
+			ReplayClose(player);
+		}
+	}
+
+	remove(TEST_REPLAY_PATH);
+	return ok;
+}
+
+void BreakKeyframeOffset(FILE* file, const ReplayHeader& header)
+{
+	long long inputOffset = header.inputSize + 1;
+	fseek(file, (long)(header.keyframeOffset + offsetof(ReplayKeyframe, inputOffset)), SEEK_SET);
+	fwrite(&inputOffset, sizeof(inputOffset), 1, file);
+}
+
+void BreakInputVarints(FILE* file, const ReplayHeader& header)
+{
+	// Every byte says another one follows
+	fseek(file, (long)sizeof(ReplayHeader), SEEK_SET);
+	for (long long i = 0; i < header.inputSize; i++)
+	{
+		fputc(0xFF, file);
+	}
+}
+
+bool TestDamagedReplayRejected()
+{
+	if (!ReplayRejected(BreakKeyframeOffset))
+	{
+		printf("A keyframe pointing past the input stream was accepted\n");
+		return false;
+	}
+	if (!ReplayRejected(BreakInputVarints))
+	{
+		printf("An input stream ending inside a varint was accepted\n");
+		return false;
+	}
+	return true;
+}
+
+typedef struct SimTest
+{
+	const char* name;
+	bool (*run)();
+} SimTest;
+
+SimTest tests[] = {
+	{ "WallBounceKeepsPlan", TestWallBounceKeepsPlan },
+	{ "KernelsMatchSimStep", TestKernelsMatchSimStep },
+	{ "LongReplayNeverAllocates", TestLongReplayNeverAllocates },
+	{ "DamagedReplayRejected", TestDamagedReplayRejected },
+};
+
+// Usage: pingpong_test
+int main(int argc, char* args[])
+{
+	int failed = 0;
+
+	for (const SimTest& test : tests)
+	{
+		bool ok = test.run();
+		printf("%-26s %s\n", test.name, ok ? "OK" : "FAILED");
+		failed += !ok;
+	}
+
+	return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,370 @@
+#include "SimThread.h"
+#include "Profiler.h"
+#include "Replay.h"
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+const long long SIM_TICK_NS = 1000000000LL / SIM_TICKS_PER_SECOND;
+
+// Sleeps shorter than this wake too late on some schedulers, they yield instead
+const long long SIM_SPIN_NS = 2000000;
+
+enum SimCommandType
+{
+	SIM_COMMAND_SPEED,
+	SIM_COMMAND_START
+};
+
+typedef struct SimCommand
+{
+	int type;
+	int speed; // Signed, up is negative
+	long long time;
+} SimCommand;
+
+// Single producer, single consumer: the game thread pushes, the sim thread pops
+static SimCommand commandQueue[SIM_INPUT_QUEUE_SIZE];
+static std::atomic<unsigned> commandRead(0);
+static std::atomic<unsigned> commandWrite(0);
+
+// Triple buffer. The sim thread owns back, the game thread owns front, and
+// they swap their slot with middle. FRESH marks a middle not read yet.
+const int SNAPSHOT_INDEX = 3;
+const int SNAPSHOT_FRESH = 4;
+
+static SimSnapshot snapshots[3];
+static std::atomic<int> snapshotMiddle(1);
+static int snapshotBack = 2;
+static int snapshotFront = 0;
+
+static std::thread simThread;
+static std::atomic<bool> simRunning(false);
+
+// Owned by the sim thread while it runs
+static SimState simState;
+static SimInput simInput;
+static ReplayRecorder simReplay;
+static RollbackSession* simNetwork = NULL;
+static SpectatorViewer* simSpectator = NULL;
+static SpectatorPublisher* simBroadcast = NULL;
+static int simTick = 0;
+static int simBounces = 0;
+static int simSpeed = 0; // What the player holds right now, signed
+static long long simInputTime = 0;
+
+static void PushCommand(int type, int speed, long long time)
+{
+	unsigned write = commandWrite.load(std::memory_order_relaxed);
+	if (write - commandRead.load(std::memory_order_acquire) == SIM_INPUT_QUEUE_SIZE)
+	{
+		// A full queue within a tick, drop the newest
+		return;
+	}
+
+	// Ticks wait for what is due before their end, a timestamp from a clock
+	// running slightly ahead must not hold a command back
+	long long now = ProfileNow();
+	if (time <= 0 || time > now)
+	{
+		time = now;
+	}
+
+	commandQueue[write & (SIM_INPUT_QUEUE_SIZE - 1)] = { type, speed, time };
+	commandWrite.store(write + 1, std::memory_order_release);
+}
+
+// Input of the tick running from tickStart to tickEnd. Commands after its
+// end stay queued for the next one.
+static void ApplyCommands(long long tickStart, long long tickEnd)
+{
+	unsigned read = commandRead.load(std::memory_order_relaxed);
+	unsigned write = commandWrite.load(std::memory_order_acquire);
+
+	// Speed times nanoseconds it was held
+	long long moved = 0;
+	long long from = tickStart;
+
+	for (; read != write; read++)
+	{
+		const SimCommand& command = commandQueue[read & (SIM_INPUT_QUEUE_SIZE - 1)];
+		if (command.time >= tickEnd)
+		{
+			break;
+		}
+
+		switch (command.type)
+		{
+		case SIM_COMMAND_SPEED:
+			if (!simState.waitingToBegin)
+			{
+				// Older ones count from the start of the tick
+				long long at = command.time > from ? command.time : from;
+				moved += (long long)simSpeed * (at - from);
+				from = at;
+				simSpeed = command.speed;
+				simInputTime = command.time;
+			}
+			break;
+
+		case SIM_COMMAND_START:
+			if (simState.waitingToBegin)
+			{
+				simInput.start = true;
+			}
+			break;
+		}
+	}
+	commandRead.store(read, std::memory_order_release);
+
+	moved += (long long)simSpeed * (tickEnd - from);
+	int speed = (int)(moved / (tickEnd - tickStart));
+	simInput.playerDirection = (speed > 0) - (speed < 0);
+	simInput.playerSpeed = speed < 0 ? -speed : speed;
+}
+
+static void Publish(const SimState& previous, long long tickTime)
+{
+	SimSnapshot& snapshot = snapshots[snapshotBack];
+	snapshot.previous = previous;
+	snapshot.current = simState;
+	snapshot.tickTime = tickTime;
+	snapshot.bounces = simBounces;
+	snapshot.inputTime = simInputTime;
+
+	snapshotBack = snapshotMiddle.exchange(snapshotBack | SNAPSHOT_FRESH, std::memory_order_acq_rel) & SNAPSHOT_INDEX;
+}
+
+static void RunSimulation()
+{
+	long long next = ProfileNow() + SIM_TICK_NS;
+
+	while (simRunning)
+	{
+		long long now = ProfileNow();
+		if (now < next)
+		{
+			if (next - now > SIM_SPIN_NS)
+			{
+				std::this_thread::sleep_for(std::chrono::nanoseconds(next - now - SIM_SPIN_NS / 2));
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+			continue;
+		}
+
+		SimState previous = simState;
+		int steps = 0;
+		while (now >= next && steps < MAX_SIM_STEPS_PER_WAKE)
+		{
+			long long stepStart = ProfileNow();
+			ApplyCommands(next - SIM_TICK_NS, next);
+
+			previous = simState;
+			int events;
+			if (simNetwork != NULL)
+			{
+				// This side's paddle, whichever it is. A rollback may move things
+				// a few ticks back, the next frames simply show the corrected state.
+				events = RollbackAdvance(*simNetwork, simInput.playerDirection, simInput.start);
+				simState = simNetwork->state;
+			}
+			else
+			{
+				ReplayRecordStep(simReplay, simState, simInput);
+				events = SimStep(simState, simInput);
+			}
+
+			if (events == ROLLBACK_STALLED)
+			{
+				// Waiting for the peer, ENTER stays pressed until a tick takes it
+				events = 0;
+			}
+			else
+			{
+				simInput.start = false;
+			}
+
+			if (events & SIM_EVENT_BOUNCE)
+			{
+				simBounces++;
+			}
+
+			if (events & SIM_EVENT_ROUND_RESET)
+			{
+				simInput.playerDirection = DIRECTION_STOP;
+				simSpeed = 0;
+
+				// Don't slide the ball back to the middle
+				previous = simState;
+			}
+
+			if (simBroadcast != NULL)
+			{
+				SpectatorPublish(*simBroadcast, SpectatorCapture(simState, simTick, simBounces));
+			}
+			simTick++;
+
+			ProfileRecord(PROFILE_SIM_STEP, stepStart, ProfileNow());
+			next += SIM_TICK_NS;
+			steps++;
+		}
+
+		if (now >= next)
+		{
+			next = now + SIM_TICK_NS;
+		}
+
+		Publish(previous, next - SIM_TICK_NS);
+	}
+}
+
+// Spectating: waits for frames from the relay and publishes each one
+static void RunSpectator()
+{
+	const int SPECTATOR_WAIT_MS = 20;
+	int firstBounces = -1;
+
+	while (simRunning)
+	{
+		NetStreamWait(simSpectator->stream, SPECTATOR_WAIT_MS);
+
+		int frames = SpectatorReceive(*simSpectator);
+		if (frames < 0)
+		{
+			// Ends the match on the viewer's side
+			printf("The spectator relay closed the stream\n");
+			SimState previous = simState;
+			simState.finished = true;
+			Publish(previous, ProfileNow());
+			break;
+		}
+
+		if (frames > 0)
+		{
+			const SpectatorFrame& frame = simSpectator->frame;
+			if (firstBounces < 0)
+			{
+				firstBounces = frame.fields[SPECTATOR_BOUNCES];
+			}
+
+			SimState previous = simState;
+			SpectatorApply(frame, simState);
+			simBounces = frame.fields[SPECTATOR_BOUNCES] - firstBounces;
+			Publish(previous, ProfileNow());
+		}
+	}
+}
+
+static void ResetSnapshots()
+{
+	// Every slot starts with the first state, the thread isn't running yet
+	for (int i = 0; i < 3; i++)
+	{
+		snapshots[i].previous = simState;
+		snapshots[i].current = simState;
+		snapshots[i].tickTime = ProfileNow();
+		snapshots[i].bounces = 0;
+		snapshots[i].inputTime = 0;
+	}
+	snapshotFront = 0;
+	snapshotMiddle = 1;
+	snapshotBack = 2;
+}
+
+void StartSpectatorThread(SpectatorViewer& viewer)
+{
+	StopSimThread();
+
+	SimInit(simState, SimDefaultConfig());
+	simSpectator = &viewer;
+	simBounces = 0;
+	simInputTime = 0;
+	ResetSnapshots();
+
+	simRunning = true;
+	simThread = std::thread(RunSpectator);
+}
+
+void SimThreadBroadcast(SpectatorPublisher* publisher)
+{
+	simBroadcast = publisher;
+}
+
+void StartSimThread(const SimConfig& config, const char* replayPath, RollbackSession* network)
+{
+	StopSimThread();
+
+	simNetwork = network;
+	if (network != NULL)
+	{
+		simState = network->state;
+	}
+	else
+	{
+		SimInit(simState, config);
+		ReplayBeginRecording(simReplay, replayPath, simState);
+	}
+	simInput.playerDirection = DIRECTION_STOP;
+	simInput.playerSpeed = SIM_FULL_SPEED;
+	simInput.start = false;
+	simSpeed = 0;
+	simInputTime = 0;
+	simBounces = 0;
+	simTick = 0;
+	commandRead = 0;
+	commandWrite = 0;
+	ResetSnapshots();
+
+	// Viewers start the new match from a keyframe
+	if (simBroadcast != NULL)
+	{
+		simBroadcast->needKeyframe = true;
+	}
+
+	simRunning = true;
+	simThread = std::thread(RunSimulation);
+}
+
+void StopSimThread()
+{
+	if (!simThread.joinable())
+	{
+		return;
+	}
+
+	simRunning = false;
+	simThread.join();
+
+	// Keeps the replay of a match that was closed halfway
+	ReplayEndRecording(simReplay, simState);
+	simNetwork = NULL;
+	simSpectator = NULL;
+}
+
+void SimThreadSetDirection(int direction, long long time)
+{
+	PushCommand(SIM_COMMAND_SPEED, direction * SIM_FULL_SPEED, time);
+}
+
+void SimThreadSetAxis(int speed, long long time)
+{
+	PushCommand(SIM_COMMAND_SPEED, speed, time);
+}
+
+void SimThreadStart(long long time)
+{
+	PushCommand(SIM_COMMAND_START, 0, time);
+}
+
+const SimSnapshot& LatestSimSnapshot()
+{
+	if (snapshotMiddle.load(std::memory_order_relaxed) & SNAPSHOT_FRESH)
+	{
+		snapshotFront = snapshotMiddle.exchange(snapshotFront, std::memory_order_acq_rel) & SNAPSHOT_INDEX;
+	}
+	return snapshots[snapshotFront];
+}
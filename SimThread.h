@@ -0,0 +1,55 @@
+#pragma once
+#include "Simulation.h"
+#include "Rollback.h"
+#include "Spectator.h"
+
+// Runs the match on its own thread at SIM_TICKS_PER_SECOND, so a slow frame
+// on the render thread never delays physics. Input goes in through a
+// lock-free queue and every tick publishes a snapshot through a lock-free
+// triple buffer: neither thread ever waits for the other.
+//
+// Input carries the time it happened. Each tick only takes what happened
+// before its end, when it is due, and moves the paddle by how long each
+// speed was held during it: a key pressed three quarters into a tick moves
+// it a quarter of the way, and the next tick the rest.
+
+const int SIM_INPUT_QUEUE_SIZE = 256; // Power of two, a stick sends a lot
+const int MAX_SIM_STEPS_PER_WAKE = 8; // Drop time after a long stall instead of catching up forever
+
+typedef struct SimSnapshot
+{
+	SimState previous; // One tick earlier, rendering interpolates from it
+	SimState current;
+	long long tickTime; // ProfileNow() when current was due
+	int bounces; // Since the match started, a sound per new one
+	long long inputTime; // Of the last speed change current shows, for latency measurements
+} SimSnapshot;
+
+// Starts a match, recording it to replayPath. With a network session the
+// ticks run through it instead, with this side's input, and nothing is
+// recorded: replays only hold the player's input. The session stays open
+// after StopSimThread.
+void StartSimThread(const SimConfig& config, const char* replayPath, RollbackSession* network = NULL);
+
+// Shows the match a relay forwards instead of running one, input is ignored.
+// The viewer stays connected after StopSimThread.
+void StartSpectatorThread(SpectatorViewer& viewer);
+
+// Every tick of the matches started after this is also published, NULL stops
+void SimThreadBroadcast(SpectatorPublisher* publisher);
+
+// Joins the thread and finishes the replay. Nothing when not running.
+void StopSimThread();
+
+// Game thread side. Input follows the same rules as before: the paddle
+// only moves and ENTER only starts while the round allows it. time is
+// ProfileNow() when it happened, 0 for now. Network matches only send the
+// direction, the paddle moves at full speed there.
+void SimThreadSetDirection(int direction, long long time = 0);
+void SimThreadStart(long long time = 0);
+
+// Analog stick, -SIM_FULL_SPEED is all the way up
+void SimThreadSetAxis(int speed, long long time = 0);
+
+// The newest snapshot, valid until the next call
+const SimSnapshot& LatestSimSnapshot();
@@ -0,0 +1,447 @@
+#include "Simulation.h"
+
+static void PlaceMiddle(SimBody& c)
+{
+	SetComponentPosition(c, (ARENA_WIDTH - c.rect.w) / 2, (ARENA_HEIGHT - c.rect.h) / 2);
+}
+
+static void PlaceLeftMiddle(SimBody& c, int padding)
+{
+	SetComponentPosition(c, 0 + padding, (ARENA_HEIGHT - c.rect.h) / 2);
+}
+
+static void PlaceRightMiddle(SimBody& c, int padding)
+{
+	SetComponentPosition(c, ARENA_WIDTH - c.rect.w - padding, (ARENA_HEIGHT - c.rect.h) / 2);
+}
+
+SimConfig SimDefaultConfig()
+{
+	SimConfig config;
+	config.intialBallVelocity = 5;
+	config.playerVelocity = 7;
+	config.enemyVelocity = 5;
+	config.reactionDelay = DIFFICULTY_DELAY;
+	config.aimError = DIFFICULTY_AIM;
+	config.matchDuration = MATCH_DURATION;
+	config.enemyHuman = false;
+	return config;
+}
+
+bool CheckCollision(const SimRect& a, const SimRect& b)
+{
+	// The sides of the rectangles
+	int leftA, leftB;
+	int rightA, rightB;
+	int topA, topB;
+	int bottomA, bottomB;
+
+	// Calculate the sides of rectA
+	leftA = a.x;
+	rightA = a.x + a.w;
+	topA = a.y;
+	bottomA = a.y + a.h;
+
+	// Calculate the sides of rectB
+	leftB = b.x;
+	rightB = b.x + b.w;
+	topB = b.y;
+	bottomB = b.y + b.h;
+
+	// Check for collision
+	if (bottomA <= topB || topA >= bottomB || rightA <= leftB || leftA >= rightB)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+void MoveComponent(SimBody& c)
+{
+	c.x += c.velocity * c.xDirection * SUBPIXELS_PER_PIXEL;
+	c.y += c.velocity * c.yDirection * SUBPIXELS_PER_PIXEL;
+	c.rect.x = c.x >> SUBPIXEL_SHIFT;
+	c.rect.y = c.y >> SUBPIXEL_SHIFT;
+}
+
+void SetComponentPosition(SimBody& c, int x, int y)
+{
+	c.rect.x = x;
+	c.rect.y = y;
+	c.x = x << SUBPIXEL_SHIFT;
+	c.y = y << SUBPIXEL_SHIFT;
+}
+
+void EnemyMovement(SimState& state)
+{
+	// Still following the old plan
+	if (state.enemyReaction > 0)
+	{
+		state.enemyReaction--;
+		return;
+	}
+
+	int paddleCenter = state.enemy.rect.y + state.enemy.rect.h / 2;
+	if (state.enemyTargetY < paddleCenter - state.enemy.velocity)
+	{
+		state.enemy.yDirection = DIRECTION_UP;
+	}
+	else if (state.enemyTargetY > paddleCenter + state.enemy.velocity)
+	{
+		state.enemy.yDirection = DIRECTION_DOWN;
+	}
+	else
+	{
+		state.enemy.yDirection = DIRECTION_STOP;
+	}
+}
+
+// Ball center when it reaches the enemy paddle face. The ball moves the same
+// distance on both axes, so the y travel is the x distance, and bouncing off
+// TOP and BOTTOM mirrors it back into the band between them.
+static int PredictBallY(const SimState& state)
+{
+	const SimBody& ball = state.ball;
+	int top = (state.TOP.y + state.TOP.h) << SUBPIXEL_SHIFT;
+	int span = (state.BOTTOM.y << SUBPIXEL_SHIFT) - (ball.rect.h << SUBPIXEL_SHIFT) - top;
+
+	int distance = ball.x - ((state.enemy.rect.x + state.enemy.rect.w) << SUBPIXEL_SHIFT);
+	distance = distance > 0 ? distance : 0;
+
+	int y = ball.y + ball.yDirection * distance - top;
+	while (y < 0)
+	{
+		y += 2 * span;
+	}
+	while (y >= 2 * span)
+	{
+		y -= 2 * span;
+	}
+	if (y > span)
+	{
+		y = 2 * span - y;
+	}
+
+	return ((y + top) >> SUBPIXEL_SHIFT) + ball.rect.h / 2;
+}
+
+void EnemyRethink(SimState& state)
+{
+	// Uniform in -aimError..aimError, drawn on every call so the batch kernels
+	// can follow without branches
+	state.enemyRandom = state.enemyRandom * 1664525u + 1013904223u;
+	unsigned bits = (state.enemyRandom >> 16) & 0xFFFF;
+	int error = (int)((bits * (unsigned)(2 * state.config.aimError + 1)) >> 16) - state.config.aimError;
+
+	// Back to the middle while the ball heads to the player
+	state.enemyTargetY = state.ball.xDirection < 0 ? PredictBallY(state) + error : ARENA_HEIGHT / 2;
+	state.enemyReaction = state.config.reactionDelay;
+}
+
+static int Smallest(int a, int b)
+{
+	return a < b ? a : b;
+}
+
+int SweepBall(SimState& state)
+{
+	SimBody& ball = state.ball;
+	const int size = ball.rect.w << SUBPIXEL_SHIFT;
+	int events = 0;
+
+	// The ball always moves diagonally, the same distance on both axes, so the
+	// first surface reached is simply the one at the smallest axis distance.
+	int remaining = ball.velocity * SUBPIXELS_PER_PIXEL;
+
+	for (int bounce = 0; bounce < SIM_MAX_BOUNCES && remaining > 0; bounce++)
+	{
+		// Top or bottom border
+		int distanceY = ball.yDirection < 0
+			? ball.y - ((state.TOP.y + state.TOP.h) << SUBPIXEL_SHIFT)
+			: (state.BOTTOM.y << SUBPIXEL_SHIFT) - (ball.y + size);
+
+		// Paddle face, then the border behind it
+		const SimBody& paddle = ball.xDirection > 0 ? state.player : state.enemy;
+		int distancePaddle, distanceGoal;
+		if (ball.xDirection > 0)
+		{
+			distancePaddle = (paddle.rect.x << SUBPIXEL_SHIFT) - (ball.x + size);
+			distanceGoal = (state.RIGHT.x << SUBPIXEL_SHIFT) - (ball.x + size);
+		}
+		else
+		{
+			distancePaddle = ball.x - ((paddle.rect.x + paddle.rect.w) << SUBPIXEL_SHIFT);
+			distanceGoal = ball.x - ((state.LEFT.x + state.LEFT.w) << SUBPIXEL_SHIFT);
+		}
+
+		// Does the face get reached before the wall, with the paddle in the way?
+		int yAtPaddle = ball.y + ball.yDirection * distancePaddle;
+		bool paddleHit = distancePaddle >= 0
+			&& distancePaddle <= distanceY
+			&& yAtPaddle < paddle.y + (paddle.rect.h << SUBPIXEL_SHIFT)
+			&& yAtPaddle + size > paddle.y;
+
+		int distanceX = paddleHit ? distancePaddle : distanceGoal;
+		distanceX = distanceX > 0 ? distanceX : 0;
+		distanceY = distanceY > 0 ? distanceY : 0;
+
+		int step = Smallest(remaining, Smallest(distanceX, distanceY));
+		ball.x += ball.xDirection * step;
+		ball.y += ball.yDirection * step;
+		remaining -= step;
+
+		if (distanceY == step)
+		{
+			ball.yDirection = -ball.yDirection;
+			events |= SIM_EVENT_BOUNCE;
+		}
+
+		if (distanceX == step && paddleHit)
+		{
+			ball.xDirection = -ball.xDirection;
+			ball.velocity++;
+			events |= SIM_EVENT_BOUNCE | SIM_EVENT_PADDLE_HIT;
+		}
+		else if (distanceX == step)
+		{
+			// Scored, the ball stays on the border until the new round
+			if (ball.xDirection > 0)
+			{
+				state.enemyPoints++;
+				events |= SIM_EVENT_BOUNCE | SIM_EVENT_ENEMY_SCORED;
+			}
+			else
+			{
+				state.playerPoints++;
+				events |= SIM_EVENT_BOUNCE | SIM_EVENT_PLAYER_SCORED;
+			}
+			ball.xDirection = -ball.xDirection;
+			state.newRound = true;
+			remaining = 0;
+		}
+	}
+
+	ball.rect.x = ball.x >> SUBPIXEL_SHIFT;
+	ball.rect.y = ball.y >> SUBPIXEL_SHIFT;
+
+	return events;
+}
+
+static unsigned HashInt(unsigned hash, int value)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		hash = (hash ^ ((unsigned)value >> (i * 8) & 0xFF)) * 16777619u;
+	}
+	return hash;
+}
+
+static unsigned HashBody(unsigned hash, const SimBody& c)
+{
+	hash = HashInt(hash, c.x);
+	hash = HashInt(hash, c.y);
+	hash = HashInt(hash, c.velocity);
+	hash = HashInt(hash, c.xDirection);
+	return HashInt(hash, c.yDirection);
+}
+
+unsigned SimHash(const SimState& state)
+{
+	unsigned hash = 2166136261u;
+	hash = HashInt(hash, state.newRound | state.waitingToBegin << 1 | state.finished << 2);
+	hash = HashInt(hash, state.playerPoints);
+	hash = HashInt(hash, state.enemyPoints);
+	hash = HashInt(hash, state.playedTicks);
+	hash = HashInt(hash, state.enemyTargetY);
+	hash = HashInt(hash, state.enemyReaction);
+	hash = HashInt(hash, (int)state.enemyRandom);
+	hash = HashBody(hash, state.ball);
+	hash = HashBody(hash, state.player);
+	return HashBody(hash, state.enemy);
+}
+
+void SimInit(SimState& state, const SimConfig& config)
+{
+	state.config = config;
+
+	// Initial States
+	state.newRound = false;
+	state.waitingToBegin = true;
+	state.finished = false;
+	state.playerPoints = 0;
+	state.enemyPoints = 0;
+
+	// timer
+	state.playedTicks = 0;
+	state.timeLeft = config.matchDuration;
+
+	// Frame Borders
+	state.TOP = { 0,0,ARENA_WIDTH, ARENA_PADDING };
+	state.RIGHT = { ARENA_WIDTH - ARENA_PADDING, 0,ARENA_PADDING, ARENA_HEIGHT };
+	state.BOTTOM = { 0,ARENA_HEIGHT - ARENA_PADDING ,ARENA_WIDTH, ARENA_HEIGHT };
+	state.LEFT = { 0,0,ARENA_PADDING, ARENA_HEIGHT };
+
+	// Ball properties
+	state.ball.rect = { 0, 0, BALL_SIZE, BALL_SIZE };
+	state.ball.velocity = config.intialBallVelocity;
+	state.ball.xDirection = DIRECTION_LEFT;
+	state.ball.yDirection = DIRECTION_UP;
+
+	// paddles properties
+	state.player.rect = { 0, 0, PADDLE_WIDTH, PADDLE_HEIGHT };
+	state.player.velocity = config.playerVelocity;
+	state.player.xDirection = DIRECTION_STOP;
+	state.player.yDirection = DIRECTION_STOP;
+
+	state.enemy.rect = { 0, 0, PADDLE_WIDTH, PADDLE_HEIGHT };
+	state.enemy.velocity = config.enemyVelocity;
+	state.enemy.xDirection = DIRECTION_STOP;
+	state.enemy.yDirection = DIRECTION_STOP;
+
+	// Place components
+	PlaceMiddle(state.ball);
+	PlaceRightMiddle(state.player, ARENA_PADDING);
+	PlaceLeftMiddle(state.enemy, ARENA_PADDING);
+
+	// Enemy AI
+	state.enemyRandom = 0;
+	EnemyRethink(state);
+}
+
+void SimNewRound(SimState& state)
+{
+	state.newRound = false;
+	state.waitingToBegin = true;
+
+	// Ball properties
+	state.ball.velocity = state.config.intialBallVelocity;
+	state.ball.xDirection = DIRECTION_RIGHT;
+	state.ball.yDirection = DIRECTION_UP;
+
+	// Paddles properties
+	state.player.yDirection = DIRECTION_STOP;
+	state.enemy.yDirection = DIRECTION_STOP;
+
+	PlaceMiddle(state.ball);
+	PlaceRightMiddle(state.player, ARENA_PADDING);
+	PlaceLeftMiddle(state.enemy, ARENA_PADDING);
+
+	// Enemy AI
+	EnemyRethink(state);
+}
+
+int SimStep(SimState& state, const SimInput& input)
+{
+	int events = 0;
+
+	if (state.finished)
+	{
+		return SIM_EVENT_MATCH_OVER;
+	}
+
+	if (state.newRound)
+	{
+		SimNewRound(state);
+		events |= SIM_EVENT_ROUND_RESET;
+	}
+
+	if (state.waitingToBegin)
+	{
+		if (!input.start)
+		{
+			return events;
+		}
+
+		state.waitingToBegin = false;
+		events |= SIM_EVENT_ROUND_STARTED;
+	}
+
+	// Timer
+	state.playedTicks++;
+	state.timeLeft = state.config.matchDuration - state.playedTicks / SIM_TICKS_PER_SECOND;
+
+	if (state.timeLeft <= 0) {
+		state.finished = true;
+		return events | SIM_EVENT_MATCH_OVER;
+	}
+
+	// Move Paddles
+	state.player.yDirection = input.playerDirection;
+
+	if (state.config.enemyHuman)
+	{
+		state.enemy.yDirection = input.enemyDirection;
+	}
+	else
+	{
+		EnemyMovement(state);
+	}
+	state.player.y += state.player.velocity * state.player.yDirection * input.playerSpeed;
+	state.player.rect.y = state.player.y >> SUBPIXEL_SHIFT;
+	MoveComponent(state.enemy);
+
+	// Player Paddle and Borders
+	if (CheckCollision(state.player.rect, state.TOP))
+	{
+		state.player.yDirection = DIRECTION_STOP;
+		SetComponentPosition(state.player, state.player.rect.x, state.TOP.h);
+	}
+	if (CheckCollision(state.player.rect, state.BOTTOM))
+	{
+		state.player.yDirection = DIRECTION_STOP;
+		SetComponentPosition(state.player, state.player.rect.x, state.BOTTOM.y - state.player.rect.h);
+	}
+
+	// enemy Paddle and Borders
+	if (CheckCollision(state.enemy.rect, state.TOP))
+	{
+		state.enemy.yDirection = DIRECTION_STOP;
+		SetComponentPosition(state.enemy, state.enemy.rect.x, state.TOP.h);
+	}
+	if (CheckCollision(state.enemy.rect, state.BOTTOM))
+	{
+		state.enemy.yDirection = DIRECTION_STOP;
+		SetComponentPosition(state.enemy, state.enemy.rect.x, state.BOTTOM.y - state.enemy.rect.h);
+	}
+
+	// Move the ball against the paddles where they ended up
+	int sweepEvents = SweepBall(state);
+	events |= sweepEvents;
+
+	// A paddle hit is the only course change the plan doesn't already
+	// include, TOP and BOTTOM bounces are folded into PredictBallY
+	if (sweepEvents & SIM_EVENT_PADDLE_HIT)
+	{
+		EnemyRethink(state);
+	}
+
+	return events;
+}
+
+SimInput SimAutopilotInput(const SimState& state)
+{
+	SimInput input;
+	input.playerSpeed = SIM_FULL_SPEED;
+	input.start = state.waitingToBegin;
+	input.enemyDirection = DIRECTION_STOP;
+
+	// Follow the ball with the paddle center
+	int paddleCenter = state.player.rect.y + state.player.rect.h / 2;
+	int ballCenter = state.ball.rect.y + state.ball.rect.h / 2;
+
+	if (ballCenter < paddleCenter - state.player.velocity)
+	{
+		input.playerDirection = DIRECTION_UP;
+	}
+	else if (ballCenter > paddleCenter + state.player.velocity)
+	{
+		input.playerDirection = DIRECTION_DOWN;
+	}
+	else
+	{
+		input.playerDirection = DIRECTION_STOP;
+	}
+
+	return input;
+}
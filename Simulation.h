@@ -0,0 +1,159 @@
+#pragma once
+
+// Gameplay rules without any SDL video, audio or Win32 dependency.
+// The game drives it at a fixed tick rate, the headless tools as fast as they can.
+
+// Arena
+const int ARENA_WIDTH = 1280;
+const int ARENA_HEIGHT = 768;
+const int ARENA_PADDING = 15;
+
+// Sprite sizes (resources/img)
+const int BALL_SIZE = 15;
+const int PADDLE_WIDTH = 20;
+const int PADDLE_HEIGHT = 150;
+
+const int MATCH_DURATION = 120;
+
+// Fixed simulation rate, velocities are in pixels per tick
+const int SIM_TICKS_PER_SECOND = 60;
+
+// Surfaces the ball can bounce off within a single tick
+const int SIM_MAX_BOUNCES = 8;
+
+// Positions are fixed point with 8 bits of sub-pixel precision
+const int SUBPIXEL_SHIFT = 8;
+const int SUBPIXELS_PER_PIXEL = 1 << SUBPIXEL_SHIFT;
+
+// Player paddle speed for a held key, a half tilted stick or a key pressed
+// halfway through a tick moves it less
+const int SIM_FULL_SPEED = SUBPIXELS_PER_PIXEL;
+
+// Difficulty, how many ticks the enemy takes to react to a new ball course
+// and how many pixels it may miss the landing point by
+const int TOO_YOUNG_TO_DIE_DELAY = 50;
+const int TOO_YOUNG_TO_DIE_AIM = 200;
+const int ULTRA_VIOLENCE_DELAY = 30;
+const int ULTRA_VIOLENCE_AIM = 150;
+const int NIGHTMARE_DELAY = 10;
+const int NIGHTMARE_AIM = 100;
+
+const int DIFFICULTY_DELAY = ULTRA_VIOLENCE_DELAY;
+const int DIFFICULTY_AIM = ULTRA_VIOLENCE_AIM;
+
+// Directions
+const int DIRECTION_STOP = 0;
+const int DIRECTION_UP = -1;
+const int DIRECTION_DOWN = 1;
+const int DIRECTION_LEFT = -1;
+const int DIRECTION_RIGHT = 1;
+
+// Events reported by SimStep
+const int SIM_EVENT_BOUNCE = 1 << 0; // Ball hit a paddle or a border
+const int SIM_EVENT_PLAYER_SCORED = 1 << 1;
+const int SIM_EVENT_ENEMY_SCORED = 1 << 2;
+const int SIM_EVENT_ROUND_STARTED = 1 << 3;
+const int SIM_EVENT_ROUND_RESET = 1 << 4;
+const int SIM_EVENT_MATCH_OVER = 1 << 5;
+const int SIM_EVENT_PADDLE_HIT = 1 << 6; // Ball hit the player or the enemy paddle
+
+// Same layout as SDL_Rect
+typedef struct SimRect
+{
+	int x, y, w, h;
+} SimRect;
+
+// Ball and paddle physics
+typedef struct SimBody
+{
+	SimRect rect; // Whole pixels, used for collisions and drawing
+	int x, y; // Sub-pixel position
+
+	int velocity;
+	int xDirection;
+	int yDirection;
+} SimBody;
+
+// Match tuning
+typedef struct SimConfig
+{
+	int intialBallVelocity;
+	int playerVelocity;
+	int enemyVelocity;
+
+	// Enemy AI
+	int reactionDelay; // Ticks
+	int aimError; // Pixels, at most
+
+	int matchDuration; // Seconds
+
+	bool enemyHuman; // Someone else drives the enemy through SimInput::enemyDirection
+} SimConfig;
+
+// What the player does during one step
+typedef struct SimInput
+{
+	int playerDirection;
+	int playerSpeed; // 0 to SIM_FULL_SPEED
+	bool start; // ENTER pressed
+	int enemyDirection; // Only with SimConfig::enemyHuman
+} SimInput;
+
+typedef struct SimState
+{
+	// Main conditions
+	bool newRound; // The player or the enemy Scored.
+	bool waitingToBegin; // Waiting for user input to start the round.
+	bool finished;
+
+	// Score
+	int playerPoints;
+	int enemyPoints;
+
+	// Timer
+	int playedTicks;
+	int timeLeft;
+
+	// Ball and Paddles
+	SimBody ball;
+	SimBody player;
+	SimBody enemy;
+
+	// Frame Borders
+	SimRect TOP;
+	SimRect RIGHT;
+	SimRect BOTTOM;
+	SimRect LEFT;
+
+	// Enemy AI, planned again only on paddle hits and round resets
+	int enemyTargetY; // Where the paddle center heads, pixels
+	int enemyReaction; // Ticks left before it follows the plan
+	unsigned enemyRandom; // Aim error generator
+
+	SimConfig config;
+} SimState;
+
+SimConfig SimDefaultConfig();
+
+void SimInit(SimState& state, const SimConfig& config);
+void SimNewRound(SimState& state);
+int SimStep(SimState& state, const SimInput& input);
+
+bool CheckCollision(const SimRect& a, const SimRect& b);
+void MoveComponent(SimBody& c);
+void SetComponentPosition(SimBody& c, int x, int y);
+
+// Enemy AI: EnemyRethink solves where the ball will reach the enemy paddle,
+// folding in the TOP and BOTTOM bounces, and is only called when a paddle
+// sends the ball back or a round resets. EnemyMovement steers toward that plan every tick.
+void EnemyMovement(SimState& state);
+void EnemyRethink(SimState& state);
+
+int SweepBall(SimState& state);
+
+// FNV-1a of everything the rules depend on, equal on every machine running
+// the same inputs. Padding is left out, copies may not preserve it.
+unsigned SimHash(const SimState& state);
+
+// Simple player bot used when nobody is at the keyboard
+SimInput SimAutopilotInput(const SimState& state);
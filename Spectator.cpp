@@ -0,0 +1,328 @@
+#include "Spectator.h"
+#include <stdio.h>
+#include <string.h>
+
+static unsigned char* PutVarint(unsigned char* out, unsigned value)
+{
+	while (value >= 0x80)
+	{
+		*out++ = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	*out++ = (unsigned char)value;
+	return out;
+}
+
+static const unsigned char* GetVarint(const unsigned char* in, const unsigned char* end, unsigned& value)
+{
+	value = 0;
+	for (int shift = 0; in < end && shift < 35; shift += 7)
+	{
+		unsigned char byte = *in++;
+		value |= (unsigned)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return in;
+		}
+	}
+	return NULL;
+}
+
+// Small negative numbers stay small
+static unsigned ZigZag(int value)
+{
+	return ((unsigned)value << 1) ^ (unsigned)(value >> 31);
+}
+
+static int UnZigZag(unsigned value)
+{
+	return (int)(value >> 1) ^ -(int)(value & 1);
+}
+
+SpectatorFrame SpectatorCapture(const SimState& state, int tick, int bounces)
+{
+	SpectatorFrame frame;
+	frame.fields[SPECTATOR_TICK] = tick;
+	frame.fields[SPECTATOR_BALL_X] = state.ball.rect.x;
+	frame.fields[SPECTATOR_BALL_Y] = state.ball.rect.y;
+	frame.fields[SPECTATOR_PLAYER_Y] = state.player.rect.y;
+	frame.fields[SPECTATOR_ENEMY_Y] = state.enemy.rect.y;
+	frame.fields[SPECTATOR_PLAYER_POINTS] = state.playerPoints;
+	frame.fields[SPECTATOR_ENEMY_POINTS] = state.enemyPoints;
+	frame.fields[SPECTATOR_TIME_LEFT] = state.timeLeft;
+	frame.fields[SPECTATOR_FLAGS] = (state.waitingToBegin ? SPECTATOR_FLAG_WAITING : 0)
+		| (state.finished ? SPECTATOR_FLAG_FINISHED : 0)
+		| (state.newRound ? SPECTATOR_FLAG_NEW_ROUND : 0);
+	frame.fields[SPECTATOR_BOUNCES] = bounces;
+	return frame;
+}
+
+void SpectatorApply(const SpectatorFrame& frame, SimState& state)
+{
+	SetComponentPosition(state.ball, frame.fields[SPECTATOR_BALL_X], frame.fields[SPECTATOR_BALL_Y]);
+	SetComponentPosition(state.player, state.player.rect.x, frame.fields[SPECTATOR_PLAYER_Y]);
+	SetComponentPosition(state.enemy, state.enemy.rect.x, frame.fields[SPECTATOR_ENEMY_Y]);
+	state.playerPoints = frame.fields[SPECTATOR_PLAYER_POINTS];
+	state.enemyPoints = frame.fields[SPECTATOR_ENEMY_POINTS];
+	state.timeLeft = frame.fields[SPECTATOR_TIME_LEFT];
+	state.waitingToBegin = (frame.fields[SPECTATOR_FLAGS] & SPECTATOR_FLAG_WAITING) != 0;
+	state.finished = (frame.fields[SPECTATOR_FLAGS] & SPECTATOR_FLAG_FINISHED) != 0;
+	state.newRound = (frame.fields[SPECTATOR_FLAGS] & SPECTATOR_FLAG_NEW_ROUND) != 0;
+}
+
+// The value a delta field is taken against
+static int Expected(const SpectatorFrame& previous, int field)
+{
+	return previous.fields[field] + (field == SPECTATOR_TICK ? 1 : 0);
+}
+
+int SpectatorEncode(const SpectatorFrame& frame, const SpectatorFrame* previous, unsigned char* out)
+{
+	unsigned char* write = out + 1;
+
+	if (previous == NULL)
+	{
+		*write++ = SPECTATOR_KEYFRAME;
+		for (int field = 0; field < SPECTATOR_FIELD_COUNT; field++)
+		{
+			write = PutVarint(write, ZigZag(frame.fields[field]));
+		}
+	}
+	else
+	{
+		unsigned mask = 0;
+		for (int field = 0; field < SPECTATOR_FIELD_COUNT; field++)
+		{
+			if (frame.fields[field] != Expected(*previous, field))
+			{
+				mask |= 1u << field;
+			}
+		}
+
+		*write++ = SPECTATOR_DELTA;
+		write = PutVarint(write, mask);
+		for (int field = 0; field < SPECTATOR_FIELD_COUNT; field++)
+		{
+			if (mask & (1u << field))
+			{
+				write = PutVarint(write, ZigZag(frame.fields[field] - Expected(*previous, field)));
+			}
+		}
+	}
+
+	int size = (int)(write - out);
+	out[0] = (unsigned char)(size - 1);
+	return size;
+}
+
+bool SpectatorDecode(const unsigned char* message, SpectatorFrame& frame)
+{
+	const unsigned char* end = message + 1 + message[0];
+	const unsigned char* read = message + 2;
+	if (read > end)
+	{
+		return false;
+	}
+
+	unsigned value;
+	SpectatorFrame decoded = frame;
+
+	switch (message[1])
+	{
+	case SPECTATOR_KEYFRAME:
+		for (int field = 0; field < SPECTATOR_FIELD_COUNT && read != NULL; field++)
+		{
+			read = GetVarint(read, end, value);
+			decoded.fields[field] = UnZigZag(value);
+		}
+		break;
+
+	case SPECTATOR_DELTA:
+	{
+		unsigned mask;
+		read = GetVarint(read, end, mask);
+		for (int field = 0; field < SPECTATOR_FIELD_COUNT && read != NULL; field++)
+		{
+			int change = 0;
+			if (mask & (1u << field))
+			{
+				read = GetVarint(read, end, value);
+				change = UnZigZag(value);
+			}
+			decoded.fields[field] = Expected(frame, field) + change;
+		}
+		break;
+	}
+
+	default:
+		return false;
+	}
+
+	if (read != end)
+	{
+		return false;
+	}
+
+	frame = decoded;
+	return true;
+}
+
+int SpectatorMessageSize(const unsigned char* data, int available)
+{
+	if (available < 1 || available < 1 + data[0])
+	{
+		return 0;
+	}
+	return 1 + data[0];
+}
+
+static void FlushPending(SpectatorPublisher& publisher)
+{
+	if (publisher.pendingSize == 0)
+	{
+		return;
+	}
+
+	int sent = NetStreamSend(publisher.stream, publisher.pending, publisher.pendingSize);
+	if (sent < 0)
+	{
+		printf("The spectator relay closed the stream\n");
+		NetStreamClose(publisher.stream);
+		publisher.pendingSize = 0;
+		return;
+	}
+
+	publisher.bytesSent += sent;
+	publisher.pendingSize -= sent;
+	memmove(publisher.pending, publisher.pending + sent, publisher.pendingSize);
+}
+
+bool SpectatorStartPublishing(SpectatorPublisher& publisher, const char* address)
+{
+	publisher.pendingSize = 0;
+	publisher.sinceKeyframe = 0;
+	publisher.needKeyframe = true;
+	publisher.bytesSent = 0;
+	publisher.dropped = 0;
+
+	if (!NetStreamConnect(publisher.stream, address))
+	{
+		return false;
+	}
+
+	publisher.pending[publisher.pendingSize++] = SPECTATOR_HELLO_PUBLISHER;
+	FlushPending(publisher);
+	printf("Broadcasting matches to %s\n", address);
+	return true;
+}
+
+void SpectatorPublish(SpectatorPublisher& publisher, const SpectatorFrame& frame)
+{
+	if (!publisher.stream.open)
+	{
+		return;
+	}
+
+	FlushPending(publisher);
+
+	bool keyframe = publisher.needKeyframe || publisher.sinceKeyframe >= SPECTATOR_KEYFRAME_INTERVAL;
+	unsigned char message[SPECTATOR_MAX_MESSAGE];
+	int size = SpectatorEncode(frame, keyframe ? NULL : &publisher.last, message);
+
+	if (publisher.pendingSize + size > SPECTATOR_SEND_BUFFER)
+	{
+		// Viewers would decode the next delta against a frame they never got
+		publisher.dropped++;
+		publisher.needKeyframe = true;
+		return;
+	}
+
+	memcpy(publisher.pending + publisher.pendingSize, message, size);
+	publisher.pendingSize += size;
+	publisher.last = frame;
+	publisher.sinceKeyframe = keyframe ? 1 : publisher.sinceKeyframe + 1;
+	publisher.needKeyframe = false;
+
+	FlushPending(publisher);
+}
+
+void SpectatorStopPublishing(SpectatorPublisher& publisher)
+{
+	NetStreamClose(publisher.stream);
+	publisher.pendingSize = 0;
+}
+
+bool SpectatorStartViewing(SpectatorViewer& viewer, const char* address)
+{
+	viewer.receivedSize = 0;
+	viewer.synced = false;
+	viewer.bytesReceived = 0;
+	viewer.frames = 0;
+	viewer.errors = 0;
+	memset(&viewer.frame, 0, sizeof(viewer.frame));
+
+	if (!NetStreamConnect(viewer.stream, address))
+	{
+		return false;
+	}
+
+	if (NetStreamSend(viewer.stream, &SPECTATOR_HELLO_VIEWER, 1) != 1)
+	{
+		NetStreamClose(viewer.stream);
+		return false;
+	}
+	return true;
+}
+
+int SpectatorReceive(SpectatorViewer& viewer)
+{
+	int decoded = 0;
+	bool closed = false;
+
+	while (!closed)
+	{
+		int size = NetStreamReceive(viewer.stream, viewer.received + viewer.receivedSize, SPECTATOR_RECEIVE_BUFFER - viewer.receivedSize);
+		if (size <= 0)
+		{
+			closed = size < 0;
+			break;
+		}
+		viewer.bytesReceived += size;
+		viewer.receivedSize += size;
+
+		int offset = 0;
+		int messageSize;
+		while ((messageSize = SpectatorMessageSize(viewer.received + offset, viewer.receivedSize - offset)) > 0)
+		{
+			const unsigned char* message = viewer.received + offset;
+			offset += messageSize;
+
+			if (!viewer.synced && message[1] != SPECTATOR_KEYFRAME)
+			{
+				continue;
+			}
+
+			if (SpectatorDecode(message, viewer.frame))
+			{
+				viewer.synced = true;
+				viewer.frames++;
+				decoded++;
+			}
+			else
+			{
+				viewer.errors++;
+				viewer.synced = false;
+			}
+		}
+
+		viewer.receivedSize -= offset;
+		memmove(viewer.received, viewer.received + offset, viewer.receivedSize);
+	}
+
+	return closed && decoded == 0 ? -1 : decoded;
+}
+
+void SpectatorStopViewing(SpectatorViewer& viewer)
+{
+	NetStreamClose(viewer.stream);
+}
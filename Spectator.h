@@ -0,0 +1,109 @@
+#pragma once
+#include "Simulation.h"
+#include "NetSocket.h"
+
+// Spectator stream: one match publishes what viewers need to draw it, every
+// tick, to pingpong_relay (SpectatorRelay.h), which forwards it to each
+// connected viewer over TCP.
+//
+// Message: one byte with the size of the rest, one byte of type, then the
+// frame. A keyframe has every field as a zigzag varint. A delta has a varint
+// mask of the fields that changed and the difference of each, against the
+// previous frame, the tick being expected one higher. A tick of play is
+// usually the ball and a paddle moving a few pixels: 5 to 8 bytes.
+
+const int SPECTATOR_DEFAULT_PORT = 7778;
+const int SPECTATOR_KEYFRAME_INTERVAL = SIM_TICKS_PER_SECOND; // Longest a new viewer waits
+const int SPECTATOR_MAX_MESSAGE = 64;
+const int SPECTATOR_SEND_BUFFER = 4096; // Publisher side, past this frames are dropped
+const int SPECTATOR_RECEIVE_BUFFER = 4096;
+
+// First byte sent to the relay
+const unsigned char SPECTATOR_HELLO_PUBLISHER = 'P';
+const unsigned char SPECTATOR_HELLO_VIEWER = 'V';
+
+enum SpectatorMessageType
+{
+	SPECTATOR_KEYFRAME = 1,
+	SPECTATOR_DELTA = 2
+};
+
+enum SpectatorField
+{
+	SPECTATOR_TICK,
+	SPECTATOR_BALL_X, // Whole pixels
+	SPECTATOR_BALL_Y,
+	SPECTATOR_PLAYER_Y,
+	SPECTATOR_ENEMY_Y,
+	SPECTATOR_PLAYER_POINTS,
+	SPECTATOR_ENEMY_POINTS,
+	SPECTATOR_TIME_LEFT,
+	SPECTATOR_FLAGS, // SPECTATOR_FLAG_*
+	SPECTATOR_BOUNCES, // Since the match started, a sound per new one
+	SPECTATOR_FIELD_COUNT
+};
+
+const int SPECTATOR_FLAG_WAITING = 1;
+const int SPECTATOR_FLAG_FINISHED = 2;
+const int SPECTATOR_FLAG_NEW_ROUND = 4;
+
+typedef struct SpectatorFrame
+{
+	int fields[SPECTATOR_FIELD_COUNT];
+} SpectatorFrame;
+
+typedef struct SpectatorPublisher
+{
+	NetStream stream;
+	SpectatorFrame last;
+	int sinceKeyframe;
+	bool needKeyframe;
+
+	// Written when the socket takes it
+	unsigned char pending[SPECTATOR_SEND_BUFFER];
+	int pendingSize;
+
+	long long bytesSent;
+	int dropped; // Frames the relay was too slow for
+} SpectatorPublisher;
+
+typedef struct SpectatorViewer
+{
+	NetStream stream;
+	unsigned char received[SPECTATOR_RECEIVE_BUFFER];
+	int receivedSize;
+
+	SpectatorFrame frame; // Newest decoded
+	bool synced; // Deltas are ignored until a keyframe arrives
+
+	long long bytesReceived;
+	int frames;
+	int errors;
+} SpectatorViewer;
+
+SpectatorFrame SpectatorCapture(const SimState& state, int tick, int bounces);
+
+// Sets what the frame holds, the rest of state is kept. Start from SimInit.
+void SpectatorApply(const SpectatorFrame& frame, SimState& state);
+
+// A whole message, size byte included. previous NULL makes a keyframe.
+// Returns its size.
+int SpectatorEncode(const SpectatorFrame& frame, const SpectatorFrame* previous, unsigned char* out);
+
+// message starts at the size byte. A delta applies to frame as it is.
+bool SpectatorDecode(const unsigned char* message, SpectatorFrame& frame);
+
+// Size of the message starting at data, 0 while it isn't all there
+int SpectatorMessageSize(const unsigned char* data, int available);
+
+// Publishing a match to a relay at "host:port"
+bool SpectatorStartPublishing(SpectatorPublisher& publisher, const char* address);
+void SpectatorPublish(SpectatorPublisher& publisher, const SpectatorFrame& frame);
+void SpectatorStopPublishing(SpectatorPublisher& publisher);
+
+// Watching the match a relay forwards
+bool SpectatorStartViewing(SpectatorViewer& viewer, const char* address);
+
+// Reads what arrived, returns how many frames were decoded, -1 once the relay is gone
+int SpectatorReceive(SpectatorViewer& viewer);
+void SpectatorStopViewing(SpectatorViewer& viewer);
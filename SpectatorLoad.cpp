@@ -0,0 +1,243 @@
+#include "SpectatorRelay.h"
+#include "Profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+// Load generator for the spectator relay: publishes a bot match at the game's
+// tick rate and connects many viewers, each checking every frame it decodes
+// against what was published. Without --relay the relay runs on a thread of
+// this process, so its CPU time can be measured on its own.
+
+const int TRUTH_HISTORY = 1024; // Published frames kept for checking, by tick
+const int DRAIN_MS = 500;
+const int JOIN_MS = 1000; // Viewers join gradually, most of them in the middle of the stream
+
+static SpectatorRelay relay;
+static std::atomic<bool> relayRunning(false);
+static long long relayCpuNs = 0;
+
+void PrintUsage()
+{
+	printf("Usage: pingpong_spectate_load [options]\n");
+	printf("  --viewers N          viewers to connect, default 500\n");
+	printf("  --seconds N          default 10\n");
+	printf("  --relay HOST:PORT    a running pingpong_relay instead of one in this process\n");
+}
+
+long long ThreadCpuNs()
+{
+	timespec time;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+	return time.tv_sec * 1000000000LL + time.tv_nsec;
+}
+
+void RunRelay()
+{
+	long long start = ThreadCpuNs();
+	while (relayRunning)
+	{
+		RelayPoll(relay, 10);
+	}
+	relayCpuNs = ThreadCpuNs() - start;
+}
+
+// One descriptor per viewer plus the relay's side of it
+void RaiseFileLimit()
+{
+	rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+	{
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+}
+
+int main(int argc, char* args[])
+{
+	int viewerCount = 500;
+	int seconds = 10;
+	const char* relayAddress = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(args[i], "--viewers") == 0 && hasValue)
+		{
+			viewerCount = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--seconds") == 0 && hasValue)
+		{
+			seconds = atoi(args[++i]);
+		}
+		else if (strcmp(args[i], "--relay") == 0 && hasValue)
+		{
+			relayAddress = args[++i];
+		}
+		else
+		{
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (viewerCount < 1 || seconds < 1)
+	{
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	RaiseFileLimit();
+
+	char localAddress[32];
+	std::thread relayThread;
+	if (relayAddress == NULL)
+	{
+		if (!RelayOpen(relay, 0))
+		{
+			return EXIT_FAILURE;
+		}
+		snprintf(localAddress, sizeof(localAddress), "127.0.0.1:%d", RelayPort(relay));
+		relayAddress = localAddress;
+
+		relayRunning = true;
+		relayThread = std::thread(RunRelay);
+	}
+
+	static SpectatorPublisher publisher;
+	if (!SpectatorStartPublishing(publisher, relayAddress))
+	{
+		return EXIT_FAILURE;
+	}
+
+	std::vector<SpectatorViewer> viewers(viewerCount);
+	int viewerEpoll = epoll_create1(0);
+	int connected = 0;
+	printf("%d viewers joining %s over the first %d ms, publishing for %d seconds\n", viewerCount, relayAddress, JOIN_MS, seconds);
+
+	static SpectatorFrame truth[TRUTH_HISTORY];
+	SimState match;
+	SimInit(match, SimDefaultConfig());
+	int tick = 0;
+	int bounces = 0;
+	int mismatches = 0;
+	int disconnected = 0;
+
+	const long long tickNs = 1000000000LL / SIM_TICKS_PER_SECOND;
+	long long start = ProfileNow();
+	long long end = start + seconds * 1000000000LL;
+	long long next = start;
+
+	for (;;)
+	{
+		long long now = ProfileNow();
+		if (now >= end + DRAIN_MS * 1000000LL)
+		{
+			break;
+		}
+
+		if (now >= next && now < end)
+		{
+			if (SimStep(match, SimAutopilotInput(match)) & SIM_EVENT_BOUNCE)
+			{
+				bounces++;
+			}
+			if (match.finished)
+			{
+				SimInit(match, SimDefaultConfig());
+			}
+
+			SpectatorFrame frame = SpectatorCapture(match, tick, bounces);
+			truth[tick % TRUTH_HISTORY] = frame;
+			SpectatorPublish(publisher, frame);
+			tick++;
+			next += tickNs;
+		}
+
+		// Late joiners start from the relay's catch-up of the stream
+		int joining = (int)((long long)viewerCount * (now - start) / (JOIN_MS * 1000000LL));
+		joining = joining < viewerCount ? joining : viewerCount;
+		for (; connected < joining; connected++)
+		{
+			SpectatorViewer& viewer = viewers[connected];
+			if (!SpectatorStartViewing(viewer, relayAddress))
+			{
+				printf("Only %d viewers could connect\n", connected);
+				return EXIT_FAILURE;
+			}
+
+			epoll_event event;
+			event.events = EPOLLIN;
+			event.data.u32 = (unsigned)connected;
+			epoll_ctl(viewerEpoll, EPOLL_CTL_ADD, viewer.stream.handle, &event);
+		}
+
+		int waitMs = (int)((next - ProfileNow()) / 1000000);
+		epoll_event events[64];
+		int count = epoll_wait(viewerEpoll, events, 64, waitMs > 0 ? waitMs : 0);
+		for (int i = 0; i < count; i++)
+		{
+			SpectatorViewer& viewer = viewers[events[i].data.u32];
+			int frames = SpectatorReceive(viewer);
+			if (frames < 0)
+			{
+				epoll_ctl(viewerEpoll, EPOLL_CTL_DEL, viewer.stream.handle, NULL);
+				SpectatorStopViewing(viewer);
+				disconnected++;
+				continue;
+			}
+
+			int decodedTick = viewer.frame.fields[SPECTATOR_TICK];
+			if (frames > 0 && tick - decodedTick <= TRUTH_HISTORY
+				&& memcmp(&truth[decodedTick % TRUTH_HISTORY], &viewer.frame, sizeof(SpectatorFrame)) != 0)
+			{
+				mismatches++;
+			}
+		}
+	}
+
+	SpectatorStopPublishing(publisher);
+	if (relayThread.joinable())
+	{
+		relayRunning = false;
+		relayThread.join();
+	}
+
+	long long bytes = 0;
+	long long frames = 0;
+	int fewestFrames = tick;
+	int errors = 0;
+	for (SpectatorViewer& viewer : viewers)
+	{
+		bytes += viewer.bytesReceived;
+		frames += viewer.frames;
+		errors += viewer.errors;
+		fewestFrames = viewer.frames < fewestFrames ? viewer.frames : fewestFrames;
+		SpectatorStopViewing(viewer);
+	}
+
+	printf("Published %d frames, %.0f B/s, %d dropped\n", tick, publisher.bytesSent / (double)seconds, publisher.dropped);
+	printf("Per viewer: %.0f frames on average, fewest %d, %.0f B/s, %.1f bytes per frame\n",
+		(double)frames / viewerCount, fewestFrames, bytes / (double)viewerCount / seconds, frames > 0 ? (double)bytes / frames : 0.0);
+	printf("%d mismatched frames, %d decode errors, %d viewers disconnected\n", mismatches, errors, disconnected);
+
+	if (relayCpuNs > 0)
+	{
+		double busy = relayCpuNs / 1e9 / seconds;
+		printf("Relay: %lld skips, %.2f%% of a core, %.2f us of CPU per viewer per second\n",
+			relay.stats.skipped, busy * 100, busy * 1e6 / viewerCount);
+		RelayClose(relay);
+	}
+
+	// The last to join misses the first second, and starts from the keyframe before it
+	int expected = tick - JOIN_MS * SIM_TICKS_PER_SECOND / 1000 - SPECTATOR_KEYFRAME_INTERVAL;
+	bool ok = mismatches == 0 && errors == 0 && disconnected == 0 && connected == viewerCount && fewestFrames >= expected;
+	printf(ok ? "OK\n" : "FAILED\n");
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,403 @@
+#include "SpectatorRelay.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// epoll data of the listening socket, clients use their index
+const unsigned RELAY_LISTENER = 0xFFFFFFFF;
+
+const int RELAY_EVENTS = 256;
+
+bool RelayOpen(SpectatorRelay& relay, int port)
+{
+	RelayClose(relay);
+
+	relay.listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if (relay.listenFd < 0)
+	{
+		printf("Relay socket could not be created!\n");
+		return false;
+	}
+
+	int reuse = 1;
+	setsockopt(relay.listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	sockaddr_in local;
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	local.sin_port = htons((uint16_t)port);
+
+	if (bind(relay.listenFd, (const sockaddr*)&local, sizeof(local)) != 0 || listen(relay.listenFd, SOMAXCONN) != 0)
+	{
+		printf("Relay port %d could not be opened!\n", port);
+		RelayClose(relay);
+		return false;
+	}
+
+	relay.epollFd = epoll_create1(0);
+	epoll_event event;
+	event.events = EPOLLIN;
+	event.data.u32 = RELAY_LISTENER;
+	epoll_ctl(relay.epollFd, EPOLL_CTL_ADD, relay.listenFd, &event);
+
+	relay.clients.resize(MAX_RELAY_CLIENTS);
+	relay.freeClients.clear();
+	for (int i = MAX_RELAY_CLIENTS - 1; i >= 0; i--)
+	{
+		relay.clients[i].fd = -1;
+		relay.freeClients.push_back(i);
+	}
+
+	relay.publisher = -1;
+	relay.incomingSize = 0;
+	relay.catchUpSize = 0;
+	memset(&relay.stats, 0, sizeof(relay.stats));
+	return true;
+}
+
+static void CloseClient(SpectatorRelay& relay, int index)
+{
+	RelayClient& client = relay.clients[index];
+	if (client.fd < 0)
+	{
+		return;
+	}
+
+	// Closing also takes it out of the epoll set
+	close(client.fd);
+	client.fd = -1;
+	relay.freeClients.push_back(index);
+
+	if (client.role == RELAY_VIEWER)
+	{
+		relay.stats.viewers--;
+	}
+
+	if (index == relay.publisher)
+	{
+		// The next one starts with a keyframe anyway
+		relay.publisher = -1;
+		relay.incomingSize = 0;
+		relay.catchUpSize = 0;
+	}
+}
+
+void RelayClose(SpectatorRelay& relay)
+{
+	for (int i = 0; i < (int)relay.clients.size(); i++)
+	{
+		CloseClient(relay, i);
+	}
+	relay.clients.clear();
+	relay.freeClients.clear();
+
+	if (relay.epollFd >= 0)
+	{
+		close(relay.epollFd);
+		relay.epollFd = -1;
+	}
+	if (relay.listenFd >= 0)
+	{
+		close(relay.listenFd);
+		relay.listenFd = -1;
+	}
+}
+
+int RelayPort(const SpectatorRelay& relay)
+{
+	sockaddr_in local;
+	socklen_t length = sizeof(local);
+	if (getsockname(relay.listenFd, (sockaddr*)&local, &length) != 0)
+	{
+		return 0;
+	}
+	return ntohs(local.sin_port);
+}
+
+static void WatchWritable(SpectatorRelay& relay, int index, bool writable)
+{
+	RelayClient& client = relay.clients[index];
+	if (client.writable == writable)
+	{
+		return;
+	}
+
+	epoll_event event;
+	event.events = EPOLLIN | (writable ? EPOLLOUT : 0);
+	event.data.u32 = (unsigned)index;
+	epoll_ctl(relay.epollFd, EPOLL_CTL_MOD, client.fd, &event);
+	client.writable = writable;
+}
+
+static void Flush(SpectatorRelay& relay, int index)
+{
+	RelayClient& client = relay.clients[index];
+	int size = client.queueEnd - client.queueStart;
+	if (size == 0)
+	{
+		return;
+	}
+
+	ssize_t sent = send(client.fd, client.queue + client.queueStart, size, MSG_NOSIGNAL | MSG_DONTWAIT);
+	relay.stats.sends++;
+	if (sent < 0)
+	{
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		{
+			CloseClient(relay, index);
+		}
+		return;
+	}
+
+	relay.stats.bytesOut += sent;
+	client.queueStart += (int)sent;
+	if (client.queueStart == client.queueEnd)
+	{
+		client.queueStart = 0;
+		client.queueEnd = 0;
+	}
+
+	WatchWritable(relay, index, client.queueStart != client.queueEnd);
+}
+
+// Whole messages only, so the queue always ends on a message boundary
+static void Queue(SpectatorRelay& relay, RelayClient& client, const unsigned char* data, int size)
+{
+	if (client.queueEnd + size > RELAY_QUEUE_SIZE)
+	{
+		memmove(client.queue, client.queue + client.queueStart, client.queueEnd - client.queueStart);
+		client.queueEnd -= client.queueStart;
+		client.queueStart = 0;
+	}
+
+	if (client.queueEnd + size > RELAY_QUEUE_SIZE)
+	{
+		// Deltas from here would be decoded against frames it never got
+		client.resync = true;
+		relay.stats.skipped++;
+		return;
+	}
+
+	memcpy(client.queue + client.queueEnd, data, size);
+	client.queueEnd += size;
+}
+
+static void Accept(SpectatorRelay& relay)
+{
+	for (;;)
+	{
+		int fd = accept4(relay.listenFd, NULL, NULL, SOCK_NONBLOCK);
+		if (fd < 0)
+		{
+			return;
+		}
+
+		if (relay.freeClients.empty())
+		{
+			close(fd);
+			continue;
+		}
+
+		int noDelay = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+		int index = relay.freeClients.back();
+		relay.freeClients.pop_back();
+
+		RelayClient& client = relay.clients[index];
+		client.fd = fd;
+		client.role = RELAY_UNKNOWN;
+		client.resync = true;
+		client.writable = false;
+		client.queueStart = 0;
+		client.queueEnd = 0;
+
+		epoll_event event;
+		event.events = EPOLLIN;
+		event.data.u32 = (unsigned)index;
+		epoll_ctl(relay.epollFd, EPOLL_CTL_ADD, fd, &event);
+	}
+}
+
+// Keeps what a new viewer needs: the last keyframe and every delta after it
+static void KeepForCatchUp(SpectatorRelay& relay, const unsigned char* message, int size)
+{
+	if (message[1] == SPECTATOR_KEYFRAME)
+	{
+		relay.catchUpSize = 0;
+	}
+	else if (relay.catchUpSize == 0)
+	{
+		return;
+	}
+
+	if (relay.catchUpSize + size > RELAY_CATCH_UP_SIZE)
+	{
+		// New viewers wait for the next keyframe
+		relay.catchUpSize = 0;
+		return;
+	}
+
+	memcpy(relay.catchUp + relay.catchUpSize, message, size);
+	relay.catchUpSize += size;
+}
+
+static void ForwardFromPublisher(SpectatorRelay& relay)
+{
+	RelayClient& publisher = relay.clients[relay.publisher];
+	for (;;)
+	{
+		ssize_t size = recv(publisher.fd, relay.incoming + relay.incomingSize, RELAY_QUEUE_SIZE - relay.incomingSize, 0);
+		if (size <= 0)
+		{
+			if (size == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+			{
+				CloseClient(relay, relay.publisher);
+			}
+			return;
+		}
+		relay.stats.bytesIn += size;
+		relay.incomingSize += (int)size;
+
+		// The complete messages, and where the first keyframe among them starts
+		int complete = 0;
+		int firstKeyframe = -1;
+		int messageSize;
+		while ((messageSize = SpectatorMessageSize(relay.incoming + complete, relay.incomingSize - complete)) > 0)
+		{
+			const unsigned char* message = relay.incoming + complete;
+			if (message[1] == SPECTATOR_KEYFRAME && firstKeyframe < 0)
+			{
+				firstKeyframe = complete;
+			}
+			KeepForCatchUp(relay, message, messageSize);
+			relay.stats.messagesIn++;
+			complete += messageSize;
+		}
+
+		if (complete > 0)
+		{
+			for (int i = 0; i < (int)relay.clients.size(); i++)
+			{
+				RelayClient& client = relay.clients[i];
+				if (client.fd < 0 || client.role != RELAY_VIEWER)
+				{
+					continue;
+				}
+
+				int start = 0;
+				if (client.resync)
+				{
+					if (firstKeyframe < 0)
+					{
+						continue;
+					}
+					start = firstKeyframe;
+					client.resync = false;
+				}
+
+				Queue(relay, client, relay.incoming + start, complete - start);
+				if (!client.writable)
+				{
+					Flush(relay, i);
+				}
+			}
+		}
+
+		relay.incomingSize -= complete;
+		memmove(relay.incoming, relay.incoming + complete, relay.incomingSize);
+	}
+}
+
+static void ReadClient(SpectatorRelay& relay, int index)
+{
+	RelayClient& client = relay.clients[index];
+	if (client.role == RELAY_PUBLISHER)
+	{
+		ForwardFromPublisher(relay);
+		return;
+	}
+
+	// Viewers only send their hello, anything else is dropped
+	unsigned char data[256];
+	ssize_t size = recv(client.fd, data, sizeof(data), 0);
+	if (size == 0 || (size < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+	{
+		CloseClient(relay, index);
+		return;
+	}
+	if (size < 0 || client.role != RELAY_UNKNOWN)
+	{
+		return;
+	}
+
+	if (data[0] == SPECTATOR_HELLO_PUBLISHER && relay.publisher < 0)
+	{
+		client.role = RELAY_PUBLISHER;
+		relay.publisher = index;
+		relay.incomingSize = (int)size - 1;
+		memcpy(relay.incoming, data + 1, relay.incomingSize);
+		ForwardFromPublisher(relay);
+	}
+	else if (data[0] == SPECTATOR_HELLO_VIEWER)
+	{
+		client.role = RELAY_VIEWER;
+		relay.stats.viewers++;
+
+		if (relay.catchUpSize > 0)
+		{
+			Queue(relay, client, relay.catchUp, relay.catchUpSize);
+			client.resync = false;
+			Flush(relay, index);
+		}
+	}
+	else
+	{
+		CloseClient(relay, index);
+	}
+}
+
+void RelayPoll(SpectatorRelay& relay, int timeoutMs)
+{
+	epoll_event events[RELAY_EVENTS];
+	int count = epoll_wait(relay.epollFd, events, RELAY_EVENTS, timeoutMs);
+
+	for (int i = 0; i < count; i++)
+	{
+		unsigned index = events[i].data.u32;
+		if (index == RELAY_LISTENER)
+		{
+			Accept(relay);
+			continue;
+		}
+
+		// Closed by an earlier event of this batch
+		if (relay.clients[index].fd < 0)
+		{
+			continue;
+		}
+
+		if (events[i].events & (EPOLLERR | EPOLLHUP))
+		{
+			CloseClient(relay, (int)index);
+			continue;
+		}
+
+		if (events[i].events & EPOLLOUT)
+		{
+			Flush(relay, (int)index);
+		}
+
+		if (relay.clients[index].fd >= 0 && (events[i].events & EPOLLIN))
+		{
+			ReadClient(relay, (int)index);
+		}
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "Spectator.h"
+#include <vector>
+
+// Fan-out server for spectator streams, Linux only (epoll). Takes one
+// publisher and forwards its messages to every viewer. A new viewer first
+// gets the latest keyframe and the deltas since, so it can draw right away.
+//
+// Each read from the publisher is forwarded to a viewer as one copy and one
+// send, however many messages it held. A viewer whose queue is full skips
+// ahead to the next keyframe instead of slowing the others down.
+
+const int MAX_RELAY_CLIENTS = 2048;
+const int RELAY_QUEUE_SIZE = 8192; // Per viewer, about 15 seconds of play
+const int RELAY_CATCH_UP_SIZE = 2048; // Keyframe and the deltas after it
+
+enum RelayRole
+{
+	RELAY_UNKNOWN, // Connected, hello not read yet
+	RELAY_PUBLISHER,
+	RELAY_VIEWER
+};
+
+typedef struct RelayClient
+{
+	int fd; // -1 for a free slot
+	int role;
+	bool resync; // Waiting for a keyframe
+	bool writable; // Waiting on EPOLLOUT
+
+	unsigned char queue[RELAY_QUEUE_SIZE];
+	int queueStart;
+	int queueEnd;
+} RelayClient;
+
+typedef struct RelayStats
+{
+	int viewers;
+	long long messagesIn;
+	long long bytesIn;
+	long long bytesOut;
+	long long sends;
+	long long skipped; // Times a slow viewer skipped to a keyframe
+} RelayStats;
+
+typedef struct SpectatorRelay
+{
+	int listenFd = -1;
+	int epollFd = -1;
+	int publisher; // Client index, -1 none
+
+	std::vector<RelayClient> clients;
+	std::vector<int> freeClients;
+
+	// From the publisher, the messages not complete yet stay at the front
+	unsigned char incoming[RELAY_QUEUE_SIZE];
+	int incomingSize;
+
+	unsigned char catchUp[RELAY_CATCH_UP_SIZE];
+	int catchUpSize; // 0 until a keyframe arrives
+
+	RelayStats stats;
+} SpectatorRelay;
+
+// port 0 picks any free port
+bool RelayOpen(SpectatorRelay& relay, int port);
+void RelayClose(SpectatorRelay& relay);
+int RelayPort(const SpectatorRelay& relay);
+
+// Handles whatever is ready, waiting up to timeoutMs for something
+void RelayPoll(SpectatorRelay& relay, int timeoutMs);
@@ -0,0 +1,97 @@
+#include "MatchFarm.h"
+#include "WorkStealingPool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+// "5" or "4:8" or "3:9:2"
+bool ParseRange(const char* text, FarmRange& range)
+{
+	range.step = 1;
+	int fields = sscanf(text, "%d:%d:%d", &range.first, &range.last, &range.step);
+	if (fields == 1)
+	{
+		range.last = range.first;
+	}
+	return fields >= 1;
+}
+
+void PrintUsage()
+{
+	printf("Usage: pingpong_sweep [options]\n");
+	printf("  --ball A:B[:S]      initial ball velocity\n");
+	printf("  --player A:B[:S]    player paddle velocity\n");
+	printf("  --enemy A:B[:S]     enemy paddle velocity\n");
+	printf("  --delay A:B[:S]     enemy reaction delay, ticks\n");
+	printf("  --aim A:B[:S]       enemy aim error, pixels\n");
+	printf("  --matches N         matches per configuration\n");
+	printf("  --reaction P        percent of ticks the player bot reacts\n");
+	printf("  --seed N\n");
+	printf("  --workers N         default: every core\n");
+}
+
+// Sweeps the difficulty parameters over a grid and prints one CSV row per configuration.
+int main(int argc, char* args[])
+{
+	FarmGrid grid = FarmDefaultGrid();
+	int workers = PoolDefaultWorkers();
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* value = i + 1 < argc ? args[i + 1] : "";
+		bool ok = true;
+
+		if (strcmp(args[i], "--ball") == 0) ok = ParseRange(value, grid.ballVelocity);
+		else if (strcmp(args[i], "--player") == 0) ok = ParseRange(value, grid.playerVelocity);
+		else if (strcmp(args[i], "--enemy") == 0) ok = ParseRange(value, grid.enemyVelocity);
+		else if (strcmp(args[i], "--delay") == 0) ok = ParseRange(value, grid.reactionDelay);
+		else if (strcmp(args[i], "--aim") == 0) ok = ParseRange(value, grid.aimError);
+		else if (strcmp(args[i], "--matches") == 0) grid.matchesPerConfig = atoi(value);
+		else if (strcmp(args[i], "--reaction") == 0) grid.reactionPercent = atoi(value);
+		else if (strcmp(args[i], "--seed") == 0) grid.seed = (unsigned)strtoul(value, NULL, 10);
+		else if (strcmp(args[i], "--workers") == 0) workers = atoi(value);
+		else ok = false;
+
+		if (!ok || grid.matchesPerConfig <= 0 || workers <= 0)
+		{
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+		i++;
+	}
+
+	int configCount = FarmConfigCount(grid);
+	std::vector<FarmResult> results(configCount);
+
+	auto start = std::chrono::steady_clock::now();
+	RunFarm(grid, results.data(), workers);
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	printf("ball,player,enemy,delay,aim,matches,player_win_rate,enemy_win_rate,draw_rate,avg_rally,avg_points,avg_match_seconds\n");
+
+	long long ticks = 0;
+	for (const FarmResult& r : results)
+	{
+		double matches = r.matches;
+		printf("%d,%d,%d,%d,%d,%d,%.4f,%.4f,%.4f,%.2f,%.2f,%.1f\n",
+			r.config.intialBallVelocity,
+			r.config.playerVelocity,
+			r.config.enemyVelocity,
+			r.config.reactionDelay,
+			r.config.aimError,
+			r.matches,
+			r.playerWins / matches,
+			r.enemyWins / matches,
+			r.draws / matches,
+			r.points > 0 ? (double)r.paddleHits / r.points : 0.0,
+			r.points / matches,
+			r.ticks / matches / SIM_TICKS_PER_SECOND);
+		ticks += r.ticks;
+	}
+
+	fprintf(stderr, "configs: %d  workers: %d  seconds: %.3f  ticks/s: %.0f\n", configCount, workers, elapsed.count(), ticks / elapsed.count());
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+#include "VecEnv.h"
+
+// Spreads seed and episode over the enemy's aim generator (murmur3 finalizer)
+static unsigned EpisodeSeed(unsigned seed, unsigned episode)
+{
+	unsigned hash = seed ^ (episode * 0x9E3779B9u);
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6Bu;
+	hash ^= hash >> 13;
+	hash *= 0xC2B2AE35u;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+static void StartEpisode(VecEnv& env, int index)
+{
+	SimState state;
+	SimInit(state, env.batch.config);
+	state.enemyRandom = EpisodeSeed(env.seed, env.episodes++);
+	EnemyRethink(state);
+	SimBatchSetState(env.batch, index, state);
+}
+
+static void Observe(const VecEnv& env, float* observations)
+{
+	const SimBatch& b = env.batch;
+	const float width = 1.0f / (ARENA_WIDTH << SUBPIXEL_SHIFT);
+	const float height = 1.0f / (ARENA_HEIGHT << SUBPIXEL_SHIFT);
+	const float speed = 1.0f / ENV_SPEED_SCALE;
+	const float duration = 1.0f / b.config.matchDuration;
+
+	for (int i = 0; i < b.count; i++)
+	{
+		float* o = observations + i * ENV_OBSERVATION_SIZE;
+		o[ENV_BALL_X] = b.ballX[i] * width;
+		o[ENV_BALL_Y] = b.ballY[i] * height;
+		o[ENV_BALL_X_SPEED] = b.ballVelocity[i] * b.ballXDirection[i] * speed;
+		o[ENV_BALL_Y_SPEED] = b.ballVelocity[i] * b.ballYDirection[i] * speed;
+		o[ENV_PLAYER_Y] = b.playerY[i] * height;
+		o[ENV_ENEMY_Y] = b.enemyY[i] * height;
+		o[ENV_TIME_LEFT] = b.timeLeft[i] * duration;
+	}
+}
+
+void VecEnvInit(VecEnv& env, int count, const SimConfig& config, SimKernel kernel)
+{
+	SimConfig botEnemy = config;
+	botEnemy.enemyHuman = false;
+
+	SimBatchInit(env.batch, count, botEnemy);
+	env.kernel = kernel;
+	env.seed = 0;
+	env.episodes = 0;
+}
+
+void VecEnvFree(VecEnv& env)
+{
+	SimBatchFree(env.batch);
+}
+
+void VecEnvReset(VecEnv& env, unsigned seed, float* observations)
+{
+	env.seed = seed;
+	env.episodes = 0;
+	for (int i = 0; i < env.batch.count; i++)
+	{
+		StartEpisode(env, i);
+	}
+	Observe(env, observations);
+}
+
+void VecEnvStep(VecEnv& env, const int* actions, float* observations, float* rewards, unsigned char* dones)
+{
+	SimBatch& b = env.batch;
+
+	// Anything but -1, 0 or 1 would move the paddle faster
+	for (int i = 0; i < b.count; i++)
+	{
+		b.inputDirection[i] = (actions[i] > 0) - (actions[i] < 0);
+		b.inputStart[i] = 1;
+	}
+
+	SimBatchStep(b, env.kernel);
+
+	for (int i = 0; i < b.count; i++)
+	{
+		int events = b.events[i];
+		rewards[i] = (float)(((events & SIM_EVENT_PLAYER_SCORED) != 0) - ((events & SIM_EVENT_ENEMY_SCORED) != 0));
+		dones[i] = b.finished[i] != 0;
+	}
+
+	for (int i = 0; i < b.count; i++)
+	{
+		if (dones[i])
+		{
+			StartEpisode(env, i);
+		}
+	}
+
+	Observe(env, observations);
+}
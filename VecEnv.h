@@ -0,0 +1,43 @@
+#pragma once
+#include "SimBatch.h"
+
+// Vectorized environment for training paddle agents on the game's own rules:
+// reset and step N matches at once through SimBatch. The agent drives the
+// player paddle against the enemy AI, rounds start on their own, and a
+// finished match reports done and starts over within the same step.
+
+// Observation of one match, floats scaled to about -1..1
+enum EnvObservation
+{
+	ENV_BALL_X,
+	ENV_BALL_Y,
+	ENV_BALL_X_SPEED,
+	ENV_BALL_Y_SPEED,
+	ENV_PLAYER_Y,
+	ENV_ENEMY_Y,
+	ENV_TIME_LEFT,
+	ENV_OBSERVATION_SIZE
+};
+
+// Pixels per tick that observe as 1
+const int ENV_SPEED_SCALE = 16;
+
+typedef struct VecEnv
+{
+	SimBatch batch;
+	SimKernel kernel;
+
+	unsigned seed;
+	unsigned episodes; // Started since the reset, each gets its own enemy aim
+} VecEnv;
+
+void VecEnvInit(VecEnv& env, int count, const SimConfig& config, SimKernel kernel = SimKernel::AUTO);
+void VecEnvFree(VecEnv& env);
+
+// Starts every match over. observations: count * ENV_OBSERVATION_SIZE
+void VecEnvReset(VecEnv& env, unsigned seed, float* observations);
+
+// actions: one direction per match, DIRECTION_UP, DIRECTION_STOP or DIRECTION_DOWN.
+// rewards: +1 when the player scored this step, -1 when the enemy did.
+// A done match's observation is already the first of the next one.
+void VecEnvStep(VecEnv& env, const int* actions, float* observations, float* rewards, unsigned char* dones);
@@ -0,0 +1,111 @@
+#include "WorkStealingPool.h"
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef struct WorkerQueue
+{
+	std::mutex lock;
+	std::deque<int> tasks;
+} WorkerQueue;
+
+typedef struct PoolRun
+{
+	PoolTaskFunction task;
+	void* data;
+	int workers;
+	WorkerQueue* queues;
+} PoolRun;
+
+static bool PopOwn(WorkerQueue& queue, int& taskIndex)
+{
+	std::lock_guard<std::mutex> guard(queue.lock);
+	if (queue.tasks.empty())
+	{
+		return false;
+	}
+
+	taskIndex = queue.tasks.back();
+	queue.tasks.pop_back();
+	return true;
+}
+
+static bool Steal(WorkerQueue& queue, int& taskIndex)
+{
+	std::lock_guard<std::mutex> guard(queue.lock);
+	if (queue.tasks.empty())
+	{
+		return false;
+	}
+
+	taskIndex = queue.tasks.front();
+	queue.tasks.pop_front();
+	return true;
+}
+
+static void WorkerLoop(PoolRun& run, int workerIndex)
+{
+	int taskIndex;
+	for (;;)
+	{
+		if (PopOwn(run.queues[workerIndex], taskIndex))
+		{
+			run.task(run.data, taskIndex, workerIndex);
+			continue;
+		}
+
+		// Own queue is empty, look for work in the others. Tasks never spawn tasks,
+		// so once every queue is empty the run is over.
+		bool stole = false;
+		for (int i = 1; i < run.workers && !stole; i++)
+		{
+			stole = Steal(run.queues[(workerIndex + i) % run.workers], taskIndex);
+		}
+
+		if (!stole)
+		{
+			return;
+		}
+
+		run.task(run.data, taskIndex, workerIndex);
+	}
+}
+
+int PoolDefaultWorkers()
+{
+	int cores = (int)std::thread::hardware_concurrency();
+	return cores > 0 ? cores : 1;
+}
+
+void RunParallel(int taskCount, PoolTaskFunction task, void* data, int workers)
+{
+	if (workers <= 0)
+	{
+		workers = PoolDefaultWorkers();
+	}
+
+	std::vector<WorkerQueue> queues(workers);
+
+	// Deal contiguous blocks so neighbouring tasks start on the same worker
+	for (int i = 0; i < taskCount; i++)
+	{
+		queues[(long long)i * workers / taskCount].tasks.push_back(i);
+	}
+
+	PoolRun run = { task, data, workers, queues.data() };
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < workers; i++)
+	{
+		threads.emplace_back(WorkerLoop, std::ref(run), i);
+	}
+
+	// The calling thread is worker 0
+	WorkerLoop(run, 0);
+
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+// Runs taskCount independent tasks on every core.
+// Each worker owns a deque of task indices, pops its own from the back and steals
+// from the front of the others when it runs out, so uneven tasks still balance.
+
+typedef void (*PoolTaskFunction)(void* data, int taskIndex, int workerIndex);
+
+int PoolDefaultWorkers();
+
+// Blocks until every task ran. workers <= 0 uses PoolDefaultWorkers().
+void RunParallel(int taskCount, PoolTaskFunction task, void* data, int workers = 0);